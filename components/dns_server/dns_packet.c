@@ -0,0 +1,414 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include "dns_packet.h"
+
+#define DNS_MAX_POINTERS        (16)
+#define DNS_LABEL_MAX_LEN       (63)
+
+#define DNS_FLAG_QR             (0x8000)
+#define DNS_FLAG_AA             (0x0400)
+#define DNS_OPCODE_MASK         (0x7800)
+#define DNS_CLASS_IN            (1)
+#define DNS_CLASS_ANY           (255)
+#define MDNS_CLASS_UNICAST      (0x8000)    /**<! QU bit in questions */
+#define MDNS_CLASS_FLUSH        (0x8000)    /**<! cache-flush bit in unique records */
+
+#define MDNS_TTL_HOST           (120)       /**<! records carrying the host name or address (RFC 6762 10) */
+#define MDNS_TTL_OTHER          (4500)
+#define MDNS_TTL_LEGACY         (10)
+
+#define MDNS_SERVICES_ENUM      "_services._dns-sd._udp"
+
+// Records the responder can emit, one bit each in a mask
+#define REC_A                   (1u << 0)
+#define REC_ENUM(i)             (1u << (1 + 4 * (i)))   /**<! _services._dns-sd._udp PTR <type> */
+#define REC_PTR(i)              (1u << (2 + 4 * (i)))   /**<! <type> PTR <host>.<type> */
+#define REC_SRV(i)              (1u << (3 + 4 * (i)))
+#define REC_TXT(i)              (1u << (4 + 4 * (i)))
+
+#define DNS_WRITER_NAMES        (16)
+
+// Name written earlier in the packet, target of compression pointers
+typedef struct {
+    const char *first;
+    const char *second;
+    uint16_t off;
+} dns_written_name_t;
+
+typedef struct {
+    uint8_t *buf;
+    size_t max;
+    size_t off;
+    bool ok;
+    int num_of_names;
+    dns_written_name_t names[DNS_WRITER_NAMES];
+} dns_writer_t;
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static void set_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = value >> 8;
+    p[1] = value & 0xFF;
+}
+
+int dns_name_parse(const uint8_t *pkt, size_t len, size_t off, char *name, size_t name_max)
+{
+    size_t pos = off;
+    size_t out = 0;
+    int next = -1;
+    int pointers = 0;
+
+    if (name_max == 0) {
+        return -1;
+    }
+
+    while (true) {
+        if (pos >= len) {
+            return -1;
+        }
+        uint8_t label = pkt[pos];
+        if ((label & 0xC0) == 0xC0) {
+            if (pos + 1 >= len || ++pointers > DNS_MAX_POINTERS) {
+                return -1;
+            }
+            if (next < 0) {
+                next = pos + 2;
+            }
+            pos = (label & 0x3F) << 8 | pkt[pos + 1];
+            continue;
+        }
+        if (label > DNS_LABEL_MAX_LEN) {
+            return -1;
+        }
+        if (label == 0) {
+            break;
+        }
+        // label, a '.' before it unless first, and the final '\0'
+        size_t need = label + (out > 0 ? 1 : 0) + 1;
+        if (pos + 1 + label > len || out + need > name_max) {
+            return -1;
+        }
+        if (out > 0) {
+            name[out++] = '.';
+        }
+        memcpy(name + out, pkt + pos + 1, label);
+        out += label;
+        pos += 1 + label;
+    }
+
+    name[out] = '\0';
+
+    return next < 0 ? (int)(pos + 1) : next;
+}
+
+static void put_bytes(dns_writer_t *w, const void *data, size_t len)
+{
+    if (len == 0) {
+        return;
+    }
+    if (!w->ok || w->off + len > w->max) {
+        w->ok = false;
+        return;
+    }
+    memcpy(w->buf + w->off, data, len);
+    w->off += len;
+}
+
+static void put_u8(dns_writer_t *w, uint8_t value)
+{
+    put_bytes(w, &value, 1);
+}
+
+static void put_u16(dns_writer_t *w, uint16_t value)
+{
+    uint8_t b[2] = { value >> 8, value & 0xFF };
+    put_bytes(w, b, sizeof(b));
+}
+
+static void put_u32(dns_writer_t *w, uint32_t value)
+{
+    put_u16(w, value >> 16);
+    put_u16(w, value & 0xFFFF);
+}
+
+// Labels of a dotted name, without the terminating root label
+static void put_labels(dns_writer_t *w, const char *dotted)
+{
+    while (*dotted != '\0') {
+        const char *dot = strchr(dotted, '.');
+        size_t len = dot ? (size_t)(dot - dotted) : strlen(dotted);
+        if (len == 0 || len > DNS_LABEL_MAX_LEN) {
+            w->ok = false;
+            return;
+        }
+        put_u8(w, len);
+        put_bytes(w, dotted, len);
+        dotted += len + (dot ? 1 : 0);
+    }
+}
+
+static bool str_equal(const char *a, const char *b)
+{
+    return a == b || (a && b && strcmp(a, b) == 0);
+}
+
+// <first>[.<second>].local, compressed against the names already in the packet
+static void put_name(dns_writer_t *w, const char *first, const char *second)
+{
+    for (int i = 0; i < w->num_of_names; ++i) {
+        if (str_equal(w->names[i].first, first) && str_equal(w->names[i].second, second)) {
+            put_u16(w, 0xC000 | w->names[i].off);
+            return;
+        }
+    }
+    if (w->num_of_names < DNS_WRITER_NAMES && w->off < 0x3FFF) {
+        w->names[w->num_of_names++] = (dns_written_name_t) { .first = first, .second = second, .off = w->off };
+    }
+
+    if (first == NULL) {
+        put_labels(w, "local");
+        put_u8(w, 0);
+        return;
+    }
+    put_labels(w, first);
+    put_name(w, second, NULL);
+}
+
+// `bit` indexes the record masks: 0 is the address, then four records per service
+static void put_record(dns_writer_t *w, const mdns_host_t *host, int bit, bool legacy)
+{
+    const mdns_service_t *service = bit > 0 ? &host->service[(bit - 1) / 4] : NULL;
+    uint16_t type;
+    bool unique = true;
+    uint32_t ttl = MDNS_TTL_OTHER;
+    uint32_t rec = 1u << bit;
+
+    if (rec == REC_A) {
+        put_name(w, host->hostname, NULL);
+        type = DNS_TYPE_A;
+        ttl = MDNS_TTL_HOST;
+    } else if ((bit - 1) % 4 == 0) {
+        put_name(w, MDNS_SERVICES_ENUM, NULL);
+        type = DNS_TYPE_PTR;
+        unique = false;
+    } else if ((bit - 1) % 4 == 1) {
+        put_name(w, service->type, NULL);
+        type = DNS_TYPE_PTR;
+        unique = false;
+    } else if ((bit - 1) % 4 == 2) {
+        put_name(w, host->hostname, service->type);
+        type = DNS_TYPE_SRV;
+        ttl = MDNS_TTL_HOST;
+    } else {
+        put_name(w, host->hostname, service->type);
+        type = DNS_TYPE_TXT;
+    }
+
+    put_u16(w, type);
+    put_u16(w, DNS_CLASS_IN | (unique && !legacy ? MDNS_CLASS_FLUSH : 0));
+    put_u32(w, legacy ? MDNS_TTL_LEGACY : ttl);
+    size_t rdlength = w->off;
+    put_u16(w, 0);
+
+    switch (type) {
+    case DNS_TYPE_A:
+        // already in network byte order
+        put_bytes(w, &host->ip, sizeof(host->ip));
+        break;
+    case DNS_TYPE_PTR:
+        if ((bit - 1) % 4 == 0) {
+            put_name(w, service->type, NULL);
+        } else {
+            put_name(w, host->hostname, service->type);
+        }
+        break;
+    case DNS_TYPE_SRV:
+        put_u16(w, 0);      // priority
+        put_u16(w, 0);      // weight
+        put_u16(w, service->port);
+        put_name(w, host->hostname, NULL);
+        break;
+    default: {
+        // TXT needs at least one string, an empty one if there is nothing to say
+        size_t len = service->txt ? strlen(service->txt) : 0;
+        if (len > 255) {
+            w->ok = false;
+        }
+        put_u8(w, len);
+        put_bytes(w, service->txt, len);
+        break;
+    }
+    }
+
+    if (w->ok) {
+        set_u16(w->buf + rdlength, w->off - rdlength - 2);
+    }
+}
+
+// Write the records in `mask`; with `optional` a record that does not fit is left out instead of failing
+static int put_records(dns_writer_t *w, const mdns_host_t *host, uint32_t mask, bool legacy, bool optional)
+{
+    int count = 0;
+
+    for (int bit = 0; bit < 1 + 4 * host->num_of_services; ++bit) {
+        if (!(mask & (1u << bit))) {
+            continue;
+        }
+        size_t off = w->off;
+        int num_of_names = w->num_of_names;
+        put_record(w, host, bit, legacy);
+        if (!w->ok && optional) {
+            w->off = off;
+            w->num_of_names = num_of_names;
+            w->ok = true;
+            continue;
+        }
+        count++;
+    }
+
+    return count;
+}
+
+static bool name_equal(const char *name, const char *first, const char *second)
+{
+    char expected[DNS_NAME_MAX_LEN];
+    int len = second ? snprintf(expected, sizeof(expected), "%s.%s.local", first, second)
+                     : snprintf(expected, sizeof(expected), "%s.local", first);
+
+    return len > 0 && len < (int)sizeof(expected) && strcasecmp(name, expected) == 0;
+}
+
+// Records answering one question, records worth sending along go to `additional`
+static uint32_t mdns_match(const mdns_host_t *host, const char *name, uint16_t type, uint32_t *additional)
+{
+    uint32_t answers = 0;
+    bool any = type == DNS_TYPE_ANY;
+
+    if (name_equal(name, host->hostname, NULL)) {
+        return type == DNS_TYPE_A || any ? REC_A : 0;
+    }
+
+    for (int i = 0; i < host->num_of_services; ++i) {
+        const char *service = host->service[i].type;
+        if (type == DNS_TYPE_PTR || any) {
+            if (name_equal(name, MDNS_SERVICES_ENUM, NULL)) {
+                answers |= REC_ENUM(i);
+            } else if (name_equal(name, service, NULL)) {
+                answers |= REC_PTR(i);
+                *additional |= REC_SRV(i) | REC_TXT(i) | REC_A;
+            }
+        }
+        if (name_equal(name, host->hostname, service)) {
+            if (type == DNS_TYPE_SRV || any) {
+                answers |= REC_SRV(i);
+                *additional |= REC_A;
+            }
+            if (type == DNS_TYPE_TXT || any) {
+                answers |= REC_TXT(i);
+            }
+        }
+    }
+
+    return answers;
+}
+
+int mdns_build_response(const uint8_t *query, size_t query_len, const mdns_host_t *host, bool legacy,
+                        uint8_t *reply, size_t reply_max, bool *unicast)
+{
+    *unicast = false;
+
+    if (query_len < DNS_HEADER_LEN || host->num_of_services > MDNS_MAX_SERVICES) {
+        return -1;
+    }
+    // Responses from other responders and anything but a standard query are not for us
+    if (get_u16(query + 2) & (DNS_FLAG_QR | DNS_OPCODE_MASK)) {
+        return 0;
+    }
+
+    uint16_t qd_count = get_u16(query + 4);
+    size_t off = DNS_HEADER_LEN;
+    uint32_t answers = 0;
+    uint32_t additional = 0;
+    char name[DNS_NAME_MAX_LEN];
+
+    for (int i = 0; i < qd_count; ++i) {
+        int next = dns_name_parse(query, query_len, off, name, sizeof(name));
+        if (next < 0 || next + 4 > (int)query_len) {
+            return -1;
+        }
+        uint16_t type = get_u16(query + next);
+        uint16_t class = get_u16(query + next + 2);
+        off = next + 4;
+
+        if ((class & ~MDNS_CLASS_UNICAST) != DNS_CLASS_IN && (class & ~MDNS_CLASS_UNICAST) != DNS_CLASS_ANY) {
+            continue;
+        }
+        uint32_t matched = mdns_match(host, name, type, &additional);
+        if (matched && (class & MDNS_CLASS_UNICAST)) {
+            *unicast = true;
+        }
+        answers |= matched;
+    }
+
+    if (answers == 0) {
+        return 0;
+    }
+    additional &= ~answers;
+
+    dns_writer_t w = { .buf = reply, .max = reply_max, .ok = true };
+    put_u16(&w, legacy ? get_u16(query) : 0);
+    put_u16(&w, DNS_FLAG_QR | DNS_FLAG_AA);
+    put_u16(&w, legacy ? qd_count : 0);
+    put_u32(&w, 0);         // an_count, ns_count
+    put_u16(&w, 0);         // ar_count
+    if (legacy) {
+        // Same offsets as in the query, so compression pointers inside the questions stay valid
+        put_bytes(&w, query + DNS_HEADER_LEN, off - DNS_HEADER_LEN);
+    }
+    int an_count = put_records(&w, host, answers, legacy, false);
+    if (!w.ok) {
+        return -1;
+    }
+    int ar_count = put_records(&w, host, additional, legacy, true);
+    set_u16(reply + 6, an_count);
+    set_u16(reply + 10, ar_count);
+
+    return w.off;
+}
+
+int mdns_build_announce(const mdns_host_t *host, uint8_t *reply, size_t reply_max)
+{
+    if (host->num_of_services > MDNS_MAX_SERVICES) {
+        return -1;
+    }
+
+    uint32_t all = REC_A;
+    for (int i = 0; i < host->num_of_services; ++i) {
+        all |= REC_ENUM(i) | REC_PTR(i) | REC_SRV(i) | REC_TXT(i);
+    }
+
+    dns_writer_t w = { .buf = reply, .max = reply_max, .ok = true };
+    put_u16(&w, 0);
+    put_u16(&w, DNS_FLAG_QR | DNS_FLAG_AA);
+    put_u16(&w, 0);
+    put_u16(&w, 0);
+    put_u32(&w, 0);
+    int an_count = put_records(&w, host, all, false, false);
+    if (!w.ok) {
+        return -1;
+    }
+    set_u16(reply + 6, an_count);
+
+    return w.off;
+}
@@ -19,7 +19,9 @@
 #include "dns_server.h"
 
 #define DNS_PORT (53)
-#define DNS_MAX_LEN (256)
+#define DNS_MAX_LEN (512)
+#define MDNS_ANNOUNCE_COUNT (2)
+#define MDNS_ANNOUNCE_INTERVAL_MS (1000)
 
 #define OPCODE_MASK (0x7800)
 #define QR_FLAG (1 << 7)
@@ -28,6 +30,10 @@
 
 static const char *TAG = "DNS_SERVER";
 
+// One task serves both DNS and mDNS: the captive portal instance during provisioning, which ends
+// in a restart, or the mDNS responder afterwards
+static dns_server_handle_t s_running = NULL;
+
 // DNS Header Packet
 typedef struct __attribute__((__packed__))
 {
@@ -60,42 +66,16 @@ typedef struct __attribute__((__packed__))
 struct dns_server_handle {
     bool started;
     TaskHandle_t task;
+    dns_mdns_config_t mdns;
+    uint32_t mdns_ip;           // address the responder joined the group with and announced
+    int mdns_announce;          // announcements left to send
+    TickType_t mdns_announce_tick;
+    char rx_buffer[DNS_MAX_LEN];    // packet buffers live here rather than on the task stack
+    char reply[DNS_MAX_LEN];
     int num_of_entries;
     dns_entry_pair_t entry[];
 };
 
-/*
-    Parse the name from the packet from the DNS name format to a regular .-seperated name
-    returns the pointer to the next part of the packet
-*/
-static char *parse_dns_name(char *raw_name, char *parsed_name, size_t parsed_name_max_len)
-{
-
-    char *label = raw_name;
-    char *name_itr = parsed_name;
-    int name_len = 0;
-
-    do {
-        int sub_name_len = *label;
-        // (len + 1) since we are adding  a '.'
-        name_len += (sub_name_len + 1);
-        if (name_len > parsed_name_max_len) {
-            return NULL;
-        }
-
-        // Copy the sub name that follows the the label
-        memcpy(name_itr, label + 1, sub_name_len);
-        name_itr[sub_name_len] = '.';
-        name_itr += (sub_name_len + 1);
-        label += sub_name_len + 1;
-    } while (*label != 0);
-
-    // Terminate the final string, replacing the last '.'
-    parsed_name[name_len - 1] = '\0';
-    // Return pointer to first char after the name
-    return label + 1;
-}
-
 // Parses the DNS request and prepares a DNS response with the IP of the softAP
 static int parse_dns_request(char *req, size_t req_len, char *dns_reply, size_t dns_reply_max_len, dns_server_handle_t h)
 {
@@ -131,17 +111,17 @@ static int parse_dns_request(char *req, size_t req_len, char *dns_reply, size_t
     // Pointer to current answer and question
     char *cur_ans_ptr = dns_reply + req_len;
     char *cur_qd_ptr = dns_reply + sizeof(dns_header_t);
-    char name[128];
+    char name[DNS_NAME_MAX_LEN];
 
     // Respond to all questions based on configured rules
     for (int qd_i = 0; qd_i < qd_count; qd_i++) {
-        char *name_end_ptr = parse_dns_name(cur_qd_ptr, name, sizeof(name));
-        if (name_end_ptr == NULL) {
-            ESP_LOGE(TAG, "Failed to parse DNS question: %s", cur_qd_ptr);
+        int name_end = dns_name_parse((uint8_t *)dns_reply, req_len, cur_qd_ptr - dns_reply, name, sizeof(name));
+        if (name_end < 0 || name_end + sizeof(dns_question_t) > req_len) {
+            ESP_LOGE(TAG, "Failed to parse DNS question");
             return -1;
         }
 
-        dns_question_t *question = (dns_question_t *)(name_end_ptr);
+        dns_question_t *question = (dns_question_t *)(dns_reply + name_end);
         uint16_t qd_type = ntohs(question->type);
         uint16_t qd_class = ntohs(question->class);
 
@@ -183,51 +163,222 @@ static int parse_dns_request(char *req, size_t req_len, char *dns_reply, size_t
     return reply_len;
 }
 
+static uint32_t mdns_if_ip(dns_server_handle_t h)
+{
+    esp_netif_ip_info_t ip_info = { 0 };
+    esp_netif_t *netif = esp_netif_get_handle_from_ifkey(h->mdns.if_key);
+    if (netif == NULL || esp_netif_get_ip_info(netif, &ip_info) != ESP_OK) {
+        return IPADDR_ANY;
+    }
+    return ip_info.ip.addr;
+}
+
+static int mdns_socket_open(uint32_t if_ip)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    if (sock < 0) {
+        ESP_LOGE(TAG, "Unable to create mDNS socket: errno %d", errno);
+        return -1;
+    }
+
+    int reuse = 1;
+    uint8_t ttl = 255;
+    uint8_t loop = 0;
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(MDNS_PORT),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    struct ip_mreq mreq = {
+        .imr_multiaddr.s_addr = inet_addr(MDNS_MULTICAST_ADDR),
+        .imr_interface.s_addr = if_ip,
+    };
+    struct in_addr iface = { .s_addr = if_ip };
+
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0
+            || setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0
+            || setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface)) < 0
+            || setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0
+            || setsockopt(sock, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0) {
+        ESP_LOGE(TAG, "Unable to set up mDNS socket: errno %d", errno);
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+static void mdns_host(dns_server_handle_t h, mdns_host_t *host)
+{
+    host->hostname = h->mdns.hostname;
+    host->ip = h->mdns_ip;
+    host->num_of_services = h->mdns.num_of_services;
+    host->service = h->mdns.service;
+}
+
+static void mdns_send(int sock, const char *data, int len, const struct sockaddr_in *dest)
+{
+    struct sockaddr_in group = {
+        .sin_family = AF_INET,
+        .sin_port = htons(MDNS_PORT),
+        .sin_addr.s_addr = inet_addr(MDNS_MULTICAST_ADDR),
+    };
+    if (dest == NULL) {
+        dest = &group;
+    }
+    if (sendto(sock, data, len, 0, (const struct sockaddr *)dest, sizeof(*dest)) < 0) {
+        ESP_LOGW(TAG, "mDNS send failed: errno %d", errno);
+    }
+}
+
+/*
+    Keeps the mDNS socket joined with the current interface address,
+    announces the records after start and after an address change
+*/
+static int mdns_tick(dns_server_handle_t h, int sock, char *reply)
+{
+    uint32_t ip = mdns_if_ip(h);
+
+    if (ip != h->mdns_ip && sock >= 0) {
+        // Group membership is bound to the old address
+        close(sock);
+        sock = -1;
+    }
+    if (sock < 0 && ip != IPADDR_ANY) {
+        sock = mdns_socket_open(ip);
+        if (sock >= 0) {
+            h->mdns_ip = ip;
+            h->mdns_announce = MDNS_ANNOUNCE_COUNT;
+            h->mdns_announce_tick = xTaskGetTickCount() - pdMS_TO_TICKS(MDNS_ANNOUNCE_INTERVAL_MS);
+            ESP_LOGI(TAG, "mDNS responder for %s.local, port %d", h->mdns.hostname, MDNS_PORT);
+        }
+    }
+
+    if (sock >= 0 && h->mdns_announce > 0
+            && xTaskGetTickCount() - h->mdns_announce_tick >= pdMS_TO_TICKS(MDNS_ANNOUNCE_INTERVAL_MS)) {
+        mdns_host_t host;
+        mdns_host(h, &host);
+        int len = mdns_build_announce(&host, (uint8_t *)reply, DNS_MAX_LEN);
+        if (len > 0) {
+            mdns_send(sock, reply, len, NULL);
+        }
+        h->mdns_announce--;
+        h->mdns_announce_tick = xTaskGetTickCount();
+    }
+
+    return sock;
+}
+
+static int mdns_handle_query(dns_server_handle_t h, int sock, char *rx_buffer, char *reply)
+{
+    struct sockaddr_in source_addr;
+    socklen_t socklen = sizeof(source_addr);
+    int len = recvfrom(sock, rx_buffer, DNS_MAX_LEN, 0, (struct sockaddr *)&source_addr, &socklen);
+    if (len < 0) {
+        ESP_LOGE(TAG, "mDNS recvfrom failed: errno %d", errno);
+        return -1;
+    }
+
+    mdns_host_t host;
+    mdns_host(h, &host);
+    // Resolvers sending from another port are not mDNS aware and expect a plain unicast answer
+    bool legacy = ntohs(source_addr.sin_port) != MDNS_PORT;
+    bool unicast;
+    int reply_len = mdns_build_response((uint8_t *)rx_buffer, len, &host, legacy, (uint8_t *)reply, DNS_MAX_LEN, &unicast);
+
+    ESP_LOGD(TAG, "mDNS query with %d bytes | reply with len: %d", len, reply_len);
+    if (reply_len > 0) {
+        mdns_send(sock, reply, reply_len, legacy || unicast ? &source_addr : NULL);
+    }
+
+    return 0;
+}
+
 /*
     Sets up a socket and listen for DNS queries,
-    replies to all type A queries with the IP of the softAP
+    replies to all type A queries with the IP of the softAP.
+    Also runs the mDNS responder, if configured, from the same task.
 */
 void dns_server_task(void *pvParameters)
 {
-    char rx_buffer[128];
+    dns_server_handle_t handle = pvParameters;
+    char *rx_buffer = handle->rx_buffer;
+    char *reply = handle->reply;
     char addr_str[128];
     int addr_family;
     int ip_protocol;
-    dns_server_handle_t handle = pvParameters;
+    int mdns_sock = -1;
 
     while (handle->started) {
 
-        struct sockaddr_in dest_addr;
-        dest_addr.sin_addr.s_addr = htonl(INADDR_ANY);
-        dest_addr.sin_family = AF_INET;
-        dest_addr.sin_port = htons(DNS_PORT);
-        addr_family = AF_INET;
-        ip_protocol = IPPROTO_IP;
-        inet_ntoa_r(dest_addr.sin_addr, addr_str, sizeof(addr_str) - 1);
-
-        int sock = socket(addr_family, SOCK_DGRAM, ip_protocol);
-        if (sock < 0) {
-            ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
-            break;
-        }
-        ESP_LOGI(TAG, "Socket created");
+        int sock = -1;
+        if (handle->num_of_entries > 0) {
+            struct sockaddr_in dest_addr;
+            dest_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+            dest_addr.sin_family = AF_INET;
+            dest_addr.sin_port = htons(DNS_PORT);
+            addr_family = AF_INET;
+            ip_protocol = IPPROTO_IP;
+            inet_ntoa_r(dest_addr.sin_addr, addr_str, sizeof(addr_str) - 1);
+
+            sock = socket(addr_family, SOCK_DGRAM, ip_protocol);
+            if (sock < 0) {
+                ESP_LOGE(TAG, "Unable to create socket: errno %d", errno);
+                break;
+            }
+            ESP_LOGI(TAG, "Socket created");
 
-        int err = bind(sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
-        if (err < 0) {
-            ESP_LOGE(TAG, "Socket unable to bind: errno %d", errno);
+            int err = bind(sock, (struct sockaddr *)&dest_addr, sizeof(dest_addr));
+            if (err < 0) {
+                ESP_LOGE(TAG, "Socket unable to bind: errno %d", errno);
+            }
+            ESP_LOGI(TAG, "Socket bound, port %d", DNS_PORT);
         }
-        ESP_LOGI(TAG, "Socket bound, port %d", DNS_PORT);
 
         while (handle->started) {
+            if (handle->mdns.hostname) {
+                mdns_sock = mdns_tick(handle, mdns_sock, reply);
+            }
+
+            fd_set readfds;
+            FD_ZERO(&readfds);
+            if (sock >= 0) {
+                FD_SET(sock, &readfds);
+            }
+            if (mdns_sock >= 0) {
+                FD_SET(mdns_sock, &readfds);
+            }
+            // Wake up regularly for the mDNS announcements and address changes
+            struct timeval timeout = { .tv_sec = 1 };
             ESP_LOGD(TAG, "Waiting for data");
+            int ready = select(MAX(sock, mdns_sock) + 1, &readfds, NULL, NULL, &timeout);
+            if (ready < 0) {
+                ESP_LOGE(TAG, "select failed: errno %d", errno);
+                vTaskDelay(pdMS_TO_TICKS(MDNS_ANNOUNCE_INTERVAL_MS));
+                break;
+            }
+
+            if (mdns_sock >= 0 && FD_ISSET(mdns_sock, &readfds)
+                    && mdns_handle_query(handle, mdns_sock, rx_buffer, reply) < 0) {
+                close(mdns_sock);
+                mdns_sock = -1;
+                handle->mdns_ip = IPADDR_ANY;
+            }
+
+            if (sock < 0 || !FD_ISSET(sock, &readfds)) {
+                continue;
+            }
+
             struct sockaddr_in6 source_addr; // Large enough for both IPv4 or IPv6
             socklen_t socklen = sizeof(source_addr);
-            int len = recvfrom(sock, rx_buffer, sizeof(rx_buffer) - 1, 0, (struct sockaddr *)&source_addr, &socklen);
+            int len = recvfrom(sock, rx_buffer, DNS_MAX_LEN - 1, 0, (struct sockaddr *)&source_addr, &socklen);
 
             // Error occurred during receiving
             if (len < 0) {
                 ESP_LOGE(TAG, "recvfrom failed: errno %d", errno);
                 close(sock);
+                sock = -1;
                 break;
             }
             // Data received
@@ -242,7 +393,6 @@ void dns_server_task(void *pvParameters)
                 // Null-terminate whatever we received and treat like a string...
                 rx_buffer[len] = 0;
 
-                char reply[DNS_MAX_LEN];
                 int reply_len = parse_dns_request(rx_buffer, len, reply, DNS_MAX_LEN, handle);
 
                 ESP_LOGD(TAG, "Received %d bytes from %s | DNS reply with len: %d", len, addr_str, reply_len);
@@ -264,19 +414,26 @@ void dns_server_task(void *pvParameters)
             close(sock);
         }
     }
+    if (mdns_sock != -1) {
+        close(mdns_sock);
+    }
     vTaskDelete(NULL);
 }
 
 dns_server_handle_t start_dns_server(dns_server_config_t *config)
 {
+    ESP_RETURN_ON_FALSE(s_running == NULL, NULL, TAG, "DNS server already running");
+
     dns_server_handle_t handle = calloc(1, sizeof(struct dns_server_handle) + config->num_of_entries * sizeof(dns_entry_pair_t));
     ESP_RETURN_ON_FALSE(handle, NULL, TAG, "Failed to allocate dns server handle");
 
     handle->started = true;
+    handle->mdns = config->mdns;
     handle->num_of_entries = config->num_of_entries;
     memcpy(handle->entry, config->item, config->num_of_entries * sizeof(dns_entry_pair_t));
 
     xTaskCreate(dns_server_task, "dns_server", 4096, handle, 5, &handle->task);
+    s_running = handle;
     return handle;
 }
 
@@ -286,5 +443,6 @@ void stop_dns_server(dns_server_handle_t handle)
         handle->started = false;
         vTaskDelete(handle->task);
         free(handle);
+        s_running = NULL;
     }
 }
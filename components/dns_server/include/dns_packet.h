@@ -0,0 +1,81 @@
+/*
+ * SPDX-FileCopyrightText: 2021-2023 Espressif Systems (Shanghai) CO LTD
+ *
+ * SPDX-License-Identifier: Unlicense OR CC0-1.0
+ */
+
+/*
+ * DNS packet helpers shared by the captive DNS server and the mDNS responder.
+ * Pure C on byte buffers, no lwIP or ESP-IDF dependency, so it can be built and tested on the host.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define DNS_HEADER_LEN          (12)
+#define DNS_NAME_MAX_LEN        (128)   /**<! Longest dotted name handled, including '\0' */
+
+#define DNS_TYPE_A              (1)
+#define DNS_TYPE_PTR            (12)
+#define DNS_TYPE_TXT            (16)
+#define DNS_TYPE_SRV            (33)
+#define DNS_TYPE_ANY            (255)
+
+#define MDNS_PORT               (5353)
+#define MDNS_MULTICAST_ADDR     "224.0.0.251"
+#define MDNS_MAX_SERVICES       (7)
+
+/**
+ * @brief Read a name at `off` into dotted form, following compression pointers
+ *
+ * @return offset of the first byte after the name as stored at `off`, -1 if malformed or too long
+ */
+int dns_name_parse(const uint8_t *pkt, size_t len, size_t off, char *name, size_t name_max);
+
+/**
+ * @brief One DNS-SD service, e.g. type "_http._tcp", port 80, txt "path=/"
+ */
+typedef struct mdns_service {
+    const char *type;       /**<! "_service._proto", without ".local" */
+    uint16_t port;
+    const char *txt;        /**<! Single "key=value" TXT entry, NULL for none */
+} mdns_service_t;
+
+/**
+ * @brief What the responder answers for: `<hostname>.local` and one instance named `<hostname>` per service
+ */
+typedef struct mdns_host {
+    const char *hostname;   /**<! Single label, without ".local" */
+    uint32_t ip;            /**<! IPv4 address in network byte order */
+    int num_of_services;
+    const mdns_service_t *service;
+} mdns_host_t;
+
+/**
+ * @brief Build the response to an mDNS query
+ *
+ * @param legacy  query came from a port other than 5353 (one-shot resolver): echo the id and the
+ *                questions and use short TTLs, the reply goes back to the sender
+ * @param unicast set when a question asked for a unicast response (QU bit)
+ * @return reply length, 0 when nothing is asked about this host, -1 if the query is malformed
+ */
+int mdns_build_response(const uint8_t *query, size_t query_len, const mdns_host_t *host, bool legacy,
+                        uint8_t *reply, size_t reply_max, bool *unicast);
+
+/**
+ * @brief Build an unsolicited response announcing the address and every service
+ *
+ * @return reply length, -1 if it does not fit
+ */
+int mdns_build_announce(const mdns_host_t *host, uint8_t *reply, size_t reply_max);
+
+#ifdef __cplusplus
+}
+#endif
@@ -6,6 +6,8 @@
 
 #pragma once
 
+#include "dns_packet.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -14,6 +16,10 @@ extern "C" {
 #define DNS_SERVER_MAX_ITEMS 1
 #endif
 
+#ifndef DNS_SERVER_MDNS_MAX_SERVICES
+#define DNS_SERVER_MDNS_MAX_SERVICES 2
+#endif
+
 #define DNS_SERVER_CONFIG_SINGLE(queried_name, netif_key)  {        \
         .num_of_entries = 1,                                        \
         .item = { { .name = queried_name, .if_key = netif_key } }   \
@@ -31,6 +37,21 @@ typedef struct dns_entry_pair {
     esp_ip4_addr_t ip;      /**<! Constant IP address to answer this query, if "if_key==NULL" */
 } dns_entry_pair_t;
 
+/**
+ * @brief mDNS responder answered from the DNS server task on UDP 5353
+ *
+ * Answers A queries for `<hostname>.local` and DNS-SD queries for the services, each published as one
+ * instance named `<hostname>`. No probing: the name is expected to be unique on the link.
+ *
+ * @note Same as for the entries, strings are not copied
+ */
+typedef struct dns_mdns_config {
+    const char* hostname;   /**<! Single label without ".local", NULL disables the responder */
+    const char* if_key;     /**<! Network interface whose IPv4 address is answered and that joins the group */
+    int num_of_services;    /**<! Number of services below */
+    mdns_service_t service[DNS_SERVER_MDNS_MAX_SERVICES];  /**<! Services advertised, e.g. {"_http._tcp", 80, "path=/"} */
+} dns_mdns_config_t;
+
 /**
  * @brief DNS server config struct defining the rules for answering DNS (A type) queries
  *
@@ -50,6 +71,7 @@ typedef struct dns_entry_pair {
 typedef struct dns_server_config {
     int num_of_entries;                             /**<! Number of rules specified in the config struct */
     dns_entry_pair_t item[DNS_SERVER_MAX_ITEMS];    /**<! Array of pairs */
+    dns_mdns_config_t mdns;                         /**<! Optional mDNS responder */
 } dns_server_config_t;
 
 /**
@@ -61,6 +83,10 @@ typedef struct dns_server_handle *dns_server_handle_t;
  * @brief Set ups and starts a simple DNS server that will respond to all A queries (IPv4)
  * based on configured rules, pairs of name and either IPv4 address or a netif ID (to respond by it's IPv4 add)
  *
+ * With `num_of_entries == 0` only the mDNS responder runs, port 53 is left alone.
+ * One server runs at a time, the DNS entries and the mDNS responder share its task (4 KB stack, packet
+ * buffers in the handle). Starting a second one fails until the first is stopped.
+ *
  * @param config Configuration structure listing the pairs of (name, IP/netif-id)
  * @return dns_server's handle on success, NULL on failure
  */
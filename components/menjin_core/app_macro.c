@@ -0,0 +1,190 @@
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "app_macro.h"
+
+static const char *TAG = "APP_MACRO";
+
+// 宏结束后继续屏蔽振铃检测的时间，免提关闭时的声音也会触发
+#define MACRO_RING_HOLDOFF_MS   1000
+
+static app_macro_t g_macros[APP_MACRO_MAX];
+static int g_macro_count = 0;
+static portMUX_TYPE g_macro_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 正在执行的宏，保存副本，执行中重新加载不受影响
+static app_macro_t g_run;
+static uint8_t g_run_step = 0;
+static menjin_prio_t g_run_prio = MENJIN_PRIO_REMOTE;
+static volatile bool g_running = false;
+static esp_timer_handle_t g_step_timer = NULL;
+
+int app_macro_parse(const char *str, app_macro_t *macros, int max)
+{
+    int count = 0;
+    const char *p = str;
+
+    while (1) {
+        while (*p == ';' || *p == ' ') {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        if (count >= max) {
+            return -1;
+        }
+
+        app_macro_t *m = &macros[count];
+        memset(m, 0, sizeof(app_macro_t));
+
+        const char *eq = strchr(p, '=');
+        size_t name_len = eq != NULL ? eq - p : 0;
+        if (name_len == 0 || name_len >= APP_MACRO_NAME_LEN || memchr(p, ';', name_len) != NULL) {
+            return -1;
+        }
+        memcpy(m->name, p, name_len);
+        p = eq + 1;
+
+        // cmd[,delay_ms,cmd]...
+        while (1) {
+            char *end;
+            unsigned long cmd = strtoul(p, &end, 0);
+            if (end == p || cmd > UINT8_MAX || m->step_count >= APP_MACRO_STEPS_MAX) {
+                return -1;
+            }
+            m->steps[m->step_count++].cmd = cmd;
+            p = end;
+            if (*p != ',') {
+                break;
+            }
+
+            unsigned long delay_ms = strtoul(++p, &end, 10);
+            if (end == p || delay_ms > UINT16_MAX || *end != ',') {
+                return -1;
+            }
+            m->steps[m->step_count - 1].delay_ms = delay_ms;
+            p = end + 1;
+        }
+
+        if (*p != ';' && *p != '\0') {
+            return -1;
+        }
+        count++;
+    }
+
+    return count;
+}
+
+static esp_err_t macro_step(void)
+{
+    const app_macro_step_t *step = &g_run.steps[g_run_step];
+
+    esp_err_t ret = menjin_cmd_enqueue(step->cmd, g_run_prio, NULL, NULL);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "macro '%s' aborted at step %d: %s", g_run.name, g_run_step, esp_err_to_name(ret));
+        g_running = false;
+        return ret;
+    }
+
+    if (++g_run_step >= g_run.step_count) {
+        ESP_LOGI(TAG, "macro '%s' done", g_run.name);
+        g_running = false;
+        return ESP_OK;
+    }
+
+    esp_timer_start_once(g_step_timer, (uint64_t) step->delay_ms * 1000);
+
+    return ESP_OK;
+}
+
+static void macro_timer_cb(void *arg)
+{
+    macro_step();
+}
+
+esp_err_t app_macro_reload(const char *macros_str)
+{
+    app_macro_t macros[APP_MACRO_MAX];
+
+    int count = app_macro_parse(macros_str, macros, APP_MACRO_MAX);
+    ESP_RETURN_ON_FALSE(count >= 0, ESP_ERR_INVALID_ARG, TAG, "invalid macros: %s", macros_str);
+
+    taskENTER_CRITICAL(&g_macro_lock);
+    memcpy(g_macros, macros, sizeof(macros));
+    g_macro_count = count;
+    taskEXIT_CRITICAL(&g_macro_lock);
+
+    for (int i = 0; i < count; ++i) {
+        ESP_LOGI(TAG, "macro '%s': %d steps", macros[i].name, macros[i].step_count);
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t app_macro_init(const char *macros_str)
+{
+    const esp_timer_create_args_t timer_args = {
+            .callback = macro_timer_cb,
+            .name = "macro_step",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &g_step_timer), TAG, "esp_timer_create failed");
+
+    return app_macro_reload(macros_str);
+}
+
+esp_err_t app_macro_run(const char *name, menjin_prio_t prio)
+{
+    ESP_RETURN_ON_FALSE(g_step_timer != NULL, ESP_ERR_INVALID_STATE, TAG, "macro not initialized");
+
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    taskENTER_CRITICAL(&g_macro_lock);
+    if (g_running) {
+        ret = strcmp(g_run.name, name) == 0 ? ESP_OK : ESP_ERR_INVALID_STATE;
+        taskEXIT_CRITICAL(&g_macro_lock);
+        ESP_LOGW(TAG, "macro '%s' requested while '%s' running, %s", name, g_run.name,
+                 ret == ESP_OK ? "coalesced" : "rejected");
+        return ret;
+    }
+    for (int i = 0; i < g_macro_count; ++i) {
+        if (strcmp(g_macros[i].name, name) == 0) {
+            g_run = g_macros[i];
+            g_run_step = 0;
+            g_run_prio = prio;
+            g_running = true;
+            ret = ESP_OK;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&g_macro_lock);
+
+    ESP_RETURN_ON_ERROR(ret, TAG, "macro '%s' not found", name);
+
+    uint32_t duration_ms = 0;
+    for (int i = 0; i + 1 < g_run.step_count; ++i) {
+        duration_ms += g_run.steps[i].delay_ms;
+    }
+    ESP_LOGI(TAG, "macro '%s' start, %d steps, %" PRIu32 " ms", g_run.name, g_run.step_count, duration_ms);
+
+    // 第一步在调用者上下文入队，失败直接返回给调用者；macro_step 已清除 g_running
+    ret = macro_step();
+    if (ret != ESP_OK) {
+        return ret;
+    }
+
+    // 接听的时候会有声音，会导致触发振铃检测；第一步入队后才屏蔽，屏蔽只能延长，失败时不能再撤销
+    menjin_ring_suppress(duration_ms + MACRO_RING_HOLDOFF_MS);
+
+    return ESP_OK;
+}
+
+bool app_macro_is_running(void)
+{
+    return g_running;
+}
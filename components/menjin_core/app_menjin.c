@@ -0,0 +1,629 @@
+//
+// Created by Hessian on 2023/7/30.
+//
+#include <string.h>
+#include <inttypes.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_check.h"
+
+#include "app_menjin.h"
+#include "i2c_health.h"
+#include "latency_hist.h"
+#include "menjin_bus.h"
+
+
+static const char *TAG = "APP_MENJIN";
+
+// I2C 命令队列
+#define MENJIN_CMD_QUEUE_LEN         8                // 每个优先级的队列长度
+#define MENJIN_CMD_WRITER_PRIO       12               // 高于按键和键盘任务
+// 键盘总线空闲时检查 SDA/SCL 是否被拉低的周期
+#define KEYBOARD_IDLE_CHECK_MS       1000
+// 自动调速：某一速率错误达到该次数即放弃，不再继续探测
+#define AUTOTUNE_ABORT_ERRORS        4
+
+static volatile TickType_t g_ring_suppress_until = 0; // 在此之前不回调振铃
+
+// 调用方给出的配置，键盘总线一直使用初始化时的地址和速率
+static menjin_config_t g_config = {0};
+// 主控总线当前生效的参数，仅由写任务修改
+static uint8_t g_menjin_addr = 0;
+static uint32_t g_menjin_clock = 0;
+// menjin_reconfigure() 请求的参数，写任务在两条命令之间应用
+static uint8_t g_pending_addr = 0;
+static uint32_t g_pending_clock = 0;
+static portMUX_TYPE g_pending_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/**
+ * @brief i2c master initialization
+ */
+static esp_err_t menjin_i2c_init(uint8_t addr, uint32_t clock)
+{
+    g_menjin_addr = addr;
+    g_menjin_clock = clock;
+
+    return menjin_bus_master_init(g_menjin_addr, g_menjin_clock);
+}
+
+/**
+ * @brief i2c slave initialization
+ */
+static esp_err_t keyboard_i2c_init(void)
+{
+    return menjin_bus_slave_init(g_config.addr, g_config.clock);
+}
+
+_Noreturn static void keyboard_i2c_read_task(void *param);
+_Noreturn static void menjin_cmd_writer_task(void *param);
+
+typedef struct {
+    uint8_t data[MENJIN_FRAME_MAX];
+    uint8_t len;
+    int64_t enqueue_us;
+    menjin_cmd_done_cb_t done_cb;
+    void *arg;
+} menjin_cmd_item_t;
+
+static QueueHandle_t g_cmd_queues[MENJIN_PRIO_MAX] = {NULL};
+static SemaphoreHandle_t g_cmd_pending = NULL;   // counts items across all queues
+static volatile bool g_reconfig_pending = false;
+static volatile bool g_autotune_pending = false;
+static menjin_queue_stats_t g_queue_stats = {0};
+static portMUX_TYPE g_queue_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static menjin_bridge_stats_t g_bridge_stats = {0};
+static latency_hist_t g_latency_hist = {0};
+// 总线健康统计，同样由 g_queue_stats_lock 保护
+static i2c_health_t g_master_health;
+static i2c_health_t g_keyboard_health;
+// 自动调速结果，同样由 g_queue_stats_lock 保护
+static menjin_autotune_result_t g_autotune = {0};
+
+// 自动调速的候选速率，从慢到快
+static const uint32_t g_autotune_clocks[] = {10000, 20000, 50000, 100000, 200000, 400000};
+
+/**
+ * @brief i2c master initialization
+ */
+esp_err_t menjin_init(const menjin_config_t *config)
+{
+    ESP_LOGI(TAG, "Initializing Menjin...");
+
+    g_config = *config;
+    g_pending_addr = config->addr;
+    g_pending_clock = config->clock;
+
+    ESP_ERROR_CHECK(menjin_i2c_init(config->addr, config->clock));
+    ESP_ERROR_CHECK(keyboard_i2c_init());
+
+    i2c_health_init(&g_master_health, CONFIG_MENJIN_I2C_ERROR_THRESHOLD, CONFIG_MENJIN_I2C_RECOVER_MAX);
+    i2c_health_init(&g_keyboard_health, CONFIG_MENJIN_I2C_ERROR_THRESHOLD, CONFIG_MENJIN_I2C_RECOVER_MAX);
+
+    for (int i = 0; i < MENJIN_PRIO_MAX; ++i) {
+        g_cmd_queues[i] = xQueueCreate(MENJIN_CMD_QUEUE_LEN, sizeof(menjin_cmd_item_t));
+        ESP_RETURN_ON_FALSE(g_cmd_queues[i] != NULL, ESP_ERR_NO_MEM, TAG, "No memory for cmd queue");
+    }
+    g_cmd_pending = xSemaphoreCreateCounting(MENJIN_CMD_QUEUE_LEN * MENJIN_PRIO_MAX, 0);
+    ESP_RETURN_ON_FALSE(g_cmd_pending != NULL, ESP_ERR_NO_MEM, TAG, "No memory for cmd semaphore");
+
+    xTaskCreate(menjin_cmd_writer_task, "menjin_cmd_writer_task", 2560, NULL, MENJIN_CMD_WRITER_PRIO, NULL);
+    xTaskCreate(keyboard_i2c_read_task, "keyboard_i2c_read_task", 2560, NULL, 10, NULL);
+
+    return ESP_OK;
+}
+
+esp_err_t menjin_stop()
+{
+    return menjin_bus_master_deinit();
+}
+
+/**
+ * @brief Write a command to the controller
+ *
+ * Only called from the writer task, so bus access is serialized.
+ *
+ * @param data data to send
+ * @param len  number of bytes, sent in one transaction
+ */
+static esp_err_t menjin_cmd_write(const uint8_t *data, size_t len)
+{
+    esp_err_t ret = menjin_bus_master_write(data, len);
+
+    ESP_LOGD(TAG, "menjin_cmd_write[0x%02x]: 0x%02x, len: %d", g_menjin_addr, data[0], (int) len);
+
+    return ret;
+}
+
+/**
+ * @brief Re-install the master driver with the last requested parameters, called from the writer task only
+ */
+static esp_err_t menjin_i2c_reconfig(void)
+{
+    taskENTER_CRITICAL(&g_pending_lock);
+    uint8_t addr = g_pending_addr;
+    uint32_t clock = g_pending_clock;
+    taskEXIT_CRITICAL(&g_pending_lock);
+
+    menjin_bus_master_deinit();
+    esp_err_t ret = menjin_i2c_init(addr, clock);
+
+    ESP_LOGI(TAG, "I2C master reconfigured, address: 0x%02x, clock: %" PRIu32 ", ret: %d", g_menjin_addr, g_menjin_clock, ret);
+
+    return ret;
+}
+
+/**
+ * @brief Clock the master bus free and re-install the driver, called from the writer task only
+ */
+static void menjin_i2c_recover(void)
+{
+    menjin_bus_master_deinit();
+    bool bus_free = menjin_bus_master_recover(g_menjin_clock);
+
+    esp_err_t ret = menjin_i2c_init(g_menjin_addr, g_menjin_clock);
+
+    taskENTER_CRITICAL(&g_queue_stats_lock);
+    i2c_health_recovered(&g_master_health, bus_free);
+    taskEXIT_CRITICAL(&g_queue_stats_lock);
+
+    ESP_LOGW(TAG, "I2C master bus recovered, SDA %s, reinstall ret: %d", bus_free ? "released" : "still low", ret);
+}
+
+static i2c_health_event_t menjin_i2c_event(esp_err_t ret)
+{
+    switch (ret) {
+        case ESP_OK:
+            return I2C_HEALTH_OK;
+        case ESP_FAIL:
+            return I2C_HEALTH_NACK;
+        case ESP_ERR_TIMEOUT:
+            // 旧版驱动把仲裁丢失也报告为超时，此时总线已空闲；真正的超时总有一条线被拉低
+            if (menjin_bus_master_idle()) {
+                return I2C_HEALTH_ARB_LOST;
+            }
+            return I2C_HEALTH_TIMEOUT;
+        default:
+            return I2C_HEALTH_ERROR;
+    }
+}
+
+void menjin_get_health_stats(i2c_health_stats_t *master, i2c_health_stats_t *keyboard)
+{
+    taskENTER_CRITICAL(&g_queue_stats_lock);
+    *master = g_master_health.stats;
+    *keyboard = g_keyboard_health.stats;
+    taskEXIT_CRITICAL(&g_queue_stats_lock);
+}
+
+void menjin_reconfigure(uint8_t addr, uint32_t clock)
+{
+    if (g_cmd_pending == NULL) {
+        return;
+    }
+
+    taskENTER_CRITICAL(&g_pending_lock);
+    g_pending_addr = addr;
+    g_pending_clock = clock;
+    taskEXIT_CRITICAL(&g_pending_lock);
+    g_reconfig_pending = true;
+    // 信号量满时写任务仍有待处理命令，处理前会看到标志
+    xSemaphoreGive(g_cmd_pending);
+}
+
+uint32_t menjin_get_clock()
+{
+    return g_menjin_clock;
+}
+
+void menjin_set_clock(uint32_t clock)
+{
+    taskENTER_CRITICAL(&g_pending_lock);
+    uint8_t addr = g_pending_addr;
+    taskEXIT_CRITICAL(&g_pending_lock);
+
+    menjin_reconfigure(addr, clock);
+}
+
+esp_err_t menjin_autotune_start(void)
+{
+    if (g_cmd_pending == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    taskENTER_CRITICAL(&g_queue_stats_lock);
+    bool running = g_autotune.state == MENJIN_AUTOTUNE_RUNNING;
+    if (!running) {
+        memset(&g_autotune, 0, sizeof(g_autotune));
+        g_autotune.state = MENJIN_AUTOTUNE_RUNNING;
+    }
+    taskEXIT_CRITICAL(&g_queue_stats_lock);
+    ESP_RETURN_ON_FALSE(!running, ESP_ERR_INVALID_STATE, TAG, "autotune already running");
+
+    g_autotune_pending = true;
+    xSemaphoreGive(g_cmd_pending);
+
+    return ESP_OK;
+}
+
+void menjin_get_autotune_result(menjin_autotune_result_t *result)
+{
+    taskENTER_CRITICAL(&g_queue_stats_lock);
+    *result = g_autotune;
+    taskEXIT_CRITICAL(&g_queue_stats_lock);
+}
+
+/**
+ * @brief Probe the controller at one clock rate, called from the writer task only
+ *
+ * @param ref read-back reference: the first byte read in the sweep, later reads must match it;
+ *            -1 until the first read
+ */
+static void menjin_autotune_rate(uint32_t clock, menjin_autotune_rate_t *rate, int *ref)
+{
+    memset(rate, 0, sizeof(menjin_autotune_rate_t));
+    rate->clock = clock;
+
+    menjin_bus_master_deinit();
+    if (!menjin_bus_master_idle()) {
+        menjin_bus_master_recover(clock);
+    }
+    if (menjin_bus_master_init(g_menjin_addr, clock) != ESP_OK) {
+        rate->errors = 1;
+        return;
+    }
+
+    uint64_t total_us = 0;
+    for (int i = 0; i < CONFIG_MENJIN_I2C_AUTOTUNE_PROBES && rate->errors < AUTOTUNE_ABORT_ERRORS; ++i) {
+        uint8_t data = 0;
+#ifdef CONFIG_MENJIN_I2C_AUTOTUNE_READBACK
+        // 读回时由控制器驱动 SDA 输出数据位，只检查地址 ACK 发现不了数据位采样出错
+        uint8_t *read = i % 2 == 1 ? &data : NULL;
+#else
+        uint8_t *read = NULL;
+#endif
+        int64_t start_us = esp_timer_get_time();
+        esp_err_t ret = menjin_bus_master_probe(read);
+        uint32_t bus_us = esp_timer_get_time() - start_us;
+
+        if (ret == ESP_OK && read != NULL) {
+            if (*ref < 0) {
+                *ref = data;
+            } else if (data != *ref) {
+                ESP_LOGW(TAG, "I2C autotune clock: %" PRIu32 ", read back 0x%02x, expected 0x%02x", clock, data, *ref);
+                ret = ESP_ERR_INVALID_RESPONSE;
+            }
+        }
+
+        rate->probes++;
+        total_us += bus_us;
+        if (bus_us > rate->max_us) {
+            rate->max_us = bus_us;
+        }
+        if (ret != ESP_OK) {
+            rate->errors++;
+        }
+    }
+    rate->avg_us = total_us / rate->probes;
+}
+
+/**
+ * @brief Sweep g_autotune_clocks, apply and save the fastest reliable rate, called from the writer task only
+ *
+ * The sweep goes from slow to fast and stops at the first rate with errors, so every rate below
+ * the chosen one has passed as well.
+ */
+static void menjin_autotune(void)
+{
+    menjin_autotune_rate_t rate;
+    uint32_t best_clock = 0;
+    uint8_t count = 0;
+    int ref = -1;
+
+    ESP_LOGI(TAG, "I2C autotune start, current clock: %" PRIu32, g_menjin_clock);
+
+    for (int i = 0; i < sizeof(g_autotune_clocks) / sizeof(g_autotune_clocks[0]) && i < MENJIN_AUTOTUNE_RATES_MAX; ++i) {
+        menjin_autotune_rate(g_autotune_clocks[i], &rate, &ref);
+
+        taskENTER_CRITICAL(&g_queue_stats_lock);
+        g_autotune.rates[count++] = rate;
+        g_autotune.count = count;
+        taskEXIT_CRITICAL(&g_queue_stats_lock);
+
+        ESP_LOGI(TAG, "I2C autotune clock: %" PRIu32 ", probes: %d, errors: %d, avg: %" PRIu32 "us, max: %" PRIu32 "us",
+                 rate.clock, rate.probes, rate.errors, rate.avg_us, rate.max_us);
+
+        if (rate.errors > 0) {
+            break;
+        }
+        best_clock = rate.clock;
+    }
+
+    // 探测过程改过总线速率，切换到选中的速率，没有选中时回到原速率
+    uint32_t old_clock = g_menjin_clock;
+    if (best_clock > 0) {
+        taskENTER_CRITICAL(&g_pending_lock);
+        g_pending_clock = best_clock;
+        taskEXIT_CRITICAL(&g_pending_lock);
+    }
+    if (menjin_i2c_reconfig() != ESP_OK && best_clock > 0) {
+        ESP_LOGE(TAG, "I2C autotune failed to apply clock %" PRIu32 ", restore %" PRIu32, best_clock, old_clock);
+        taskENTER_CRITICAL(&g_pending_lock);
+        g_pending_clock = old_clock;
+        taskEXIT_CRITICAL(&g_pending_lock);
+        menjin_i2c_reconfig();
+        best_clock = 0;
+    }
+    // 生效之后才保存
+    if (best_clock > 0 && g_config.clock_saved_cb != NULL) {
+        g_config.clock_saved_cb(best_clock);
+    }
+
+    taskENTER_CRITICAL(&g_queue_stats_lock);
+    g_autotune.best_clock = best_clock;
+    g_autotune.state = best_clock > 0 ? MENJIN_AUTOTUNE_DONE : MENJIN_AUTOTUNE_FAILED;
+    taskEXIT_CRITICAL(&g_queue_stats_lock);
+
+    if (best_clock > 0) {
+        ESP_LOGI(TAG, "I2C autotune done, clock: %" PRIu32, best_clock);
+    } else {
+        ESP_LOGW(TAG, "I2C autotune found no reliable clock, keep %" PRIu32, g_menjin_clock);
+    }
+}
+
+esp_err_t menjin_frame_enqueue(const uint8_t *data, size_t len, menjin_prio_t prio, menjin_cmd_done_cb_t done_cb, void *arg)
+{
+    ESP_RETURN_ON_FALSE(prio < MENJIN_PRIO_MAX, ESP_ERR_INVALID_ARG, TAG, "invalid prio %d", prio);
+    ESP_RETURN_ON_FALSE(len > 0 && len <= MENJIN_FRAME_MAX, ESP_ERR_INVALID_SIZE, TAG, "invalid frame len %d", (int) len);
+
+    if (g_cmd_pending == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    menjin_cmd_item_t item = {
+            .len = len,
+            .enqueue_us = esp_timer_get_time(),
+            .done_cb = done_cb,
+            .arg = arg,
+    };
+    memcpy(item.data, data, len);
+
+    if (xQueueSend(g_cmd_queues[prio], &item, 0) != pdTRUE) {
+        taskENTER_CRITICAL(&g_queue_stats_lock);
+        g_queue_stats.dropped++;
+        taskEXIT_CRITICAL(&g_queue_stats_lock);
+        ESP_LOGW(TAG, "menjin cmd queue[%d] full, drop 0x%02x, len: %d", prio, data[0], (int) len);
+        return ESP_ERR_NO_MEM;
+    }
+    xSemaphoreGive(g_cmd_pending);
+
+    uint32_t depth = uxQueueMessagesWaiting(g_cmd_queues[prio]);
+    taskENTER_CRITICAL(&g_queue_stats_lock);
+    g_queue_stats.enqueued++;
+    if (depth > g_queue_stats.max_depth[prio]) {
+        g_queue_stats.max_depth[prio] = depth;
+    }
+    taskEXIT_CRITICAL(&g_queue_stats_lock);
+
+    return ESP_OK;
+}
+
+esp_err_t menjin_cmd_enqueue(uint8_t data, menjin_prio_t prio, menjin_cmd_done_cb_t done_cb, void *arg)
+{
+    return menjin_frame_enqueue(&data, 1, prio, done_cb, arg);
+}
+
+void menjin_get_queue_stats(menjin_queue_stats_t *stats)
+{
+    taskENTER_CRITICAL(&g_queue_stats_lock);
+    *stats = g_queue_stats;
+    taskEXIT_CRITICAL(&g_queue_stats_lock);
+
+    for (int i = 0; i < MENJIN_PRIO_MAX; ++i) {
+        stats->depth[i] = g_cmd_queues[i] ? uxQueueMessagesWaiting(g_cmd_queues[i]) : 0;
+    }
+}
+
+static void update_latency_stats(esp_err_t ret, uint32_t latency_us, uint32_t bus_us)
+{
+    taskENTER_CRITICAL(&g_queue_stats_lock);
+    g_queue_stats.completed++;
+    if (ret != ESP_OK) {
+        g_queue_stats.failed++;
+    }
+    g_queue_stats.last_latency_us = latency_us;
+    if (latency_us > g_queue_stats.max_latency_us) {
+        g_queue_stats.max_latency_us = latency_us;
+    }
+    // EWMA, 1/8
+    if (g_queue_stats.avg_latency_us == 0) {
+        g_queue_stats.avg_latency_us = latency_us;
+    } else {
+        g_queue_stats.avg_latency_us += ((int32_t) latency_us - (int32_t) g_queue_stats.avg_latency_us) / 8;
+    }
+    g_queue_stats.last_bus_us = bus_us;
+    if (bus_us > g_queue_stats.max_bus_us) {
+        g_queue_stats.max_bus_us = bus_us;
+    }
+    latency_hist_add(&g_latency_hist, latency_us);
+    taskEXIT_CRITICAL(&g_queue_stats_lock);
+}
+
+void menjin_get_latency_hist(latency_hist_t *hist)
+{
+    taskENTER_CRITICAL(&g_queue_stats_lock);
+    *hist = g_latency_hist;
+    taskEXIT_CRITICAL(&g_queue_stats_lock);
+}
+
+void menjin_consume_latency_hist(const latency_hist_t *reported)
+{
+    taskENTER_CRITICAL(&g_queue_stats_lock);
+    latency_hist_sub(&g_latency_hist, reported);
+    taskEXIT_CRITICAL(&g_queue_stats_lock);
+}
+
+_Noreturn static void menjin_cmd_writer_task(void *param)
+{
+    menjin_cmd_item_t item;
+
+    while (1) {
+        xSemaphoreTake(g_cmd_pending, portMAX_DELAY);
+
+        if (g_reconfig_pending) {
+            g_reconfig_pending = false;
+            menjin_i2c_reconfig();
+        }
+        if (g_autotune_pending) {
+            g_autotune_pending = false;
+            menjin_autotune();
+        }
+
+        // 高优先级队列优先
+        bool found = false;
+        for (int i = 0; i < MENJIN_PRIO_MAX && !found; ++i) {
+            found = xQueueReceive(g_cmd_queues[i], &item, 0) == pdTRUE;
+        }
+        if (!found) {
+            continue;
+        }
+
+        int64_t start_us = esp_timer_get_time();
+        esp_err_t ret = menjin_cmd_write(item.data, item.len);
+        int64_t end_us = esp_timer_get_time();
+
+        update_latency_stats(ret, end_us - item.enqueue_us, end_us - start_us);
+
+        i2c_health_event_t event = menjin_i2c_event(ret);
+        taskENTER_CRITICAL(&g_queue_stats_lock);
+        i2c_health_action_t action = i2c_health_record(&g_master_health, event);
+        taskEXIT_CRITICAL(&g_queue_stats_lock);
+        if (action == I2C_HEALTH_ACTION_RECOVER) {
+            menjin_i2c_recover();
+        }
+
+        if (ret != ESP_OK) {
+            ESP_LOGW(TAG, "menjin_cmd_write(0x%02x, %d) failed: %s", item.data[0], item.len, esp_err_to_name(ret));
+        }
+        if (item.done_cb != NULL) {
+            item.done_cb(item.data[0], item.len, ret, item.arg);
+        }
+    }
+}
+
+void menjin_get_bridge_stats(menjin_bridge_stats_t *stats)
+{
+    taskENTER_CRITICAL(&g_queue_stats_lock);
+    *stats = g_bridge_stats;
+    taskEXIT_CRITICAL(&g_queue_stats_lock);
+}
+
+// 键盘帧写入主控完成，arg 为收到首字节的时间（低32位，微秒）
+static void keyboard_frame_done_cb(uint8_t cmd, size_t len, esp_err_t ret, void *arg)
+{
+    uint32_t latency_us = (uint32_t) esp_timer_get_time() - (uint32_t) (uintptr_t) arg;
+
+    taskENTER_CRITICAL(&g_queue_stats_lock);
+    g_bridge_stats.tx_frames++;
+    if (ret == ESP_OK) {
+        g_bridge_stats.tx_bytes += len;
+    } else {
+        g_bridge_stats.tx_failed++;
+    }
+    g_bridge_stats.last_latency_us = latency_us;
+    if (latency_us > g_bridge_stats.max_latency_us) {
+        g_bridge_stats.max_latency_us = latency_us;
+    }
+    if (g_bridge_stats.avg_latency_us == 0) {
+        g_bridge_stats.avg_latency_us = latency_us;
+    } else {
+        g_bridge_stats.avg_latency_us += ((int32_t) latency_us - (int32_t) g_bridge_stats.avg_latency_us) / 8;
+    }
+    taskEXIT_CRITICAL(&g_queue_stats_lock);
+}
+
+static void keyboard_i2c_health(i2c_health_event_t event)
+{
+    taskENTER_CRITICAL(&g_queue_stats_lock);
+    i2c_health_action_t action = i2c_health_record(&g_keyboard_health, event);
+    taskEXIT_CRITICAL(&g_queue_stats_lock);
+
+    if (action != I2C_HEALTH_ACTION_RECOVER) {
+        return;
+    }
+
+    // 从机无法产生时钟，只能复位自身状态机释放 SDA，由键盘（主机）自行恢复
+    menjin_bus_slave_deinit();
+    esp_err_t ret = keyboard_i2c_init();
+    bool bus_free = menjin_bus_slave_idle();
+
+    taskENTER_CRITICAL(&g_queue_stats_lock);
+    i2c_health_recovered(&g_keyboard_health, bus_free);
+    taskEXIT_CRITICAL(&g_queue_stats_lock);
+
+    ESP_LOGW(TAG, "I2C keyboard bus reset, lines %s, reinstall ret: %d", bus_free ? "released" : "still low", ret);
+}
+
+_Noreturn static void keyboard_i2c_read_task(void *param)
+{
+    uint8_t frame[MENJIN_FRAME_MAX];
+
+    while (1) {
+        // 阻塞等待首字节，由 I2C 中断写入接收缓冲区后唤醒；空闲超时检查总线是否卡死
+        int len = menjin_bus_slave_read(frame, 1, pdMS_TO_TICKS(KEYBOARD_IDLE_CHECK_MS));
+        if (len <= 0) {
+            if (!menjin_bus_slave_idle()) {
+                keyboard_i2c_health(I2C_HEALTH_STUCK);
+            }
+            continue;
+        }
+        keyboard_i2c_health(I2C_HEALTH_OK);
+        uint32_t rx_us = (uint32_t) esp_timer_get_time();
+
+        // 一次主机写入的字节由传输结束中断一并写入接收缓冲区，不等待直接取走已有的字节；
+        // 缓冲区回绕时一次读不完，读到空为止
+        while (len < MENJIN_FRAME_MAX) {
+            int ret = menjin_bus_slave_read(frame + len, MENJIN_FRAME_MAX - len, 0);
+            if (ret <= 0) {
+                break;
+            }
+            len += ret;
+        }
+
+        ESP_LOGD(TAG, "keyboard frame: 0x%02x, len: %d", frame[0], len);
+
+        esp_err_t ret = menjin_frame_enqueue(frame, len, MENJIN_PRIO_KEY, keyboard_frame_done_cb, (void *) (uintptr_t) rx_us);
+
+        taskENTER_CRITICAL(&g_queue_stats_lock);
+        g_bridge_stats.rx_bytes += len;
+        g_bridge_stats.rx_frames++;
+        // tx_bytes 在写入完成的回调中统计，只算写成功的帧
+        if (ret != ESP_OK) {
+            g_bridge_stats.dropped++;
+        }
+        if (len > g_bridge_stats.max_frame_len) {
+            g_bridge_stats.max_frame_len = len;
+        }
+        taskEXIT_CRITICAL(&g_queue_stats_lock);
+    }
+}
+
+void menjin_ring_suppress(uint32_t ms)
+{
+    TickType_t until = xTaskGetTickCount() + pdMS_TO_TICKS(ms);
+    // 只延长，不缩短正在进行的屏蔽
+    if ((int32_t) (until - g_ring_suppress_until) > 0) {
+        g_ring_suppress_until = until;
+    }
+}
+
+bool menjin_ring_is_suppressed(void)
+{
+    return (int32_t) (g_ring_suppress_until - xTaskGetTickCount()) > 0;
+}
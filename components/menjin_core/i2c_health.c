@@ -0,0 +1,78 @@
+#include <string.h>
+#include "i2c_health.h"
+
+void i2c_health_init(i2c_health_t *h, uint8_t error_threshold, uint8_t recover_max)
+{
+    memset(h, 0, sizeof(i2c_health_t));
+    h->error_threshold = error_threshold > 0 ? error_threshold : 1;
+    h->recover_max = recover_max;
+}
+
+i2c_health_action_t i2c_health_record(i2c_health_t *h, i2c_health_event_t event)
+{
+    switch (event) {
+        case I2C_HEALTH_OK:
+            h->stats.ok++;
+            h->stats.consecutive = 0;
+            h->attempts = 0;
+            return I2C_HEALTH_ACTION_NONE;
+        case I2C_HEALTH_NACK:
+            h->stats.nack++;
+            break;
+        case I2C_HEALTH_TIMEOUT:
+            h->stats.timeout++;
+            break;
+        case I2C_HEALTH_ARB_LOST:
+            h->stats.arb_lost++;
+            break;
+        case I2C_HEALTH_STUCK:
+            h->stats.stuck++;
+            break;
+        default:
+            h->stats.error++;
+            break;
+    }
+
+    if (++h->stats.consecutive < h->error_threshold || h->attempts >= h->recover_max) {
+        return I2C_HEALTH_ACTION_NONE;
+    }
+
+    h->stats.consecutive = 0;
+    h->attempts++;
+    h->stats.recoveries++;
+
+    return I2C_HEALTH_ACTION_RECOVER;
+}
+
+void i2c_health_recovered(i2c_health_t *h, bool bus_free)
+{
+    if (!bus_free) {
+        h->stats.recover_failed++;
+    }
+}
+
+bool i2c_bus_recover(const i2c_bus_ops_t *ops, uint32_t half_period_us)
+{
+    ops->sda_set(ops->ctx, 1);
+    ops->scl_set(ops->ctx, 1);
+    ops->delay_us(ops->ctx, half_period_us);
+
+    for (int i = 0; i < I2C_BUS_RECOVER_CLOCKS && !ops->sda_get(ops->ctx); ++i) {
+        ops->scl_set(ops->ctx, 0);
+        ops->delay_us(ops->ctx, half_period_us);
+        ops->scl_set(ops->ctx, 1);
+        ops->delay_us(ops->ctx, half_period_us);
+    }
+
+    // STOP: SDA rises while SCL is high
+    ops->scl_set(ops->ctx, 0);
+    ops->delay_us(ops->ctx, half_period_us);
+    ops->sda_set(ops->ctx, 0);
+    ops->delay_us(ops->ctx, half_period_us);
+    ops->scl_set(ops->ctx, 1);
+    ops->delay_us(ops->ctx, half_period_us);
+    ops->sda_set(ops->ctx, 1);
+    ops->delay_us(ops->ctx, half_period_us);
+
+    return ops->sda_get(ops->ctx) != 0;
+}
@@ -0,0 +1,63 @@
+// Named command sequences (macros) such as "open": speaker on, wait, unlock, wait, speaker off.
+// Steps are dispatched from an esp_timer, callers never block.
+//
+// Macro definition string, settings->macros on the board:
+//     name=cmd[,delay_ms,cmd]...[;name=...]
+// e.g. "open=97,3000,99,2000,97"
+
+#ifndef ESP_MENJIN_APP_MACRO_H
+#define ESP_MENJIN_APP_MACRO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "app_menjin.h"
+
+#define APP_MACRO_MAX           4
+#define APP_MACRO_NAME_LEN      16
+#define APP_MACRO_STEPS_MAX     8
+
+typedef struct {
+    uint8_t cmd;
+    uint16_t delay_ms;          // delay before the next step
+} app_macro_step_t;
+
+typedef struct {
+    char name[APP_MACRO_NAME_LEN];
+    uint8_t step_count;
+    app_macro_step_t steps[APP_MACRO_STEPS_MAX];
+} app_macro_t;
+
+/**
+ * @brief Parse a macro definition string
+ *
+ * @return number of macros parsed, -1 on syntax error
+ */
+int app_macro_parse(const char *str, app_macro_t *macros, int max);
+
+/**
+ * @brief Create the step timer and load the macros from a definition string
+ */
+esp_err_t app_macro_init(const char *macros_str);
+
+/**
+ * @brief Replace the macros, a running macro finishes with its old steps
+ */
+esp_err_t app_macro_reload(const char *macros_str);
+
+/**
+ * @brief Start a macro, returns immediately
+ *
+ * Ring detection is suppressed while the macro runs. A request for the macro that is already
+ * running is coalesced into the current run.
+ *
+ * @return
+ *     - ESP_OK started, or coalesced into the current run
+ *     - ESP_ERR_NOT_FOUND no macro with this name
+ *     - ESP_ERR_INVALID_STATE another macro is running
+ */
+esp_err_t app_macro_run(const char *name, menjin_prio_t prio);
+
+bool app_macro_is_running(void);
+
+#endif //ESP_MENJIN_APP_MACRO_H
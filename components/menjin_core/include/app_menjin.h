@@ -0,0 +1,180 @@
+//
+// Created by Hessian on 2023/7/30.
+//
+
+#ifndef ESP_MENJIN_APP_MENJIN_H
+#define ESP_MENJIN_APP_MENJIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+#include "i2c_health.h"
+#include "latency_hist.h"
+
+typedef enum {
+    MENJIN_CMD_KEY4_SPEAKER = 0x61,
+    MENJIN_CMD_KEY2,
+    MENJIN_CMD_KEY3_UNLOCK,
+    MENJIN_CMD_KEY1,
+} MENJIN_CMD;
+
+#define MENJIN_FRAME_MAX    8      // longest frame forwarded in one transaction
+
+typedef enum {
+    MENJIN_PRIO_KEY = 0,        // physical keys and the touch keyboard bridge
+    MENJIN_PRIO_REMOTE,         // MQTT / HTTP commands
+    MENJIN_PRIO_MAX,
+} menjin_prio_t;
+
+/**
+ * @brief Command completion callback, called from the I2C writer task
+ *
+ * @param len bytes in the frame, 1 for a single command
+ * @param ret result of the bus write
+ */
+typedef void (*menjin_cmd_done_cb_t)(uint8_t cmd, size_t len, esp_err_t ret, void *arg);
+
+typedef struct {
+    uint32_t enqueued;
+    uint32_t completed;
+    uint32_t failed;                        // bus write returned an error
+    uint32_t dropped;                       // queue full
+    uint32_t depth[MENJIN_PRIO_MAX];        // commands waiting now
+    uint32_t max_depth[MENJIN_PRIO_MAX];
+    uint32_t last_latency_us;               // enqueue -> write done
+    uint32_t max_latency_us;
+    uint32_t avg_latency_us;
+    uint32_t last_bus_us;                   // time spent on the bus
+    uint32_t max_bus_us;
+} menjin_queue_stats_t;
+
+typedef struct {
+    // keyboard -> bridge (I2C slave)
+    uint32_t rx_bytes;
+    uint32_t rx_frames;
+    uint32_t dropped;                       // frames not queued
+    // bridge -> controller (I2C master)
+    uint32_t tx_bytes;                      // of frames written successfully
+    uint32_t tx_frames;
+    uint32_t tx_failed;
+    uint32_t max_frame_len;
+    uint32_t last_latency_us;               // first byte received -> frame written
+    uint32_t max_latency_us;
+    uint32_t avg_latency_us;
+} menjin_bridge_stats_t;
+
+#define MENJIN_AUTOTUNE_RATES_MAX   8
+
+typedef enum {
+    MENJIN_AUTOTUNE_IDLE = 0,
+    MENJIN_AUTOTUNE_RUNNING,
+    MENJIN_AUTOTUNE_DONE,                   // best_clock applied and saved
+    MENJIN_AUTOTUNE_FAILED,                 // no reliable rate, previous clock kept
+} menjin_autotune_state_t;
+
+typedef struct {
+    uint32_t clock;
+    uint16_t probes;                        // probes sent, less than configured if aborted
+    uint16_t errors;
+    uint32_t avg_us;                        // per probe transaction
+    uint32_t max_us;
+} menjin_autotune_rate_t;
+
+typedef struct {
+    menjin_autotune_state_t state;
+    uint32_t best_clock;
+    uint8_t count;
+    menjin_autotune_rate_t rates[MENJIN_AUTOTUNE_RATES_MAX];
+} menjin_autotune_result_t;
+
+typedef struct {
+    uint8_t addr;                           // controller address, the keyboard bridge answers on it too
+    uint32_t clock;
+    // autotune picked a new clock and applied it, persist it; may be NULL. Called from the writer task
+    // with a small stack: hand slow work such as NVS writes to another task
+    void (*clock_saved_cb)(uint32_t clock);
+} menjin_config_t;
+
+esp_err_t menjin_init(const menjin_config_t *config);
+esp_err_t menjin_stop();
+
+/**
+ * @brief Queue a command for the I2C writer task, never blocks
+ *
+ * @param done_cb optional completion callback
+ * @return
+ *     - ESP_OK queued
+ *     - ESP_ERR_INVALID_STATE menjin not initialized
+ *     - ESP_ERR_NO_MEM queue full, command dropped
+ */
+esp_err_t menjin_cmd_enqueue(uint8_t data, menjin_prio_t prio, menjin_cmd_done_cb_t done_cb, void *arg);
+
+/**
+ * @brief Queue a multi-byte frame, written to the controller in a single transaction
+ *
+ * @param len 1..MENJIN_FRAME_MAX, done_cb gets the first byte as cmd
+ */
+esp_err_t menjin_frame_enqueue(const uint8_t *data, size_t len, menjin_prio_t prio, menjin_cmd_done_cb_t done_cb, void *arg);
+void menjin_get_queue_stats(menjin_queue_stats_t *stats);
+void menjin_get_bridge_stats(menjin_bridge_stats_t *stats);
+
+/**
+ * @brief Copy the enqueue -> write done latency histogram of the command queue
+ */
+void menjin_get_latency_hist(latency_hist_t *hist);
+
+/**
+ * @brief Start a new window: drop the samples of a copy that has been reported
+ *
+ * Commands completed after the copy was taken stay in the next window.
+ */
+void menjin_consume_latency_hist(const latency_hist_t *reported);
+
+/**
+ * @brief Bus error counters of the controller (master) and keyboard (slave) buses
+ */
+void menjin_get_health_stats(i2c_health_stats_t *master, i2c_health_stats_t *keyboard);
+
+/**
+ * @brief Apply a new address and clock to the master bus
+ *
+ * Runs asynchronously on the writer task, between two commands. The keyboard bridge keeps its
+ * slave address until reboot.
+ */
+void menjin_reconfigure(uint8_t addr, uint32_t clock);
+
+/**
+ * @brief Get the clock currently applied to the master bus
+ */
+uint32_t menjin_get_clock();
+
+/**
+ * @brief Apply a new clock and keep the address, see menjin_reconfigure()
+ */
+void menjin_set_clock(uint32_t clock);
+
+/**
+ * @brief Sweep the candidate clock rates and keep the fastest reliable one
+ *
+ * Runs on the writer task, queued commands wait until the sweep is done. Each rate is verified
+ * with ACK-checked address probes, no command reaches the controller. The winner is applied and
+ * handed to menjin_config_t::clock_saved_cb.
+ *
+ * @return
+ *     - ESP_OK sweep scheduled
+ *     - ESP_ERR_INVALID_STATE menjin not initialized or a sweep is already running
+ */
+esp_err_t menjin_autotune_start(void);
+void menjin_get_autotune_result(menjin_autotune_result_t *result);
+/**
+ * @brief Don't report rings for the next `ms` milliseconds, an earlier deadline never shortens a pending one
+ */
+void menjin_ring_suppress(uint32_t ms);
+
+/**
+ * @return true while rings are suppressed, checked by the ring detection task
+ */
+bool menjin_ring_is_suppressed(void);
+
+#endif //ESP_MENJIN_APP_MENJIN_H
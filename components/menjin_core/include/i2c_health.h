@@ -0,0 +1,78 @@
+// I2C bus health bookkeeping and clock-pulse bus recovery.
+// Pure C, no ESP-IDF dependency: pin access goes through i2c_bus_ops_t so the recovery
+// sequence can run against a simulated bus on the host.
+
+#ifndef ESP_MENJIN_I2C_HEALTH_H
+#define ESP_MENJIN_I2C_HEALTH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define I2C_BUS_RECOVER_CLOCKS  9       // a stuck slave releases SDA within one byte + ACK
+
+typedef enum {
+    I2C_HEALTH_OK = 0,
+    I2C_HEALTH_NACK,            // slave did not acknowledge
+    I2C_HEALTH_TIMEOUT,         // transaction timed out, SCL held low or bus busy
+    I2C_HEALTH_ARB_LOST,        // arbitration lost / bus in unexpected state
+    I2C_HEALTH_STUCK,           // idle bus with SDA or SCL held low
+    I2C_HEALTH_ERROR,           // any other driver error
+} i2c_health_event_t;
+
+typedef enum {
+    I2C_HEALTH_ACTION_NONE = 0,
+    I2C_HEALTH_ACTION_RECOVER,  // run bus recovery and re-install the driver
+} i2c_health_action_t;
+
+typedef struct {
+    uint32_t ok;
+    uint32_t nack;
+    uint32_t timeout;
+    uint32_t arb_lost;
+    uint32_t stuck;
+    uint32_t error;
+    uint32_t recoveries;        // recovery attempts
+    uint32_t recover_failed;    // SDA still low after recovery
+    uint32_t consecutive;       // errors since the last success
+} i2c_health_stats_t;
+
+typedef struct {
+    uint8_t error_threshold;    // consecutive errors that trigger a recovery
+    uint8_t recover_max;        // attempts in a row before giving up until the next success
+    uint8_t attempts;
+    i2c_health_stats_t stats;
+} i2c_health_t;
+
+void i2c_health_init(i2c_health_t *h, uint8_t error_threshold, uint8_t recover_max);
+
+/**
+ * @brief Account one bus result
+ *
+ * @return I2C_HEALTH_ACTION_RECOVER when the caller should recover the bus now
+ */
+i2c_health_action_t i2c_health_record(i2c_health_t *h, i2c_health_event_t event);
+
+/**
+ * @brief Report the outcome of a recovery requested by i2c_health_record()
+ */
+void i2c_health_recovered(i2c_health_t *h, bool bus_free);
+
+typedef struct {
+    void (*scl_set)(void *ctx, int level);      // open drain, 1 releases the line
+    void (*sda_set)(void *ctx, int level);
+    int (*sda_get)(void *ctx);
+    void (*delay_us)(void *ctx, uint32_t us);
+    void *ctx;
+} i2c_bus_ops_t;
+
+/**
+ * @brief Free a bus held by a slave stuck mid-byte
+ *
+ * Clocks SCL up to 9 times until the slave releases SDA, then generates a STOP condition.
+ * The I2C peripheral must be detached from the pins.
+ *
+ * @return true if SDA is high afterwards
+ */
+bool i2c_bus_recover(const i2c_bus_ops_t *ops, uint32_t half_period_us);
+
+#endif //ESP_MENJIN_I2C_HEALTH_H
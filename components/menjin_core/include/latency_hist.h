@@ -0,0 +1,36 @@
+// Log-linear latency histogram: 4 linear buckets per power of two, so any percentile is within
+// 25% of the true value. Fixed size, constant-time insert, no ESP-IDF dependency.
+
+#ifndef ESP_MENJIN_LATENCY_HIST_H
+#define ESP_MENJIN_LATENCY_HIST_H
+
+#include <stdint.h>
+
+#define LATENCY_HIST_SUB_BITS   2
+#define LATENCY_HIST_BUCKETS    96      // up to 2^25 us (~33 s), larger values land in the last bucket
+
+typedef struct {
+    uint32_t count;
+    uint32_t max;
+    uint32_t buckets[LATENCY_HIST_BUCKETS];
+} latency_hist_t;
+
+void latency_hist_reset(latency_hist_t *h);
+void latency_hist_add(latency_hist_t *h, uint32_t value);
+
+/**
+ * @brief Remove the samples of an earlier copy of `h`, keeping what was added since
+ *
+ * `max` cannot be split, it is kept until the histogram empties.
+ */
+void latency_hist_sub(latency_hist_t *h, const latency_hist_t *taken);
+
+/**
+ * @brief Upper bound of the bucket holding the pct-th percentile, capped at the largest value seen
+ *
+ * @param pct 1..100
+ * @return 0 if the histogram is empty
+ */
+uint32_t latency_hist_percentile(const latency_hist_t *h, uint8_t pct);
+
+#endif //ESP_MENJIN_LATENCY_HIST_H
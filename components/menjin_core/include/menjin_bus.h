@@ -0,0 +1,67 @@
+// Bus access used by app_menjin.c: the I2C master towards the intercom controller and the
+// I2C slave the touch keyboard writes to.
+//
+// Backends:
+//   menjin_bus_i2c.c  ESP32 I2C peripherals (default)
+//   menjin_bus_sim.c  simulated controller and keyboard, CONFIG_MENJIN_BUS_SIM, see menjin_sim.h
+
+#ifndef ESP_MENJIN_MENJIN_BUS_H
+#define ESP_MENJIN_MENJIN_BUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+#include "freertos/FreeRTOS.h"
+
+esp_err_t menjin_bus_master_init(uint8_t addr, uint32_t clock);
+esp_err_t menjin_bus_master_deinit(void);
+
+/**
+ * @brief Write `len` bytes to the controller in one transaction
+ *
+ * @return
+ *     - ESP_OK Success
+ *     - ESP_FAIL slave doesn't ACK the transfer (ACK checking enabled)
+ *     - ESP_ERR_INVALID_STATE driver not installed
+ *     - ESP_ERR_TIMEOUT bus busy
+ */
+esp_err_t menjin_bus_master_write(const uint8_t *data, size_t len);
+
+/**
+ * @brief Address the controller without sending a command, always ACK-checked
+ *
+ * @param data NULL for an address-only write, otherwise a read transfer that stores the byte
+ *             the controller drives onto SDA
+ * @return ESP_OK if the controller acknowledged
+ */
+esp_err_t menjin_bus_master_probe(uint8_t *data);
+
+/**
+ * @brief Clock a stuck master bus free, the master must be de-initialized
+ *
+ * @return true if SDA is released
+ */
+bool menjin_bus_master_recover(uint32_t clock);
+
+/**
+ * @return true if SDA and SCL of the master bus are both high
+ */
+bool menjin_bus_master_idle(void);
+
+esp_err_t menjin_bus_slave_init(uint8_t addr, uint32_t clock);
+esp_err_t menjin_bus_slave_deinit(void);
+
+/**
+ * @brief Read up to `max` bytes written by the keyboard, waiting at most `ticks_to_wait`
+ *
+ * @return number of bytes read, 0 on timeout
+ */
+int menjin_bus_slave_read(uint8_t *buf, size_t max, TickType_t ticks_to_wait);
+
+/**
+ * @return true if SDA and SCL of the keyboard bus are both high
+ */
+bool menjin_bus_slave_idle(void);
+
+#endif //ESP_MENJIN_MENJIN_BUS_H
@@ -0,0 +1,59 @@
+// Simulated intercom controller and touch keyboard, backend of menjin_bus.h when
+// CONFIG_MENJIN_BUS_SIM is enabled. Lets the command queue, macros and keyboard bridge run
+// without an intercom, on the board or on the linux target.
+
+#ifndef ESP_MENJIN_MENJIN_SIM_H
+#define ESP_MENJIN_MENJIN_SIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "app_menjin.h"
+
+#define MENJIN_SIM_LOG_LEN      64
+
+typedef struct {
+    int64_t time_us;            // esp_timer time at the end of the write
+    uint8_t addr;
+    uint8_t len;
+    uint8_t data[MENJIN_FRAME_MAX];
+    esp_err_t ret;              // result returned to the writer
+} menjin_sim_record_t;
+
+/**
+ * @brief Clear the controller log, the pending script and the stuck bus state
+ */
+void menjin_sim_reset(void);
+
+/**
+ * @brief Results returned by the next writes, one per write, then ESP_OK again
+ *
+ * ESP_ERR_TIMEOUT also holds SDA low until the bus is recovered.
+ */
+esp_err_t menjin_sim_controller_script(const esp_err_t *results, size_t count);
+
+/**
+ * @brief Number of clocks a stuck controller needs before releasing SDA, >9 never releases
+ */
+void menjin_sim_controller_set_hold_clocks(uint8_t clocks);
+
+/**
+ * @brief Fastest clock the controller acknowledges probes at, 0 for no limit
+ */
+void menjin_sim_controller_set_max_clock(uint32_t clock);
+
+/**
+ * @brief Copy the received commands, oldest first
+ *
+ * @return number of records copied
+ */
+size_t menjin_sim_controller_log(menjin_sim_record_t *records, size_t max);
+
+/**
+ * @brief Bytes written by the fake keyboard, picked up by the bridge like real slave data
+ *
+ * @return number of bytes accepted
+ */
+size_t menjin_sim_keyboard_inject(const uint8_t *data, size_t len);
+
+#endif //ESP_MENJIN_MENJIN_SIM_H
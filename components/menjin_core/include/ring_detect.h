@@ -0,0 +1,114 @@
+// Pure C ring detection DSP, fed one ADC sample at a time.
+// No ESP-IDF dependency so it can be built for the linux target.
+//
+// Samples are grouped in blocks of `window` samples. Each block is classified as "on" or "off":
+//  - level mode (tone_hz == 0): block average above `threshold`, or, in adaptive mode, above the
+//    learned baseline plus `margin` (arm) and back below baseline plus margin / 2 (disarm)
+//  - tone mode: Goertzel power at `tone_hz` dominates the block energy and exceeds `tone_min_amplitude`;
+//    `threshold`, `adaptive`, `margin` and `baseline_seed` take no part in the decision
+// The on/off stream then goes through a cadence state machine. A ring is reported when a burst
+// ends after lasting between on_min and on_max, and it completes `bursts` consecutive bursts
+// separated by pauses between off_min and off_max. Everything is fixed-point with a constant
+// per-sample cost.
+
+#ifndef ESP_MENJIN_RING_DETECT_H
+#define ESP_MENJIN_RING_DETECT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+    uint32_t sample_rate_hz;
+    uint32_t threshold;         // level mode: block average above this value means "on"
+    uint16_t sample_max;        // samples above this are glitches, replaced by threshold
+    uint32_t window;            // samples per block, up to 83333 (1 s at the highest ADC rate)
+
+    bool adaptive;              // level mode: track the baseline instead of using a static threshold
+    uint32_t margin;            // adaptive: arm at baseline + margin, disarm at baseline + margin / 2
+    uint32_t baseline_seed;     // adaptive: initial baseline, 0 to learn it from the first block
+
+    uint16_t tone_hz;           // 0 disables the tone filter (level mode), below sample_rate_hz / 2
+    uint16_t tone_ratio_pct;    // minimum share of block energy at tone_hz, in percent
+    uint16_t tone_min_amplitude;// minimum tone amplitude, in ADC counts
+
+    uint16_t on_min_ms;         // shortest accepted ring burst
+    uint16_t on_max_ms;         // longest accepted ring burst, 0 means unbounded
+    uint16_t off_min_ms;        // shortest accepted pause between bursts
+    uint16_t off_max_ms;        // longest accepted pause between bursts, 0 means unbounded
+    uint8_t bursts;             // consecutive matching bursts required to report a ring
+} ring_detect_config_t;
+
+typedef enum {
+    RING_CADENCE_IDLE = 0,      // waiting for the first burst
+    RING_CADENCE_ON,            // inside a burst
+    RING_CADENCE_OFF,           // inside a pause after a valid burst
+    RING_CADENCE_INVALID,       // burst too long (e.g. voice), wait for silence
+} ring_cadence_state_t;
+
+typedef struct {
+    uint32_t windows;           // completed blocks
+    uint32_t on_windows;        // blocks classified as "on"
+    uint32_t bursts;            // bursts accepted by the cadence filter
+    uint32_t rejected;          // bursts rejected by the cadence filter
+    uint32_t detections;        // rings reported
+} ring_detect_stats_t;
+
+typedef struct {
+    ring_detect_config_t cfg;
+
+    // block accumulators
+    uint32_t count;
+    uint32_t acc;               // sample_max <= 13-bit ADC range, fits a full 83333 sample block
+    int32_t dc_q8;              // DC estimate, Q8
+    int32_t s1, s2;             // Goertzel state
+    int64_t energy;
+    int32_t coeff_q14;          // 2 * cos(2 * pi * tone_hz / sample_rate_hz), Q14
+
+    // durations in blocks
+    uint16_t on_min, on_max, off_min, off_max;
+
+    // cadence state
+    ring_cadence_state_t state;
+    uint16_t run;               // blocks spent in the current state
+    uint8_t burst_count;        // consecutive bursts matching the cadence so far
+
+    uint32_t baseline_q8;       // learned noise floor, Q8
+    bool level_on;              // level mode hysteresis state
+
+    uint32_t last_avg;          // average of the last completed block
+    uint32_t last_tone_pct;     // tone share of the last completed block, in percent
+    ring_detect_stats_t stats;
+} ring_detect_t;
+
+/**
+ * @return 0, or -1 if tone_hz is not below the Nyquist frequency; the detector then runs in level mode
+ */
+int ring_detect_init(ring_detect_t *rd, const ring_detect_config_t *cfg);
+void ring_detect_reset(ring_detect_t *rd);
+
+/**
+ * @brief Learned noise floor in ADC counts (adaptive mode)
+ */
+uint32_t ring_detect_get_baseline(const ring_detect_t *rd);
+
+/**
+ * @brief Threshold currently in effect: arm or disarm level in adaptive mode, `threshold` otherwise
+ */
+uint32_t ring_detect_get_threshold(const ring_detect_t *rd);
+
+/**
+ * @brief Feed one raw ADC sample
+ *
+ * @return true when this sample completes the block that ends a ring burst matching the cadence
+ */
+bool ring_detect_feed(ring_detect_t *rd, uint16_t sample);
+
+/**
+ * @brief Feed a block of raw ADC samples
+ *
+ * @return true if a ring was reported within this block
+ */
+bool ring_detect_feed_block(ring_detect_t *rd, const uint16_t *samples, size_t n);
+
+#endif //ESP_MENJIN_RING_DETECT_H
@@ -0,0 +1,78 @@
+#include <string.h>
+#include "latency_hist.h"
+
+#define SUB_COUNT   (1 << LATENCY_HIST_SUB_BITS)
+
+static uint32_t bucket_index(uint32_t value)
+{
+    if (value < SUB_COUNT) {
+        return value;
+    }
+
+    uint32_t msb = 31 - __builtin_clz(value);
+    uint32_t sub = (value >> (msb - LATENCY_HIST_SUB_BITS)) & (SUB_COUNT - 1);
+    uint32_t index = (msb - LATENCY_HIST_SUB_BITS + 1) * SUB_COUNT + sub;
+
+    return index < LATENCY_HIST_BUCKETS ? index : LATENCY_HIST_BUCKETS - 1;
+}
+
+static uint32_t bucket_upper(uint32_t index)
+{
+    if (index < SUB_COUNT) {
+        return index;
+    }
+
+    uint32_t shift = index / SUB_COUNT - 1;
+    uint32_t lower = (SUB_COUNT + index % SUB_COUNT) << shift;
+
+    return lower + (1u << shift) - 1;
+}
+
+void latency_hist_reset(latency_hist_t *h)
+{
+    memset(h, 0, sizeof(latency_hist_t));
+}
+
+void latency_hist_add(latency_hist_t *h, uint32_t value)
+{
+    h->buckets[bucket_index(value)]++;
+    h->count++;
+    if (value > h->max) {
+        h->max = value;
+    }
+}
+
+void latency_hist_sub(latency_hist_t *h, const latency_hist_t *taken)
+{
+    for (uint32_t i = 0; i < LATENCY_HIST_BUCKETS; ++i) {
+        h->buckets[i] -= taken->buckets[i] < h->buckets[i] ? taken->buckets[i] : h->buckets[i];
+    }
+    h->count -= taken->count < h->count ? taken->count : h->count;
+    if (h->count == 0) {
+        h->max = 0;
+    }
+}
+
+uint32_t latency_hist_percentile(const latency_hist_t *h, uint8_t pct)
+{
+    if (h->count == 0) {
+        return 0;
+    }
+
+    // 第 rank 个样本所在的桶，rank 从 1 开始
+    uint32_t rank = (uint32_t) (((uint64_t) h->count * pct + 99) / 100);
+    if (rank == 0) {
+        rank = 1;
+    }
+
+    uint32_t seen = 0;
+    for (uint32_t i = 0; i < LATENCY_HIST_BUCKETS; ++i) {
+        seen += h->buckets[i];
+        if (seen >= rank && i < LATENCY_HIST_BUCKETS - 1) {
+            uint32_t upper = bucket_upper(i);
+            return upper < h->max ? upper : h->max;
+        }
+    }
+
+    return h->max;
+}
@@ -0,0 +1,185 @@
+#include "sdkconfig.h"
+
+#ifndef CONFIG_MENJIN_BUS_SIM
+
+#include <driver/i2c.h>
+#include <driver/gpio.h>
+#include <esp_rom_sys.h>
+#include "esp_log.h"
+#include "menjin_bus.h"
+#include "i2c_health.h"
+
+static const char *TAG = "MENJIN_BUS";
+
+#define I2C_MASTER_TX_BUF_DISABLE   0                 /*!< I2C master doesn't need buffer */
+#define I2C_MASTER_RX_BUF_DISABLE   0                 /*!< I2C master doesn't need buffer */
+
+// I2C_A 门禁主控
+#define MENJIN_I2C_SCL_PIN           40               /*!< gpio number for I2C master clock */
+#define MENJIN_I2C_SDA_PIN           39               /*!< gpio number for I2C master data  */
+#define MENJIN_I2C_NUM               I2C_NUM_0        /*!< I2C port number for master dev */
+
+// I2C_B 触摸键盘
+#define KEYBOARD_I2C_SCL_PIN         2                /*!< gpio number for I2C master clock */
+#define KEYBOARD_I2C_SDA_PIN         3                /*!< gpio number for I2C master data  */
+#define KEYBOARD_I2C_NUM             I2C_NUM_1        /*!< I2C port number for master dev */
+#define I2C_SLAVE_TX_BUF_LEN         256
+#define I2C_SLAVE_RX_BUF_LEN         256
+
+#define WRITE_BIT                    I2C_MASTER_WRITE /*!< I2C master write */
+#define READ_BIT                     I2C_MASTER_READ  /*!< I2C master read */
+#define ACK_CHECK_EN                 0x1              /*!< I2C master will check ack from slave*/
+#define ACK_CHECK_DIS                0x0              /*!< I2C master will not check ack from slave */
+#ifdef CONFIG_MENJIN_I2C_ACK_CHECK
+#define MENJIN_ACK_CHECK             ACK_CHECK_EN
+#else
+#define MENJIN_ACK_CHECK             ACK_CHECK_DIS
+#endif
+#define MENJIN_CMD_LINK_SIZE         I2C_LINK_RECOMMENDED_SIZE(2) /*!< start, addr, data[], stop */
+
+static uint8_t g_master_addr = 0;
+// 静态命令链，避免每次写入都分配/释放内存
+static uint8_t g_cmd_link_buf[MENJIN_CMD_LINK_SIZE];
+
+esp_err_t menjin_bus_master_init(uint8_t addr, uint32_t clock)
+{
+    i2c_config_t conf = {
+            .mode = I2C_MODE_MASTER,
+            .sda_io_num = MENJIN_I2C_SDA_PIN,
+            .scl_io_num = MENJIN_I2C_SCL_PIN,
+            .sda_pullup_en = GPIO_PULLUP_ENABLE,
+            .scl_pullup_en = GPIO_PULLUP_ENABLE,
+            .master.clk_speed = clock
+    };
+
+    i2c_param_config(MENJIN_I2C_NUM, &conf);
+
+    g_master_addr = addr;
+
+    return i2c_driver_install(MENJIN_I2C_NUM, conf.mode, I2C_MASTER_RX_BUF_DISABLE, I2C_MASTER_TX_BUF_DISABLE, 0);
+}
+
+esp_err_t menjin_bus_master_deinit(void)
+{
+    return i2c_driver_delete(MENJIN_I2C_NUM);
+}
+
+/**
+ * 1. send data
+ * ____________________________________________________________________________________
+ * |  start | slave_addr + wr_bit + ack | write n bytes + ack  | ... |  stop |
+ * |--------|---------------------------|----------------------|-----|-------|
+ */
+esp_err_t menjin_bus_master_write(const uint8_t *data, size_t len)
+{
+    int ret;
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(g_cmd_link_buf, sizeof(g_cmd_link_buf));
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, g_master_addr << 1 | WRITE_BIT, MENJIN_ACK_CHECK);
+    i2c_master_write(cmd, data, len, MENJIN_ACK_CHECK);
+    i2c_master_stop(cmd);
+    ret = i2c_master_cmd_begin(MENJIN_I2C_NUM, cmd, 1000 / portTICK_PERIOD_MS);
+    i2c_cmd_link_delete_static(cmd);
+
+    ESP_LOGD(TAG, "master write[0x%02x]: 0x%02x, len: %d", g_master_addr, data[0], len);
+
+    return ret;
+}
+
+esp_err_t menjin_bus_master_probe(uint8_t *data)
+{
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create_static(g_cmd_link_buf, sizeof(g_cmd_link_buf));
+    i2c_master_start(cmd);
+    if (data != NULL) {
+        i2c_master_write_byte(cmd, g_master_addr << 1 | READ_BIT, ACK_CHECK_EN);
+        i2c_master_read_byte(cmd, data, I2C_MASTER_NACK);
+    } else {
+        i2c_master_write_byte(cmd, g_master_addr << 1 | WRITE_BIT, ACK_CHECK_EN);
+    }
+    i2c_master_stop(cmd);
+    esp_err_t ret = i2c_master_cmd_begin(MENJIN_I2C_NUM, cmd, 100 / portTICK_PERIOD_MS);
+    i2c_cmd_link_delete_static(cmd);
+
+    return ret;
+}
+
+static void bus_scl_set(void *ctx, int level)
+{
+    gpio_set_level(MENJIN_I2C_SCL_PIN, level);
+}
+
+static void bus_sda_set(void *ctx, int level)
+{
+    gpio_set_level(MENJIN_I2C_SDA_PIN, level);
+}
+
+static int bus_sda_get(void *ctx)
+{
+    return gpio_get_level(MENJIN_I2C_SDA_PIN);
+}
+
+static void bus_delay_us(void *ctx, uint32_t us)
+{
+    esp_rom_delay_us(us);
+}
+
+static const i2c_bus_ops_t g_master_bus_ops = {
+        .scl_set = bus_scl_set,
+        .sda_set = bus_sda_set,
+        .sda_get = bus_sda_get,
+        .delay_us = bus_delay_us,
+};
+
+bool menjin_bus_master_recover(uint32_t clock)
+{
+    // 交由 GPIO 控制，开漏输出
+    gpio_set_direction(MENJIN_I2C_SCL_PIN, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_direction(MENJIN_I2C_SDA_PIN, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_pull_mode(MENJIN_I2C_SCL_PIN, GPIO_PULLUP_ONLY);
+    gpio_set_pull_mode(MENJIN_I2C_SDA_PIN, GPIO_PULLUP_ONLY);
+
+    uint32_t half_period_us = clock > 0 ? 500000 / clock : 10;
+
+    return i2c_bus_recover(&g_master_bus_ops, half_period_us > 5 ? half_period_us : 5);
+}
+
+bool menjin_bus_master_idle(void)
+{
+    return gpio_get_level(MENJIN_I2C_SDA_PIN) && gpio_get_level(MENJIN_I2C_SCL_PIN);
+}
+
+esp_err_t menjin_bus_slave_init(uint8_t addr, uint32_t clock)
+{
+    i2c_config_t conf = {
+            .mode = I2C_MODE_SLAVE,
+            .sda_io_num = KEYBOARD_I2C_SDA_PIN,
+            .scl_io_num = KEYBOARD_I2C_SCL_PIN,
+            .sda_pullup_en = GPIO_PULLUP_ENABLE,
+            .scl_pullup_en = GPIO_PULLUP_ENABLE,
+            .slave.slave_addr = addr,
+            .slave.maximum_speed = clock,
+    };
+
+    i2c_param_config(KEYBOARD_I2C_NUM, &conf);
+
+    return i2c_driver_install(KEYBOARD_I2C_NUM, conf.mode, I2C_SLAVE_RX_BUF_LEN, I2C_SLAVE_TX_BUF_LEN, 0);
+}
+
+esp_err_t menjin_bus_slave_deinit(void)
+{
+    return i2c_driver_delete(KEYBOARD_I2C_NUM);
+}
+
+int menjin_bus_slave_read(uint8_t *buf, size_t max, TickType_t ticks_to_wait)
+{
+    int ret = i2c_slave_read_buffer(KEYBOARD_I2C_NUM, buf, max, ticks_to_wait);
+
+    return ret > 0 ? ret : 0;
+}
+
+bool menjin_bus_slave_idle(void)
+{
+    return gpio_get_level(KEYBOARD_I2C_SDA_PIN) && gpio_get_level(KEYBOARD_I2C_SCL_PIN);
+}
+
+#endif // CONFIG_MENJIN_BUS_SIM
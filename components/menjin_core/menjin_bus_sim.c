@@ -0,0 +1,279 @@
+#include "sdkconfig.h"
+
+#ifdef CONFIG_MENJIN_BUS_SIM
+
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/stream_buffer.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "menjin_bus.h"
+#include "menjin_sim.h"
+#include "i2c_health.h"
+
+static const char *TAG = "MENJIN_SIM";
+
+#define SIM_SCRIPT_LEN          16
+#define SIM_KEYBOARD_BUF_LEN    256
+#define SIM_RELEASE_NEVER       (I2C_BUS_RECOVER_CLOCKS + 1)
+
+static portMUX_TYPE g_sim_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 模拟主控
+static bool g_master_installed = false;
+static uint8_t g_master_addr = 0;
+static uint32_t g_master_clock = 0;
+static menjin_sim_record_t g_log[MENJIN_SIM_LOG_LEN];
+static size_t g_log_head = 0;
+static size_t g_log_count = 0;
+static esp_err_t g_script[SIM_SCRIPT_LEN];
+static size_t g_script_pos = 0;
+static size_t g_script_len = 0;
+// 主控卡住时拉低 SDA，需要的时钟数
+static uint8_t g_hold_clocks = 1;
+static uint32_t g_max_clock = 0;
+static uint8_t g_last_cmd = 0;      // 读回的数据：控制器最后收到的命令
+static uint8_t g_hold_remaining = 0;
+static bool g_stuck = false;
+static int g_scl = 1;
+static int g_sda = 1;
+
+// 模拟键盘
+static StreamBufferHandle_t g_keyboard_buf = NULL;
+
+void menjin_sim_reset(void)
+{
+    taskENTER_CRITICAL(&g_sim_lock);
+    g_log_head = 0;
+    g_log_count = 0;
+    g_script_pos = 0;
+    g_script_len = 0;
+    g_stuck = false;
+    taskEXIT_CRITICAL(&g_sim_lock);
+}
+
+esp_err_t menjin_sim_controller_script(const esp_err_t *results, size_t count)
+{
+    ESP_RETURN_ON_FALSE(count <= SIM_SCRIPT_LEN, ESP_ERR_INVALID_SIZE, TAG, "script too long: %d", (int) count);
+
+    taskENTER_CRITICAL(&g_sim_lock);
+    memcpy(g_script, results, count * sizeof(esp_err_t));
+    g_script_pos = 0;
+    g_script_len = count;
+    taskEXIT_CRITICAL(&g_sim_lock);
+
+    return ESP_OK;
+}
+
+void menjin_sim_controller_set_hold_clocks(uint8_t clocks)
+{
+    g_hold_clocks = clocks;
+}
+
+void menjin_sim_controller_set_max_clock(uint32_t clock)
+{
+    g_max_clock = clock;
+}
+
+size_t menjin_sim_controller_log(menjin_sim_record_t *records, size_t max)
+{
+    taskENTER_CRITICAL(&g_sim_lock);
+    size_t count = g_log_count < max ? g_log_count : max;
+    size_t start = (g_log_head + MENJIN_SIM_LOG_LEN - g_log_count) % MENJIN_SIM_LOG_LEN;
+    for (size_t i = 0; i < count; ++i) {
+        records[i] = g_log[(start + i) % MENJIN_SIM_LOG_LEN];
+    }
+    taskEXIT_CRITICAL(&g_sim_lock);
+
+    return count;
+}
+
+size_t menjin_sim_keyboard_inject(const uint8_t *data, size_t len)
+{
+    if (g_keyboard_buf == NULL) {
+        return 0;
+    }
+
+    return xStreamBufferSend(g_keyboard_buf, data, len, 0);
+}
+
+esp_err_t menjin_bus_master_init(uint8_t addr, uint32_t clock)
+{
+    ESP_RETURN_ON_FALSE(clock > 0, ESP_ERR_INVALID_ARG, TAG, "invalid clock");
+
+    g_master_addr = addr;
+    g_master_clock = clock;
+    g_master_installed = true;
+
+    return ESP_OK;
+}
+
+esp_err_t menjin_bus_master_deinit(void)
+{
+    ESP_RETURN_ON_FALSE(g_master_installed, ESP_ERR_INVALID_STATE, TAG, "master not installed");
+    g_master_installed = false;
+
+    return ESP_OK;
+}
+
+// 占用总线的时间：起始、地址和数据各 9 位、停止
+static void sim_bus_time(size_t len)
+{
+    int64_t end_us = esp_timer_get_time() + ((int64_t) (len + 1) * 9 + 2) * 1000000 / g_master_clock;
+    int64_t now_us;
+
+    while ((now_us = esp_timer_get_time()) < end_us) {
+        TickType_t ticks = (end_us - now_us) / 1000 / portTICK_PERIOD_MS;
+        if (ticks > 0) {
+            vTaskDelay(ticks);
+        }
+    }
+}
+
+esp_err_t menjin_bus_master_write(const uint8_t *data, size_t len)
+{
+    if (!g_master_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    sim_bus_time(len);
+
+    menjin_sim_record_t *record;
+    esp_err_t ret = ESP_OK;
+
+    taskENTER_CRITICAL(&g_sim_lock);
+    if (g_stuck) {
+        ret = ESP_ERR_TIMEOUT;
+    } else if (g_script_pos < g_script_len) {
+        ret = g_script[g_script_pos++];
+        if (ret == ESP_ERR_TIMEOUT) {
+            g_stuck = true;
+            g_hold_remaining = g_hold_clocks;
+        }
+    }
+
+    if (ret == ESP_OK) {
+        g_last_cmd = data[0];
+    }
+    record = &g_log[g_log_head];
+    record->time_us = esp_timer_get_time();
+    record->addr = g_master_addr;
+    record->len = len < MENJIN_FRAME_MAX ? len : MENJIN_FRAME_MAX;
+    memcpy(record->data, data, record->len);
+    record->ret = ret;
+    g_log_head = (g_log_head + 1) % MENJIN_SIM_LOG_LEN;
+    if (g_log_count < MENJIN_SIM_LOG_LEN) {
+        g_log_count++;
+    }
+    taskEXIT_CRITICAL(&g_sim_lock);
+
+    ESP_LOGD(TAG, "controller received[0x%02x]: 0x%02x, len: %d, ret: %d", g_master_addr, data[0], (int) len, ret);
+
+    return ret;
+}
+
+esp_err_t menjin_bus_master_probe(uint8_t *data)
+{
+    if (!g_master_installed) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    sim_bus_time(data != NULL ? 1 : 0);
+
+    if (g_stuck) {
+        return ESP_ERR_TIMEOUT;
+    }
+    if (data != NULL) {
+        *data = g_last_cmd;
+    }
+
+    return g_max_clock > 0 && g_master_clock > g_max_clock ? ESP_FAIL : ESP_OK;
+}
+
+static int sim_sda_level(void)
+{
+    return g_sda && !g_stuck;
+}
+
+static void sim_scl_set(void *ctx, int level)
+{
+    // 卡住的从机在每个时钟下降沿移出一位
+    if (g_scl && !level && g_stuck && g_hold_clocks < SIM_RELEASE_NEVER) {
+        if (g_hold_remaining > 0) {
+            g_hold_remaining--;
+        }
+        if (g_hold_remaining == 0) {
+            g_stuck = false;
+        }
+    }
+    g_scl = level;
+}
+
+static void sim_sda_set(void *ctx, int level)
+{
+    g_sda = level;
+}
+
+static int sim_sda_get(void *ctx)
+{
+    return sim_sda_level();
+}
+
+static void sim_delay_us(void *ctx, uint32_t us)
+{
+}
+
+static const i2c_bus_ops_t g_sim_bus_ops = {
+        .scl_set = sim_scl_set,
+        .sda_set = sim_sda_set,
+        .sda_get = sim_sda_get,
+        .delay_us = sim_delay_us,
+};
+
+bool menjin_bus_master_recover(uint32_t clock)
+{
+    taskENTER_CRITICAL(&g_sim_lock);
+    bool bus_free = i2c_bus_recover(&g_sim_bus_ops, 0);
+    taskEXIT_CRITICAL(&g_sim_lock);
+
+    return bus_free;
+}
+
+bool menjin_bus_master_idle(void)
+{
+    return sim_sda_level() && g_scl;
+}
+
+esp_err_t menjin_bus_slave_init(uint8_t addr, uint32_t clock)
+{
+    if (g_keyboard_buf == NULL) {
+        g_keyboard_buf = xStreamBufferCreate(SIM_KEYBOARD_BUF_LEN, 1);
+        ESP_RETURN_ON_FALSE(g_keyboard_buf != NULL, ESP_ERR_NO_MEM, TAG, "No memory for keyboard buffer");
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t menjin_bus_slave_deinit(void)
+{
+    return ESP_OK;
+}
+
+int menjin_bus_slave_read(uint8_t *buf, size_t max, TickType_t ticks_to_wait)
+{
+    if (g_keyboard_buf == NULL) {
+        vTaskDelay(ticks_to_wait);
+        return 0;
+    }
+
+    return xStreamBufferReceive(g_keyboard_buf, buf, max, ticks_to_wait);
+}
+
+bool menjin_bus_slave_idle(void)
+{
+    return true;
+}
+
+#endif // CONFIG_MENJIN_BUS_SIM
@@ -0,0 +1,255 @@
+#include <string.h>
+#include <math.h>
+#include "ring_detect.h"
+
+#define DC_SHIFT        6       // DC tracker time constant, 2^6 samples
+#define COEFF_SHIFT     14
+// baseline tracker: follows drops quickly (min-tracker), rises slowly, almost frozen while ringing
+#define BASELINE_DOWN_SHIFT 2
+#define BASELINE_UP_SHIFT   5
+#define BASELINE_ON_SHIFT   10
+
+// ms -> blocks, rounded up, at least one block
+static uint16_t ms_to_blocks(const ring_detect_config_t *cfg, uint16_t ms)
+{
+    if (ms == 0) {
+        return 0;
+    }
+    uint64_t block_samples_ms = (uint64_t) cfg->window * 1000;
+    uint64_t blocks = ((uint64_t) ms * cfg->sample_rate_hz + block_samples_ms - 1) / block_samples_ms;
+
+    if (blocks > UINT16_MAX) {
+        return UINT16_MAX;
+    }
+
+    return blocks > 0 ? blocks : 1;
+}
+
+int ring_detect_init(ring_detect_t *rd, const ring_detect_config_t *cfg)
+{
+    int ret = 0;
+
+    memset(rd, 0, sizeof(ring_detect_t));
+    rd->cfg = *cfg;
+    if (rd->cfg.window == 0) {
+        rd->cfg.window = 1;
+    }
+    if (rd->cfg.bursts == 0) {
+        rd->cfg.bursts = 1;
+    }
+
+    // Goertzel above Nyquist would alias onto another frequency, fall back to level mode
+    if (rd->cfg.tone_hz > 0 && (uint32_t) rd->cfg.tone_hz * 2 >= rd->cfg.sample_rate_hz) {
+        rd->cfg.tone_hz = 0;
+        ret = -1;
+    }
+    if (rd->cfg.tone_hz > 0) {
+        double w = 2.0 * M_PI * rd->cfg.tone_hz / rd->cfg.sample_rate_hz;
+        rd->coeff_q14 = (int32_t) lround(2.0 * cos(w) * (1 << COEFF_SHIFT));
+    }
+
+    rd->baseline_q8 = rd->cfg.baseline_seed << 8;
+
+    rd->on_min = ms_to_blocks(&rd->cfg, rd->cfg.on_min_ms);
+    if (rd->on_min == 0) {
+        rd->on_min = 1;
+    }
+    rd->on_max = ms_to_blocks(&rd->cfg, rd->cfg.on_max_ms);
+    rd->off_min = ms_to_blocks(&rd->cfg, rd->cfg.off_min_ms);
+    rd->off_max = ms_to_blocks(&rd->cfg, rd->cfg.off_max_ms);
+
+    return ret;
+}
+
+void ring_detect_reset(ring_detect_t *rd)
+{
+    rd->count = 0;
+    rd->acc = 0;
+    rd->s1 = 0;
+    rd->s2 = 0;
+    rd->energy = 0;
+    rd->state = RING_CADENCE_IDLE;
+    rd->run = 0;
+    rd->burst_count = 0;
+    rd->level_on = false;
+}
+
+uint32_t ring_detect_get_baseline(const ring_detect_t *rd)
+{
+    return rd->baseline_q8 >> 8;
+}
+
+uint32_t ring_detect_get_threshold(const ring_detect_t *rd)
+{
+    if (!rd->cfg.adaptive) {
+        return rd->cfg.threshold;
+    }
+
+    uint32_t baseline = rd->baseline_q8 >> 8;
+
+    return rd->level_on ? baseline + rd->cfg.margin / 2 : baseline + rd->cfg.margin;
+}
+
+static bool level_is_on(ring_detect_t *rd)
+{
+    if (!rd->cfg.adaptive) {
+        return rd->last_avg > rd->cfg.threshold;
+    }
+
+    int32_t avg_q8 = (int32_t) (rd->last_avg << 8);
+    if (rd->baseline_q8 == 0) {
+        rd->baseline_q8 = avg_q8;
+    }
+
+    rd->level_on = rd->last_avg > ring_detect_get_threshold(rd);
+
+    int32_t delta = avg_q8 - (int32_t) rd->baseline_q8;
+    if (rd->level_on) {
+        delta >>= BASELINE_ON_SHIFT;
+    } else if (delta < 0) {
+        delta >>= BASELINE_DOWN_SHIFT;
+    } else {
+        delta >>= BASELINE_UP_SHIFT;
+    }
+    rd->baseline_q8 += delta;
+
+    return rd->level_on;
+}
+
+static bool block_is_on(ring_detect_t *rd)
+{
+    rd->last_avg = rd->acc / rd->count;
+
+    if (rd->cfg.tone_hz == 0) {
+        return level_is_on(rd);
+    }
+
+    int64_t s1 = rd->s1;
+    int64_t s2 = rd->s2;
+    int64_t power = s1 * s1 + s2 * s2 - ((rd->coeff_q14 * s1) >> COEFF_SHIFT) * s2;
+    int64_t n = rd->count;
+
+    // pure tone of amplitude A: power ~= (A * n / 2)^2, energy ~= n * A^2 / 2
+    rd->last_tone_pct = rd->energy > 0 ? (uint32_t) (power * 200 / (rd->energy * n)) : 0;
+
+    int64_t min_amp = (int64_t) rd->cfg.tone_min_amplitude * n;
+
+    return rd->last_tone_pct >= rd->cfg.tone_ratio_pct && power * 4 > min_amp * min_amp;
+}
+
+static bool cadence_step(ring_detect_t *rd, bool on)
+{
+    switch (rd->state) {
+        case RING_CADENCE_IDLE:
+            if (on) {
+                rd->state = RING_CADENCE_ON;
+                rd->run = 1;
+            }
+            return false;
+        case RING_CADENCE_OFF:
+            if (on) {
+                if (rd->run < rd->off_min) {
+                    // pause too short, restart pattern matching from this burst
+                    rd->stats.rejected++;
+                    rd->burst_count = 0;
+                }
+                rd->state = RING_CADENCE_ON;
+                rd->run = 1;
+            } else {
+                if (rd->run < UINT16_MAX) {
+                    rd->run++;
+                }
+                if (rd->off_max > 0 && rd->run > rd->off_max) {
+                    rd->state = RING_CADENCE_IDLE;
+                    rd->burst_count = 0;
+                }
+            }
+            return false;
+        case RING_CADENCE_ON:
+            if (on) {
+                if (rd->run < UINT16_MAX) {
+                    rd->run++;
+                }
+                if (rd->on_max > 0 && rd->run > rd->on_max) {
+                    rd->stats.rejected++;
+                    rd->burst_count = 0;
+                    rd->state = RING_CADENCE_INVALID;
+                }
+                return false;
+            }
+            // burst ended, its length is known now
+            if (rd->run < rd->on_min) {
+                rd->stats.rejected++;
+                rd->burst_count = 0;
+                rd->state = RING_CADENCE_IDLE;
+                return false;
+            }
+            rd->stats.bursts++;
+            if (rd->burst_count < UINT8_MAX) {
+                rd->burst_count++;
+            }
+            rd->state = RING_CADENCE_OFF;
+            rd->run = 1;
+            if (rd->burst_count >= rd->cfg.bursts) {
+                rd->stats.detections++;
+                return true;
+            }
+            return false;
+        case RING_CADENCE_INVALID:
+            if (!on) {
+                rd->state = RING_CADENCE_IDLE;
+            }
+            return false;
+    }
+
+    return false;
+}
+
+bool ring_detect_feed(ring_detect_t *rd, uint16_t sample)
+{
+    // 异常高值处理
+    if (sample > rd->cfg.sample_max) {
+        sample = ring_detect_get_threshold(rd);
+    }
+    rd->acc += sample;
+
+    if (rd->cfg.tone_hz > 0) {
+        // remove DC, then one Goertzel iteration
+        rd->dc_q8 += (((int32_t) sample << 8) - rd->dc_q8) >> DC_SHIFT;
+        int32_t x = (int32_t) sample - (rd->dc_q8 >> 8);
+        int32_t s0 = x + (int32_t) (((int64_t) rd->coeff_q14 * rd->s1) >> COEFF_SHIFT) - rd->s2;
+        rd->s2 = rd->s1;
+        rd->s1 = s0;
+        rd->energy += (int64_t) x * x;
+    }
+
+    if (++rd->count < rd->cfg.window) {
+        return false;
+    }
+
+    bool on = block_is_on(rd);
+
+    rd->count = 0;
+    rd->acc = 0;
+    rd->s1 = 0;
+    rd->s2 = 0;
+    rd->energy = 0;
+
+    rd->stats.windows++;
+    if (on) {
+        rd->stats.on_windows++;
+    }
+
+    return cadence_step(rd, on);
+}
+
+bool ring_detect_feed_block(ring_detect_t *rd, const uint16_t *samples, size_t n)
+{
+    bool detected = false;
+
+    for (size_t i = 0; i < n; ++i) {
+        detected |= ring_detect_feed(rd, samples[i]);
+    }
+
+    return detected;
+}
@@ -13,6 +13,7 @@
 #include "freertos/queue.h"
 #include "settings.h"
 #include "app_menjin.h"
+#include "app_macro.h"
 #include "iot_button.h"
 
 static const char *TAG = "APP_KEYS";
@@ -76,15 +77,16 @@ static void key_event_handle_task(void *arg)
                     esp_restart();
                     break;
                 case K2_PIN:
-                    ESP_LOGI(TAG, "PRESS KEY2 - KEY(XX)");
+                    ESP_LOGI(TAG, "PRESS KEY2 - MACRO(open)");
+                    app_macro_run("open", MENJIN_PRIO_KEY);
                     break;
                 case K3_PIN:
                     ESP_LOGI(TAG, "PRESS KEY3 - KEY(Unlock)");
-                    menjin_cmd_write(MENJIN_CMD_KEY3_UNLOCK);
+                    menjin_cmd_enqueue(MENJIN_CMD_KEY3_UNLOCK, MENJIN_PRIO_KEY, NULL, NULL);
                     break;
                 case K4_PIN:
                     ESP_LOGI(TAG, "PRESS KEY4 - SPEAKER(Hand Free)");
-                    menjin_cmd_write(MENJIN_CMD_KEY4_SPEAKER);
+                    menjin_cmd_enqueue(MENJIN_CMD_KEY4_SPEAKER, MENJIN_PRIO_KEY, NULL, NULL);
                     break;
                 default:
                     break;
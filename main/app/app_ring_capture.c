@@ -0,0 +1,276 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+#include "ring_capture.h"
+#include "app_ring_capture.h"
+
+static const char *TAG = "RING_CAPTURE";
+
+#define CAPTURE_PATH_FMT    CONFIG_BSP_SPIFFS_MOUNT_POINT "/ring_%d.bin"
+#define CAPTURE_FILES       CONFIG_MENJIN_RING_CAPTURE_FILES
+#define CAPTURE_INTERVAL_US (CONFIG_MENJIN_RING_CAPTURE_INTERVAL * 1000000LL)
+#define CAPTURE_QUEUE_LEN   4
+// ON/OFF 上限为 0（不限）时检测器可能一直停在 OFF 等下一声、不回到 IDLE，这两段各按 5 s 算；
+// 触发后多出一声的时间仍没有结论，就按已有的标记结束，否则之后的振铃都抓不到
+#define CAPTURE_ON_MS       (CONFIG_MENJIN_RING_ON_MAX_MS > 0 ? CONFIG_MENJIN_RING_ON_MAX_MS : 5000)
+#define CAPTURE_OFF_MS      (CONFIG_MENJIN_RING_OFF_MAX_MS > 0 ? CONFIG_MENJIN_RING_OFF_MAX_MS : 5000)
+#define CAPTURE_VERDICT_MS  ((CONFIG_MENJIN_RING_BURSTS + 1) * (CAPTURE_ON_MS + CAPTURE_OFF_MS))
+
+// 振铃检测任务发给写任务的消息，header.flags 只由写任务修改
+typedef enum {
+    CAPTURE_MSG_READY = 0,      // post-trigger part recorded
+    CAPTURE_MSG_VERDICT,        // detector decided, flags attached
+} capture_msg_type_t;
+
+typedef struct {
+    uint8_t type;
+    uint8_t flags;
+} capture_msg_t;
+
+static ring_capture_t g_capture;
+static QueueHandle_t g_writer_queue = NULL;
+static uint32_t g_next_seq = 0;
+static uint32_t g_verdict_timeout = 0;
+// 以下三个只在振铃检测任务中使用
+static bool g_verdict_open = false;
+static uint8_t g_verdict_flags = 0;
+static uint32_t g_verdict_samples = 0;
+
+esp_err_t app_ring_capture_path(int id, char *path, size_t len)
+{
+    ESP_RETURN_ON_FALSE(id >= 0 && id < CAPTURE_FILES, ESP_ERR_INVALID_ARG, TAG, "invalid capture id %d", id);
+    snprintf(path, len, CAPTURE_PATH_FMT, id);
+
+    return ESP_OK;
+}
+
+static esp_err_t read_header(int id, ring_capture_header_t *header, uint32_t *size)
+{
+    char path[32];
+    ESP_RETURN_ON_ERROR(app_ring_capture_path(id, path, sizeof(path)), TAG, "");
+
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    size_t read_len = fread(header, 1, sizeof(ring_capture_header_t), fp);
+    fseek(fp, 0, SEEK_END);
+    *size = ftell(fp);
+    fclose(fp);
+
+    if (read_len != sizeof(ring_capture_header_t) || header->magic != RING_CAPTURE_MAGIC) {
+        return ESP_ERR_INVALID_RESPONSE;
+    }
+
+    return ESP_OK;
+}
+
+#ifdef CONFIG_MENJIN_RING_CAPTURE
+static esp_err_t write_capture(void)
+{
+    char path[32];
+    int id = g_next_seq % CAPTURE_FILES;
+    app_ring_capture_path(id, path, sizeof(path));
+
+    FILE *fp = fopen(path, "wb");
+    ESP_RETURN_ON_FALSE(fp != NULL, ESP_FAIL, TAG, "Failed to open %s", path);
+
+    g_capture.header.seq = g_next_seq;
+
+    esp_err_t ret = ESP_OK;
+    if (fwrite(&g_capture.header, sizeof(ring_capture_header_t), 1, fp) != 1) {
+        ret = ESP_FAIL;
+    }
+
+    for (int i = 0; i < 3 && ret == ESP_OK; ++i) {
+        const uint16_t *data = NULL;
+        uint32_t len = ring_capture_segment(&g_capture, i, &data);
+        if (len > 0 && fwrite(data, sizeof(uint16_t), len, fp) != len) {
+            ret = ESP_FAIL;
+        }
+    }
+    fclose(fp);
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write %s", path);
+        unlink(path);
+        return ret;
+    }
+
+    ESP_LOGI(TAG, "Capture #%lu saved to %s, samples: %lu, flags: 0x%02x",
+             g_next_seq, path, g_capture.header.samples, g_capture.header.flags);
+    g_next_seq++;
+
+    return ESP_OK;
+}
+
+_Noreturn static void ring_capture_writer_task(void *param)
+{
+    capture_msg_t msg;
+    bool ready = false;
+    bool decided = false;
+    uint8_t flags = 0;
+    int64_t last_saved_us = 0;
+
+    while (1) {
+        xQueueReceive(g_writer_queue, &msg, portMAX_DELAY);
+
+        if (msg.type == CAPTURE_MSG_READY) {
+            ready = true;
+        } else {
+            decided = true;
+            flags = msg.flags;
+        }
+        // 录完且有结论后才决定是否保存，先到哪个都可以
+        if (!ready || !decided) {
+            continue;
+        }
+
+        int64_t now = esp_timer_get_time();
+        if (flags == 0) {
+            ESP_LOGD(TAG, "Capture dropped, neither detected nor rejected");
+        } else if (last_saved_us > 0 && now - last_saved_us < CAPTURE_INTERVAL_US) {
+            ESP_LOGI(TAG, "Capture dropped, last one saved %lld s ago", (now - last_saved_us) / 1000000);
+        } else {
+            g_capture.header.flags |= flags;
+            if (write_capture() == ESP_OK) {
+                last_saved_us = now;
+            }
+        }
+        ring_capture_release(&g_capture);
+        ready = false;
+        decided = false;
+    }
+}
+#endif
+
+esp_err_t app_ring_capture_init(uint32_t sample_rate_hz)
+{
+#ifdef CONFIG_MENJIN_RING_CAPTURE
+    uint32_t pre = sample_rate_hz * CONFIG_MENJIN_RING_CAPTURE_PRE_MS / 1000;
+    uint32_t post = sample_rate_hz * CONFIG_MENJIN_RING_CAPTURE_POST_MS / 1000;
+
+    uint16_t *buf = malloc((pre + post) * sizeof(uint16_t));
+    ESP_RETURN_ON_FALSE(buf != NULL, ESP_ERR_NO_MEM, TAG, "No memory for capture buffer");
+
+    // continue the sequence from the newest stored capture
+    ring_capture_header_t header;
+    uint32_t size;
+    for (int i = 0; i < CAPTURE_FILES; ++i) {
+        if (read_header(i, &header, &size) == ESP_OK && header.seq + 1 > g_next_seq) {
+            g_next_seq = header.seq + 1;
+        }
+    }
+
+    ring_capture_init(&g_capture, buf, pre, post, sample_rate_hz);
+    g_verdict_timeout = (uint64_t) sample_rate_hz * CAPTURE_VERDICT_MS / 1000;
+
+    g_writer_queue = xQueueCreate(CAPTURE_QUEUE_LEN, sizeof(capture_msg_t));
+    if (g_writer_queue == NULL
+        || xTaskCreate(ring_capture_writer_task, "ring_capture_task", 3072, NULL, 1, NULL) != pdPASS) {
+        free(buf);
+        g_capture.buf = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Ring capture ready, pre: %lu, post: %lu samples, next seq: %lu", pre, post, g_next_seq);
+
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_SUPPORTED;
+#endif
+}
+
+void app_ring_capture_feed(uint16_t sample)
+{
+    if (g_capture.buf == NULL) {
+        return;
+    }
+
+    if (ring_capture_feed(&g_capture, sample)) {
+        capture_msg_t msg = {.type = CAPTURE_MSG_READY};
+        xQueueSend(g_writer_queue, &msg, 0);
+    }
+
+    if (g_verdict_open && ++g_verdict_samples >= g_verdict_timeout) {
+        ESP_LOGI(TAG, "No verdict %d ms after the trigger, closing capture", CAPTURE_VERDICT_MS);
+        app_ring_capture_close();
+    }
+}
+
+void app_ring_capture_trigger(uint32_t threshold, uint32_t baseline)
+{
+    if (g_capture.buf == NULL) {
+        return;
+    }
+
+    if (ring_capture_trigger(&g_capture, time(NULL), threshold, baseline)) {
+        g_verdict_open = true;
+        g_verdict_flags = 0;
+        g_verdict_samples = 0;
+    }
+}
+
+void app_ring_capture_mark(uint8_t flags)
+{
+    if (g_verdict_open) {
+        g_verdict_flags |= flags;
+    }
+}
+
+void app_ring_capture_close(void)
+{
+    if (!g_verdict_open) {
+        return;
+    }
+    g_verdict_open = false;
+
+    // 每次触发只有一个 READY 和一个 VERDICT，队列不会满
+    capture_msg_t msg = {.type = CAPTURE_MSG_VERDICT, .flags = g_verdict_flags};
+    xQueueSend(g_writer_queue, &msg, 0);
+}
+
+int app_ring_capture_list(app_ring_capture_info_t *infos, int max)
+{
+    int count = 0;
+    ring_capture_header_t header;
+    uint32_t size;
+
+    for (int i = 0; i < CAPTURE_FILES && count < max; ++i) {
+        if (read_header(i, &header, &size) != ESP_OK) {
+            continue;
+        }
+
+        app_ring_capture_info_t info = {
+                .id = i,
+                .seq = header.seq,
+                .timestamp = header.timestamp,
+                .sample_rate_hz = header.sample_rate_hz,
+                .samples = header.samples,
+                .trigger = header.trigger,
+                .size = size,
+                .detected = (header.flags & RING_CAPTURE_FLAG_DETECTED) != 0,
+                .rejected = (header.flags & RING_CAPTURE_FLAG_REJECTED) != 0,
+        };
+
+        // insertion sort, newest first
+        int j = count++;
+        while (j > 0 && infos[j - 1].seq < info.seq) {
+            infos[j] = infos[j - 1];
+            j--;
+        }
+        infos[j] = info;
+    }
+
+    return count;
+}
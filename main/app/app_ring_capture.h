@@ -0,0 +1,66 @@
+#ifndef ESP_MENJIN_APP_RING_CAPTURE_H
+#define ESP_MENJIN_APP_RING_CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <esp_err.h>
+
+typedef struct {
+    int id;
+    uint32_t seq;
+    uint32_t timestamp;
+    uint32_t sample_rate_hz;
+    uint32_t samples;
+    uint32_t trigger;
+    uint32_t size;
+    bool detected;
+    bool rejected;
+} app_ring_capture_info_t;
+
+/**
+ * @brief Allocate the capture buffer and start the SPIFFS writer task
+ *
+ * @return ESP_ERR_NOT_SUPPORTED if captures are disabled in menuconfig
+ */
+esp_err_t app_ring_capture_init(uint32_t sample_rate_hz);
+
+/**
+ * @brief Feed one raw sample, called from the ring detect task only
+ */
+void app_ring_capture_feed(uint16_t sample);
+
+/**
+ * @brief Start recording the post-trigger part, ignored while a capture is in progress
+ */
+void app_ring_capture_trigger(uint32_t threshold, uint32_t baseline);
+
+/**
+ * @brief Add RING_CAPTURE_FLAG_* to the verdict of the triggered capture, ring detect task only
+ */
+void app_ring_capture_mark(uint8_t flags);
+
+/**
+ * @brief Hand the verdict of the triggered capture to the writer task, ring detect task only
+ *
+ * Called once the detector has decided on the burst sequence: a ring was reported or it went
+ * back to idle. With an unbounded burst or pause the detector may never go back to idle, so
+ * app_ring_capture_feed() also closes the capture once the longest sequence the cadence
+ * allows has passed since the trigger. Only captures marked detected or rejected are saved, at most one per
+ * CONFIG_MENJIN_RING_CAPTURE_INTERVAL seconds; the others are dropped.
+ */
+void app_ring_capture_close(void);
+
+/**
+ * @brief List the stored captures, newest first
+ *
+ * @return number of entries written to infos
+ */
+int app_ring_capture_list(app_ring_capture_info_t *infos, int max);
+
+/**
+ * @brief Get the SPIFFS path of a stored capture
+ */
+esp_err_t app_ring_capture_path(int id, char *path, size_t len);
+
+#endif //ESP_MENJIN_APP_RING_CAPTURE_H
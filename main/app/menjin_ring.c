@@ -0,0 +1,226 @@
+#include <string.h>
+#include <inttypes.h>
+#include <esp_attr.h>
+#include <esp_adc/adc_continuous.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_check.h"
+
+#include "settings.h"
+#include "app_menjin.h"
+#include "menjin_ring.h"
+#include "ring_detect.h"
+#include "app_ring_capture.h"
+#include "ring_capture.h"
+
+
+static const char *TAG = "MENJIN_RING";
+
+// 门铃检测相关
+#define RING_ADC_UNIT                ADC_UNIT_1
+#define RING_ADC_CHANNEL             ADC_CHANNEL_0
+#define RING_ADC_FRAME_BYTES         (CONFIG_MENJIN_RING_FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES)
+#define RING_ADC_STORE_BYTES         (RING_ADC_FRAME_BYTES * 4)
+#define RING_WINDOW_SAMPLES          (CONFIG_MENJIN_RING_SAMPLE_FREQ_HZ * CONFIG_MENJIN_RING_WINDOW_MS / 1000)
+// Kconfig 的 range 不能引用采样率的一半，在这里检查
+_Static_assert(CONFIG_MENJIN_RING_TONE_HZ * 2 < CONFIG_MENJIN_RING_SAMPLE_FREQ_HZ,
+               "MENJIN_RING_TONE_HZ must be below half of MENJIN_RING_SAMPLE_FREQ_HZ");
+// DMA采样位宽低于oneshot，左移对齐以沿用原有的 ring_adc_threshold
+#define RING_ADC_SCALE_SHIFT         (SOC_ADC_RTC_MAX_BITWIDTH - SOC_ADC_DIGI_MAX_BITWIDTH)
+#define ADC_VALUE_MAX                6000            // ADC采样值的最大值
+
+#define CALLBACK_INTERVAL_MS (30 * 1000) // 回调函数的调用频率，单位：毫秒
+
+static void (*g_ring_callback)(void) = NULL; // ADC输入的回调函数
+static menjin_ring_stats_t g_ring_stats = {0};
+static portMUX_TYPE g_ring_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void menjin_set_ring_callback(void (*callback)(void)) {
+    g_ring_callback = callback;
+}
+
+void* menjin_get_ring_callback(void) {
+    return g_ring_callback;
+}
+
+void menjin_get_ring_stats(menjin_ring_stats_t *stats)
+{
+    taskENTER_CRITICAL(&g_ring_stats_lock);
+    *stats = g_ring_stats;
+    taskEXIT_CRITICAL(&g_ring_stats_lock);
+}
+
+static TaskHandle_t g_ring_task_handle = NULL;
+
+static bool IRAM_ATTR ring_adc_conv_done_cb(adc_continuous_handle_t handle, const adc_continuous_evt_data_t *edata, void *user_data)
+{
+    BaseType_t must_yield = pdFALSE;
+    vTaskNotifyGiveFromISR(g_ring_task_handle, &must_yield);
+
+    return must_yield == pdTRUE;
+}
+
+static esp_err_t ring_adc_init(adc_continuous_handle_t *out_handle)
+{
+    adc_continuous_handle_t handle = NULL;
+
+    adc_continuous_handle_cfg_t handle_cfg = {
+            .max_store_buf_size = RING_ADC_STORE_BYTES,
+            .conv_frame_size = RING_ADC_FRAME_BYTES,
+    };
+    ESP_RETURN_ON_ERROR(adc_continuous_new_handle(&handle_cfg, &handle), TAG, "adc_continuous_new_handle failed");
+
+    adc_digi_pattern_config_t pattern = {
+            .atten = ADC_ATTEN_DB_0,
+            .channel = RING_ADC_CHANNEL,
+            .unit = RING_ADC_UNIT,
+            .bit_width = SOC_ADC_DIGI_MAX_BITWIDTH,
+    };
+
+    adc_continuous_config_t dig_cfg = {
+            .pattern_num = 1,
+            .adc_pattern = &pattern,
+            .sample_freq_hz = CONFIG_MENJIN_RING_SAMPLE_FREQ_HZ,
+            .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+            .format = ADC_DIGI_OUTPUT_FORMAT_TYPE1,
+    };
+    ESP_RETURN_ON_ERROR(adc_continuous_config(handle, &dig_cfg), TAG, "adc_continuous_config failed");
+
+    adc_continuous_evt_cbs_t cbs = {
+            .on_conv_done = ring_adc_conv_done_cb,
+    };
+    ESP_RETURN_ON_ERROR(adc_continuous_register_event_callbacks(handle, &cbs, NULL), TAG, "register adc callbacks failed");
+
+    *out_handle = handle;
+
+    return ESP_OK;
+}
+
+// ADC输入检测任务
+_Noreturn void menjin_ring_detect_task(void* pvParameters) {
+    static uint8_t frame[RING_ADC_FRAME_BYTES];
+    TickType_t lastCallbackTime = 0;
+    uint32_t read_len = 0;
+    adc_continuous_handle_t adc_handle = NULL;
+    ring_detect_t detector;
+
+    sys_param_t *settings = settings_get_parameter();
+
+    ring_detect_config_t detect_cfg = {
+            .sample_rate_hz = CONFIG_MENJIN_RING_SAMPLE_FREQ_HZ,
+            .threshold = settings->ring_adc_threshold,
+            .sample_max = ADC_VALUE_MAX,
+            .window = RING_WINDOW_SAMPLES,
+            .adaptive = settings->ring_adaptive,
+            .margin = settings->ring_margin,
+            .baseline_seed = settings->ring_baseline,
+            .tone_hz = CONFIG_MENJIN_RING_TONE_HZ,
+            .tone_ratio_pct = CONFIG_MENJIN_RING_TONE_RATIO,
+            .tone_min_amplitude = CONFIG_MENJIN_RING_TONE_MIN_AMPLITUDE,
+            .on_min_ms = CONFIG_MENJIN_RING_ON_MIN_MS,
+            .on_max_ms = CONFIG_MENJIN_RING_ON_MAX_MS,
+            .off_min_ms = CONFIG_MENJIN_RING_OFF_MIN_MS,
+            .off_max_ms = CONFIG_MENJIN_RING_OFF_MAX_MS,
+            .bursts = CONFIG_MENJIN_RING_BURSTS,
+    };
+    if (ring_detect_init(&detector, &detect_cfg) != 0) {
+        ESP_LOGE(TAG, "Ring tone %d Hz above Nyquist, using level mode", CONFIG_MENJIN_RING_TONE_HZ);
+    }
+    if (detector.cfg.tone_hz > 0) {
+        ESP_LOGW(TAG, "Ring tone mode at %u Hz, ring_adc_threshold, ring_adaptive and ring_margin have no effect",
+                 detector.cfg.tone_hz);
+    }
+    taskENTER_CRITICAL(&g_ring_stats_lock);
+    g_ring_stats.tone_hz = detector.cfg.tone_hz;
+    taskEXIT_CRITICAL(&g_ring_stats_lock);
+
+    g_ring_task_handle = xTaskGetCurrentTaskHandle();
+
+    esp_err_t err = app_ring_capture_init(CONFIG_MENJIN_RING_SAMPLE_FREQ_HZ);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Ring capture disabled: %s", esp_err_to_name(err));
+    }
+
+    ESP_ERROR_CHECK(ring_adc_init(&adc_handle));
+    ESP_ERROR_CHECK(adc_continuous_start(adc_handle));
+
+    while (1) {
+        // 等待DMA转换完成的通知
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        detector.cfg.threshold = settings->ring_adc_threshold;
+        detector.cfg.adaptive = settings->ring_adaptive;
+        detector.cfg.margin = settings->ring_margin;
+
+        bool detected = false;
+        while (adc_continuous_read(adc_handle, frame, sizeof(frame), &read_len, 0) == ESP_OK) {
+            for (uint32_t i = 0; i < read_len; i += SOC_ADC_DIGI_RESULT_BYTES) {
+                adc_digi_output_data_t *p = (adc_digi_output_data_t *) &frame[i];
+                if (p->type1.channel != RING_ADC_CHANNEL) {
+                    continue;
+                }
+                uint16_t sample = p->type1.data << RING_ADC_SCALE_SHIFT;
+                app_ring_capture_feed(sample);
+
+                ring_cadence_state_t prev_state = detector.state;
+                uint32_t prev_rejected = detector.stats.rejected;
+                bool hit = ring_detect_feed(&detector, sample);
+                // 每次振铃开始时抓取前后的原始波形，检测器有结论后再决定是否保存
+                if (prev_state == RING_CADENCE_IDLE && detector.state == RING_CADENCE_ON) {
+                    app_ring_capture_trigger(ring_detect_get_threshold(&detector), ring_detect_get_baseline(&detector));
+                }
+                if (detector.stats.rejected != prev_rejected) {
+                    app_ring_capture_mark(RING_CAPTURE_FLAG_REJECTED);
+                }
+                if (hit) {
+                    detected = true;
+                    app_ring_capture_mark(RING_CAPTURE_FLAG_DETECTED);
+                    app_ring_capture_close();
+                } else if (prev_state != RING_CADENCE_IDLE && detector.state == RING_CADENCE_IDLE) {
+                    app_ring_capture_close();
+                }
+            }
+        }
+
+        taskENTER_CRITICAL(&g_ring_stats_lock);
+        g_ring_stats.detect = detector.stats;
+        g_ring_stats.threshold = ring_detect_get_threshold(&detector);
+        // 学习到的基线只在这里发布，保存设置时由 settings 取回
+        g_ring_stats.baseline = ring_detect_get_baseline(&detector);
+        g_ring_stats.last_avg = detector.last_avg;
+        taskEXIT_CRITICAL(&g_ring_stats_lock);
+
+        if (!detected) {
+            continue;
+        }
+
+        ESP_LOGI(TAG, "Ring detected, ADC avg value: %" PRIu32 ", threshold: %" PRIu32 ", tone: %" PRIu32 "%%, "
+                      "bursts: %" PRIu32 ", rejected: %" PRIu32,
+                 detector.last_avg, ring_detect_get_threshold(&detector), detector.last_tone_pct,
+                 detector.stats.bursts, detector.stats.rejected);
+        if (menjin_ring_is_suppressed()) {
+            ESP_LOGI(TAG, "Ring suppressed, command sequence in progress");
+            taskENTER_CRITICAL(&g_ring_stats_lock);
+            g_ring_stats.suppressed++;
+            taskEXIT_CRITICAL(&g_ring_stats_lock);
+            continue;
+        }
+
+        // 检查是否满足回调函数调用频率限制
+        if (xTaskGetTickCount() - lastCallbackTime >= pdMS_TO_TICKS(CALLBACK_INTERVAL_MS)) {
+            // 调用回调函数
+            if (g_ring_callback != NULL) {
+                g_ring_callback();
+            }
+            taskENTER_CRITICAL(&g_ring_stats_lock);
+            g_ring_stats.reported++;
+            taskEXIT_CRITICAL(&g_ring_stats_lock);
+
+            // 更新最后回调时间
+            lastCallbackTime = xTaskGetTickCount();
+        }
+    }
+}
@@ -0,0 +1,25 @@
+// Ring detection task: samples the intercom speaker line with the ADC continuous driver and
+// runs it through ring_detect. Board only; the command queue and bridge live in menjin_core.
+
+#ifndef ESP_MENJIN_MENJIN_RING_H
+#define ESP_MENJIN_MENJIN_RING_H
+
+#include <stdint.h>
+#include "ring_detect.h"
+
+typedef struct {
+    ring_detect_stats_t detect;             // detector counters since boot
+    uint32_t reported;                      // ring callbacks
+    uint32_t suppressed;                    // rings dropped while a command sequence runs
+    uint32_t threshold;                     // threshold in effect
+    uint32_t baseline;                      // learned noise floor
+    uint32_t last_avg;                      // average of the last completed block
+    uint16_t tone_hz;                       // tone mode when non-zero, threshold and adaptive settings unused
+} menjin_ring_stats_t;
+
+void menjin_set_ring_callback(void (*callback)(void));
+void* menjin_get_ring_callback(void);
+void menjin_ring_detect_task(void* pvParameters);
+void menjin_get_ring_stats(menjin_ring_stats_t *stats);
+
+#endif //ESP_MENJIN_MENJIN_RING_H
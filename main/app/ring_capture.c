@@ -0,0 +1,89 @@
+#include <string.h>
+#include "ring_capture.h"
+
+void ring_capture_init(ring_capture_t *c, uint16_t *buf, uint32_t pre, uint32_t post, uint32_t sample_rate_hz)
+{
+    memset(c, 0, sizeof(ring_capture_t));
+    c->buf = buf;
+    c->pre = pre;
+    c->post = post;
+    c->header.magic = RING_CAPTURE_MAGIC;
+    c->header.version = RING_CAPTURE_VERSION;
+    c->header.header_len = sizeof(ring_capture_header_t);
+    c->header.sample_rate_hz = sample_rate_hz;
+}
+
+bool ring_capture_feed(ring_capture_t *c, uint16_t sample)
+{
+    switch (c->state) {
+        case RING_CAPTURE_ARMED:
+            if (c->pre == 0) {
+                return false;
+            }
+            c->buf[c->head] = sample;
+            c->head = (c->head + 1) % c->pre;
+            if (c->pre_fill < c->pre) {
+                c->pre_fill++;
+            }
+            return false;
+        case RING_CAPTURE_RECORDING:
+            c->buf[c->pre + c->post_fill] = sample;
+            if (++c->post_fill < c->post) {
+                return false;
+            }
+            c->header.samples = c->pre_fill + c->post_fill;
+            c->header.trigger = c->pre_fill;
+            c->state = RING_CAPTURE_READY;
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool ring_capture_trigger(ring_capture_t *c, uint32_t timestamp, uint32_t threshold, uint32_t baseline)
+{
+    if (c->state != RING_CAPTURE_ARMED || c->post == 0) {
+        return false;
+    }
+
+    c->post_fill = 0;
+    c->header.flags = 0;
+    c->header.timestamp = timestamp;
+    c->header.threshold = threshold;
+    c->header.baseline = baseline;
+    c->state = RING_CAPTURE_RECORDING;
+
+    return true;
+}
+
+uint32_t ring_capture_segment(const ring_capture_t *c, int idx, const uint16_t **data)
+{
+    if (c->state != RING_CAPTURE_READY) {
+        return 0;
+    }
+
+    // ring not wrapped yet: oldest sample is at 0
+    uint32_t oldest = c->pre_fill < c->pre ? 0 : c->head;
+
+    switch (idx) {
+        case 0:
+            *data = &c->buf[oldest];
+            return oldest == 0 ? c->pre_fill : c->pre - oldest;
+        case 1:
+            *data = c->buf;
+            return oldest;
+        case 2:
+            *data = &c->buf[c->pre];
+            return c->post_fill;
+        default:
+            return 0;
+    }
+}
+
+void ring_capture_release(ring_capture_t *c)
+{
+    c->head = 0;
+    c->pre_fill = 0;
+    c->post_fill = 0;
+    c->state = RING_CAPTURE_ARMED;
+}
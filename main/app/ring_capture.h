@@ -0,0 +1,87 @@
+// Pre/post-trigger capture of raw ring ADC samples.
+// Pure C, no ESP-IDF dependency; persistence lives in app_ring_capture.c.
+//
+// The buffer holds `pre + post` samples. While armed, the first `pre` slots are used as a
+// circular buffer. On trigger, the following `post` samples are appended after them and the
+// capture becomes ready until released.
+
+#ifndef ESP_MENJIN_RING_CAPTURE_H
+#define ESP_MENJIN_RING_CAPTURE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define RING_CAPTURE_MAGIC          0x50414352  // "RCAP", little endian
+#define RING_CAPTURE_VERSION        1
+
+#define RING_CAPTURE_FLAG_DETECTED  (1 << 0)    // the triggering burst sequence was reported as a ring
+#define RING_CAPTURE_FLAG_REJECTED  (1 << 1)    // the cadence filter rejected a burst of the sequence
+
+/**
+ * @brief Capture file header, followed by `samples` little endian uint16_t ADC values
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint8_t version;
+    uint8_t flags;
+    uint16_t header_len;        // sizeof(ring_capture_header_t), samples start here
+    uint32_t seq;               // capture sequence number, increases across reboots
+    uint32_t sample_rate_hz;
+    uint32_t samples;
+    uint32_t trigger;           // index of the first sample after the trigger
+    uint32_t timestamp;         // unix time of the trigger, 0 if unknown
+    uint32_t threshold;         // detector threshold at trigger
+    uint32_t baseline;          // adaptive baseline at trigger
+} ring_capture_header_t;
+
+typedef enum {
+    RING_CAPTURE_ARMED = 0,
+    RING_CAPTURE_RECORDING,
+    RING_CAPTURE_READY,
+} ring_capture_state_t;
+
+typedef struct {
+    uint16_t *buf;
+    uint32_t pre;
+    uint32_t post;
+    uint32_t head;              // next write position in the pre-trigger ring
+    uint32_t pre_fill;          // valid samples in the pre-trigger ring
+    uint32_t post_fill;
+    volatile ring_capture_state_t state;
+    ring_capture_header_t header;
+} ring_capture_t;
+
+/**
+ * @param buf storage for `pre + post` samples
+ */
+void ring_capture_init(ring_capture_t *c, uint16_t *buf, uint32_t pre, uint32_t post, uint32_t sample_rate_hz);
+
+/**
+ * @brief Feed one sample
+ *
+ * @return true when this sample completes the post-trigger part, the capture is then ready
+ */
+bool ring_capture_feed(ring_capture_t *c, uint16_t sample);
+
+/**
+ * @brief Start the post-trigger part
+ *
+ * @return false if a capture is already in progress or waiting to be released
+ */
+bool ring_capture_trigger(ring_capture_t *c, uint32_t timestamp, uint32_t threshold, uint32_t baseline);
+
+/**
+ * @brief Get the chronological segments of a ready capture
+ *
+ * @param idx segment index, 0..2, segments may be empty
+ * @return segment length in samples
+ */
+uint32_t ring_capture_segment(const ring_capture_t *c, int idx, const uint16_t **data);
+
+/**
+ * @brief Discard the ready capture and re-arm
+ */
+void ring_capture_release(ring_capture_t *c);
+
+#endif //ESP_MENJIN_RING_CAPTURE_H
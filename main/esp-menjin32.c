@@ -12,9 +12,15 @@
 #include "nvs_flash.h"
 #include "system/mqtt.h"
 #include "system/settings.h"
+#include "system/outbox.h"
+#include "system/telemetry.h"
+#include "system/lan_ctrl.h"
 #include "app_menjin.h"
+#include "menjin_ring.h"
+#include "app_macro.h"
 #include "app_keys.h"
 #include "wifi_mgr.h"
+#include "dns_server.h"
 #include "bsp.h"
 
 #define LED_PIN GPIO_NUM_15
@@ -29,6 +35,9 @@ typedef enum AppState {
 } AppState;
 
 static AppState g_app_state = APP_WAITING_WIFI;
+// 启动完成后主任务留下来，处理其他任务转交的 NVS 写入
+static TaskHandle_t g_app_task = NULL;
+static volatile uint32_t g_autotune_clock = 0;
 
 static void led_blink(int times, int interval_ms)
 {
@@ -97,6 +106,15 @@ static void menjin_ring_callback(void)
     mqtt_notify("ring");
 }
 
+// 自动调速选出的速率，在 I2C 写任务上调用，转交主任务写入设置
+static void menjin_clock_saved(uint32_t clock)
+{
+    g_autotune_clock = clock;
+    if (g_app_task != NULL) {
+        xTaskNotifyGive(g_app_task);
+    }
+}
+
 void app_main()
 {
     ESP_LOGI(TAG, "[APP] Startup..");
@@ -115,14 +133,24 @@ void app_main()
 
     ESP_ERROR_CHECK(nvs_flash_init());
     ESP_ERROR_CHECK(settings_read_parameter_from_nvs());
+    // 门铃等通知先写入发件箱，MQTT 连接后补发
+    outbox_init();
+    ESP_ERROR_CHECK(mqtt_pub_start());
 
     bsp_spiffs_mount();
 
     //start i2c task
     sys_param_t *settings = settings_get_parameter();
 
+    g_app_task = xTaskGetCurrentTaskHandle();
     if (settings->last_update_time > 0) {
-        menjin_init();
+        menjin_config_t menjin_config = {
+                .addr = settings->i2c_address,
+                .clock = settings->i2c_clock,
+                .clock_saved_cb = menjin_clock_saved,
+        };
+        menjin_init(&menjin_config);
+        app_macro_init(settings->macros);
     } else {
         ESP_LOGW(TAG, "System setting not initialized");
 
@@ -144,10 +172,35 @@ void app_main()
 
     xTaskCreate(mqtt_task, "mqtt_task", 4096, NULL, 3, NULL);
     xTaskCreate(menjin_ring_detect_task, "menjin_ring_detect_task", 2048, NULL, 2, NULL);
+    telemetry_init();
+#ifdef CONFIG_MENJIN_LAN_CTRL
+    lan_ctrl_init();
+#endif
 
     menjin_set_ring_callback(menjin_ring_callback);
 
-    // 开启mDNS后会导致MQTT无法连接，暂时禁用
-//    initialise_mdns();
+    // mDNS 组件会导致 MQTT 无法连接，改用 dns_server 内置的精简应答：<client-id>.local
+    dns_server_config_t dns_config = {
+            .num_of_entries = 0,
+            .mdns = {
+                    .hostname = mqtt_client_id(),
+                    .if_key = "WIFI_STA_DEF",
+                    .num_of_services = 1,
+                    .service = {{.type = "_http._tcp", .port = 80, .txt = "path=/"}},
+            },
+    };
+#ifdef CONFIG_MENJIN_LAN_CTRL
+    dns_config.mdns.service[dns_config.mdns.num_of_services++] =
+            (mdns_service_t) {.type = "_menjin._udp", .port = CONFIG_MENJIN_LAN_CTRL_PORT};
+#endif
+    start_dns_server(&dns_config);
 
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        settings->i2c_clock = g_autotune_clock;
+        esp_err_t ret = settings_write_parameter_to_nvs();
+        if (ret != ESP_OK) {
+            ESP_LOGE(TAG, "I2C autotune settings_write_parameter_to_nvs failed: %d", ret);
+        }
+    }
 }
\ No newline at end of file
@@ -0,0 +1,272 @@
+#include <stdbool.h>
+#include <string.h>
+#include "cmd_envelope.h"
+
+typedef enum {
+    FIELD_STR,                  // string only
+    FIELD_SCALAR,               // string or number, kept as text
+    FIELD_OP,                   // string looked up in g_ops
+} field_type_t;
+
+typedef struct {
+    const char *name;
+    field_type_t type;
+    size_t offset;
+    size_t size;
+} field_t;
+
+static const field_t g_fields[] = {
+        {"id",  FIELD_STR,    offsetof(cmd_envelope_t, id),  CMD_ENVELOPE_ID_LEN},
+        {"op",  FIELD_OP,     offsetof(cmd_envelope_t, op),  sizeof(cmd_op_t)},
+        {"arg", FIELD_SCALAR, offsetof(cmd_envelope_t, arg), CMD_ENVELOPE_ARG_LEN},
+};
+
+// 下标即 cmd_op_t
+static const char *const g_ops[CMD_OP_MAX] = {
+        [CMD_OP_NONE] = "",
+        [CMD_OP_CMD] = "cmd",
+        [CMD_OP_MACRO] = "macro",
+        [CMD_OP_HEALTH] = "health",
+        [CMD_OP_AUTOTUNE] = "autotune",
+};
+
+typedef struct {
+    const char *p;
+    const char *end;
+} cursor_t;
+
+static void skip_ws(cursor_t *c)
+{
+    while (c->p < c->end && (*c->p == ' ' || *c->p == '\t' || *c->p == '\r' || *c->p == '\n')) {
+        c->p++;
+    }
+}
+
+static bool expect(cursor_t *c, char ch)
+{
+    skip_ws(c);
+    if (c->p < c->end && *c->p == ch) {
+        c->p++;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Read a JSON string, unescaped into out, or skipped when out is NULL
+ *
+ * @return length written, -1 on syntax error, -2 if it doesn't fit
+ */
+static int read_string(cursor_t *c, char *out, size_t size)
+{
+    size_t n = 0;
+    bool overflow = false;
+
+    if (!expect(c, '"')) {
+        return -1;
+    }
+    while (c->p < c->end && *c->p != '"') {
+        char ch = *c->p++;
+        if (ch == '\\') {
+            if (c->p >= c->end) {
+                return -1;
+            }
+            ch = *c->p++;
+            switch (ch) {
+                case '"':
+                case '\\':
+                case '/':
+                    break;
+                case 'n':
+                    ch = '\n';
+                    break;
+                case 't':
+                    ch = '\t';
+                    break;
+                default:
+                    // \uXXXX 等不会出现在命令里
+                    return -1;
+            }
+        }
+        if (out != NULL) {
+            if (n + 1 < size) {
+                out[n] = ch;
+            } else {
+                overflow = true;
+            }
+        }
+        n++;
+    }
+    if (c->p >= c->end) {
+        return -1;
+    }
+    c->p++;
+
+    if (out != NULL) {
+        out[overflow ? 0 : n] = '\0';
+    }
+
+    return overflow ? -2 : (int) n;
+}
+
+/**
+ * @brief Read a bare token: number, true, false or null
+ */
+static int read_token(cursor_t *c, char *out, size_t size)
+{
+    skip_ws(c);
+    const char *start = c->p;
+    while (c->p < c->end && (*c->p == '-' || *c->p == '+' || *c->p == '.'
+                             || (*c->p >= '0' && *c->p <= '9') || (*c->p >= 'a' && *c->p <= 'z'))) {
+        c->p++;
+    }
+
+    size_t n = c->p - start;
+    if (n == 0) {
+        return -1;
+    }
+    if (out != NULL) {
+        if (n >= size) {
+            return -2;
+        }
+        memcpy(out, start, n);
+        out[n] = '\0';
+    }
+
+    return (int) n;
+}
+
+static const field_t *find_field(const char *name)
+{
+    for (size_t i = 0; i < sizeof(g_fields) / sizeof(g_fields[0]); ++i) {
+        if (strcmp(g_fields[i].name, name) == 0) {
+            return &g_fields[i];
+        }
+    }
+    return NULL;
+}
+
+static cmd_op_t find_op(const char *name)
+{
+    for (int i = CMD_OP_NONE + 1; i < CMD_OP_MAX; ++i) {
+        if (strcmp(g_ops[i], name) == 0) {
+            return i;
+        }
+    }
+    return CMD_OP_NONE;
+}
+
+static cmd_envelope_result_t parse_json(cursor_t *c, cmd_envelope_t *env)
+{
+    cmd_envelope_result_t result = CMD_ENVELOPE_OK;
+    char key[8];
+    char op[16];
+
+    if (!expect(c, '{')) {
+        return CMD_ENVELOPE_ERR_SYNTAX;
+    }
+    if (expect(c, '}')) {
+        return CMD_ENVELOPE_ERR_OP;
+    }
+
+    do {
+        int n = read_string(c, key, sizeof(key));
+        if (n == -1 || !expect(c, ':')) {
+            return CMD_ENVELOPE_ERR_SYNTAX;
+        }
+        // 过长的键不会在表里
+        const field_t *field = n >= 0 ? find_field(key) : NULL;
+
+        skip_ws(c);
+        bool is_string = c->p < c->end && *c->p == '"';
+        if (field == NULL) {
+            n = is_string ? read_string(c, NULL, 0) : read_token(c, NULL, 0);
+        } else if (field->type == FIELD_OP) {
+            n = is_string ? read_string(c, op, sizeof(op)) : read_token(c, NULL, 0);
+            if (n >= 0) {
+                env->op = is_string ? find_op(op) : CMD_OP_NONE;
+            }
+        } else {
+            char *out = (char *) env + field->offset;
+            if (is_string) {
+                n = read_string(c, out, field->size);
+            } else {
+                n = read_token(c, out, field->size);
+                if (n >= 0 && field->type == FIELD_STR) {
+                    out[0] = '\0';
+                    result = CMD_ENVELOPE_ERR_FIELD;
+                }
+            }
+        }
+        if (n == -1) {
+            return CMD_ENVELOPE_ERR_SYNTAX;
+        }
+        if (n == -2) {
+            result = CMD_ENVELOPE_ERR_FIELD;
+        }
+    } while (expect(c, ','));
+
+    if (!expect(c, '}')) {
+        return CMD_ENVELOPE_ERR_SYNTAX;
+    }
+    skip_ws(c);
+    if (c->p != c->end) {
+        return CMD_ENVELOPE_ERR_SYNTAX;
+    }
+
+    return result;
+}
+
+static cmd_envelope_result_t parse_binary(const uint8_t *p, size_t len, cmd_envelope_t *env)
+{
+    // magic, op, id_len
+    if (len < 3) {
+        return CMD_ENVELOPE_ERR_SYNTAX;
+    }
+    uint8_t op = p[1];
+    size_t id_len = p[2];
+    if (3 + id_len + 1 > len) {
+        return CMD_ENVELOPE_ERR_SYNTAX;
+    }
+    size_t arg_len = p[3 + id_len];
+    if (3 + id_len + 1 + arg_len != len) {
+        return CMD_ENVELOPE_ERR_SYNTAX;
+    }
+    if (id_len >= CMD_ENVELOPE_ID_LEN || arg_len >= CMD_ENVELOPE_ARG_LEN) {
+        return CMD_ENVELOPE_ERR_FIELD;
+    }
+
+    memcpy(env->id, p + 3, id_len);
+    memcpy(env->arg, p + 3 + id_len + 1, arg_len);
+    env->op = op < CMD_OP_MAX ? op : CMD_OP_NONE;
+
+    return CMD_ENVELOPE_OK;
+}
+
+cmd_envelope_result_t cmd_envelope_parse(const char *data, size_t len, cmd_envelope_t *env)
+{
+    memset(env, 0, sizeof(cmd_envelope_t));
+
+    cursor_t c = {.p = data, .end = data + len};
+    skip_ws(&c);
+
+    cmd_envelope_result_t result;
+    if (len > 0 && (uint8_t) data[0] == CMD_ENVELOPE_MAGIC) {
+        result = parse_binary((const uint8_t *) data, len, env);
+    } else if (c.p < c.end && *c.p == '{') {
+        result = parse_json(&c, env);
+    } else {
+        return CMD_ENVELOPE_LEGACY;
+    }
+
+    if (result == CMD_ENVELOPE_OK && env->op == CMD_OP_NONE) {
+        result = CMD_ENVELOPE_ERR_OP;
+    }
+
+    return result;
+}
+
+const char *cmd_op_name(cmd_op_t op)
+{
+    return op < CMD_OP_MAX ? g_ops[op] : "";
+}
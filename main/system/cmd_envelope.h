@@ -0,0 +1,54 @@
+// Command envelope of the MQTT cmd topic, replies go to menjin/<id>/resp.
+// Pure C, no allocation: the parser walks the payload once and fills a fixed struct.
+//
+// JSON form, a flat object, unknown keys are ignored:
+//     {"id":"r42","op":"cmd","arg":97}
+//     {"id":"r43","op":"macro","arg":"open"}
+// Binary form:
+//     0xA5 | op | id_len | id[id_len] | arg_len | arg[arg_len]
+//
+// Payloads starting with neither '{' nor 0xA5 are legacy text commands ("open", "cmd 97").
+
+#ifndef ESP_MENJIN_CMD_ENVELOPE_H
+#define ESP_MENJIN_CMD_ENVELOPE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CMD_ENVELOPE_MAGIC      0xA5
+#define CMD_ENVELOPE_ID_LEN     24      // including '\0'
+#define CMD_ENVELOPE_ARG_LEN    24
+
+typedef enum {
+    CMD_OP_NONE = 0,
+    CMD_OP_CMD,                 // arg: controller command, e.g. 97
+    CMD_OP_MACRO,               // arg: macro name
+    CMD_OP_HEALTH,
+    CMD_OP_AUTOTUNE,
+    CMD_OP_MAX,
+} cmd_op_t;
+
+typedef enum {
+    CMD_ENVELOPE_OK = 0,
+    CMD_ENVELOPE_LEGACY,        // not an envelope
+    CMD_ENVELOPE_ERR_SYNTAX,
+    CMD_ENVELOPE_ERR_FIELD,     // value too long or of the wrong type
+    CMD_ENVELOPE_ERR_OP,        // missing or unknown op
+} cmd_envelope_result_t;
+
+typedef struct {
+    char id[CMD_ENVELOPE_ID_LEN];
+    cmd_op_t op;
+    char arg[CMD_ENVELOPE_ARG_LEN];     // numbers are kept as text
+} cmd_envelope_t;
+
+/**
+ * @brief Parse a JSON or binary envelope
+ *
+ * On error env->id is still filled if it was parsed, so the reply can carry it.
+ */
+cmd_envelope_result_t cmd_envelope_parse(const char *data, size_t len, cmd_envelope_t *env);
+
+const char *cmd_op_name(cmd_op_t op);
+
+#endif //ESP_MENJIN_CMD_ENVELOPE_H
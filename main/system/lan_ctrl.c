@@ -0,0 +1,282 @@
+#include "sdkconfig.h"
+
+#ifdef CONFIG_MENJIN_LAN_CTRL
+
+#include <stdlib.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "mbedtls/md.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "nvs.h"
+#include "cmd_envelope.h"
+#include "mqtt.h"
+#include "lan_frame.h"
+#include "lan_ctrl.h"
+
+static const char *TAG = "LAN_CTRL";
+
+#define NAME_SPACE              "lan_ctrl"
+#define KEY_FLOOR               "floor"
+
+#define LAN_CTRL_TASK_PRIO      6
+// 同时等待执行结果的命令数，与 MQTT 命令槽位数相同
+#define LAN_CTRL_PENDING        4
+#define LAN_CTRL_KEY_MAX        64
+// 计数器每前进这么多才写一次 NVS；客户端以微秒时间作计数器时约 10 分钟一次
+#define LAN_CTRL_COUNTER_RESERVE    (600ULL * 1000 * 1000)
+
+typedef struct {
+    bool in_use;
+    struct sockaddr_in peer;
+    uint64_t counter;
+} lan_ctrl_pending_t;
+
+static int g_sock = -1;
+static uint8_t g_key[LAN_CTRL_KEY_MAX];
+static size_t g_key_len = 0;
+// 接收任务和命令 worker 各用一个 HMAC 上下文，互不加锁；SHA 由硬件加速
+static mbedtls_md_context_t g_rx_md;
+static mbedtls_md_context_t g_tx_md;
+static nvs_handle_t g_nvs = 0;
+static lan_replay_t g_replay;
+static lan_ctrl_pending_t g_pending[LAN_CTRL_PENDING];
+static lan_ctrl_stats_t g_stats = {0};
+static portMUX_TYPE g_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void lan_ctrl_get_stats(lan_ctrl_stats_t *stats)
+{
+    taskENTER_CRITICAL(&g_lock);
+    *stats = g_stats;
+    taskEXIT_CRITICAL(&g_lock);
+}
+
+static void lan_ctrl_tag(mbedtls_md_context_t *md, const uint8_t *data, size_t len, uint8_t *tag)
+{
+    uint8_t mac[32];
+
+    mbedtls_md_hmac_reset(md);
+    mbedtls_md_hmac_update(md, data, len);
+    mbedtls_md_hmac_finish(md, mac);
+    memcpy(tag, mac, LAN_FRAME_TAG_LEN);
+}
+
+static void lan_ctrl_send(mbedtls_md_context_t *md, const struct sockaddr_in *peer, uint8_t type, uint64_t counter,
+                          const lan_reply_t *reply)
+{
+    uint8_t buf[LAN_FRAME_REPLY_LEN + LAN_FRAME_TAG_LEN];
+
+    size_t len = lan_frame_reply(buf, type, counter, reply);
+    lan_ctrl_tag(md, buf, len, buf + len);
+
+    // UDP 可以一个任务接收、另一个任务发送
+    if (sendto(g_sock, buf, sizeof(buf), 0, (const struct sockaddr *) peer, sizeof(*peer)) < 0) {
+        ESP_LOGW(TAG, "sendto failed: errno %d", errno);
+    }
+}
+
+static void lan_ctrl_count(uint32_t *counter)
+{
+    taskENTER_CRITICAL(&g_lock);
+    (*counter)++;
+    taskEXIT_CRITICAL(&g_lock);
+}
+
+static lan_ctrl_pending_t *lan_ctrl_pending_alloc(void)
+{
+    lan_ctrl_pending_t *pending = NULL;
+
+    taskENTER_CRITICAL(&g_lock);
+    for (int i = 0; i < LAN_CTRL_PENDING && pending == NULL; ++i) {
+        if (!g_pending[i].in_use) {
+            pending = &g_pending[i];
+            pending->in_use = true;
+        }
+    }
+    taskEXIT_CRITICAL(&g_lock);
+
+    return pending;
+}
+
+static void lan_ctrl_pending_free(lan_ctrl_pending_t *pending)
+{
+    taskENTER_CRITICAL(&g_lock);
+    pending->in_use = false;
+    taskEXIT_CRITICAL(&g_lock);
+}
+
+// 命令 worker 执行完成后回调
+static void lan_ctrl_reply_cb(const cmd_envelope_t *env, const mqtt_cmd_reply_t *result, void *arg)
+{
+    lan_ctrl_pending_t *pending = arg;
+    lan_reply_t reply = {
+            .status = result->ret == ESP_OK ? LAN_STATUS_OK : LAN_STATUS_ERROR,
+            .op = env->op,
+            .ret = result->ret,
+            .time_us = result->total_us,
+            .bus_us = result->bus_us,
+    };
+
+    lan_ctrl_send(&g_tx_md, &pending->peer, LAN_FRAME_DONE, pending->counter, &reply);
+    lan_ctrl_pending_free(pending);
+}
+
+static void lan_ctrl_ack(const struct sockaddr_in *peer, uint64_t counter, lan_reply_t *reply, int64_t rx_us)
+{
+    reply->time_us = esp_timer_get_time() - rx_us;
+    lan_ctrl_send(&g_rx_md, peer, LAN_FRAME_ACK, counter, reply);
+
+    taskENTER_CRITICAL(&g_lock);
+    g_stats.last_ack_us = reply->time_us;
+    if (reply->time_us > g_stats.max_ack_us) {
+        g_stats.max_ack_us = reply->time_us;
+    }
+    // EWMA, 1/8
+    if (g_stats.avg_ack_us == 0) {
+        g_stats.avg_ack_us = reply->time_us;
+    } else {
+        g_stats.avg_ack_us += ((int32_t) reply->time_us - (int32_t) g_stats.avg_ack_us) / 8;
+    }
+    taskEXIT_CRITICAL(&g_lock);
+}
+
+static void lan_ctrl_handle(const uint8_t *buf, size_t len, const struct sockaddr_in *peer, int64_t rx_us)
+{
+    lan_frame_t frame;
+    uint8_t tag[LAN_FRAME_TAG_LEN];
+
+    lan_ctrl_count(&g_stats.received);
+
+    if (lan_frame_parse(buf, len, &frame) != LAN_FRAME_PARSE_OK) {
+        lan_ctrl_count(&g_stats.malformed);
+        return;
+    }
+    lan_ctrl_tag(&g_rx_md, buf, frame.signed_len, tag);
+    if (!lan_frame_tag_equal(tag, frame.tag)) {
+        lan_ctrl_count(&g_stats.bad_auth);
+        ESP_LOGW(TAG, "bad tag from %s", inet_ntoa(peer->sin_addr));
+        return;
+    }
+
+    lan_reply_t reply = {.status = LAN_STATUS_OK};
+    uint64_t saved_limit = g_replay.limit;
+    bool persist;
+    if (!lan_replay_accept(&g_replay, frame.counter, &persist)) {
+        lan_ctrl_count(&g_stats.replay);
+        reply.status = LAN_STATUS_REPLAY;
+        reply.floor = g_replay.last;
+        lan_ctrl_ack(peer, frame.counter, &reply, rx_us);
+        return;
+    }
+
+    cmd_envelope_t env;
+    cmd_envelope_result_t result = cmd_envelope_parse((const char *) frame.payload, frame.payload_len, &env);
+    reply.op = env.op;
+    lan_ctrl_pending_t *pending = NULL;
+    // 新的下限必须在执行命令之前落盘，否则此时重启，同一帧还能再开一次门
+    if (persist && g_nvs != 0
+        && (nvs_set_u64(g_nvs, KEY_FLOOR, g_replay.limit) != ESP_OK || nvs_commit(g_nvs) != ESP_OK)) {
+        ESP_LOGW(TAG, "failed to save counter floor, command rejected");
+        // 下一帧重新尝试保存
+        g_replay.limit = saved_limit;
+        reply.status = LAN_STATUS_ERROR;
+        reply.ret = ESP_FAIL;
+    } else if (result != CMD_ENVELOPE_OK) {
+        reply.status = LAN_STATUS_BAD_REQUEST;
+        reply.ret = result == CMD_ENVELOPE_ERR_OP ? ESP_ERR_NOT_SUPPORTED : ESP_ERR_INVALID_ARG;
+    } else if ((pending = lan_ctrl_pending_alloc()) == NULL) {
+        reply.status = LAN_STATUS_BUSY;
+        reply.ret = ESP_ERR_NO_MEM;
+    } else {
+        pending->peer = *peer;
+        pending->counter = frame.counter;
+        reply.ret = mqtt_cmd_submit((const char *) frame.payload, frame.payload_len, rx_us, lan_ctrl_reply_cb, pending);
+        if (reply.ret != ESP_OK) {
+            lan_ctrl_pending_free(pending);
+            reply.status = reply.ret == ESP_ERR_NO_MEM ? LAN_STATUS_BUSY : LAN_STATUS_ERROR;
+        }
+    }
+
+    lan_ctrl_count(reply.status == LAN_STATUS_OK ? &g_stats.accepted : &g_stats.rejected);
+    lan_ctrl_ack(peer, frame.counter, &reply, rx_us);
+}
+
+_Noreturn static void lan_ctrl_task(void *param)
+{
+    uint8_t buf[LAN_FRAME_MAX];
+    struct sockaddr_in peer;
+    socklen_t peer_len;
+
+    while (1) {
+        peer_len = sizeof(peer);
+        int len = recvfrom(g_sock, buf, sizeof(buf), 0, (struct sockaddr *) &peer, &peer_len);
+        if (len < 0) {
+            ESP_LOGW(TAG, "recvfrom failed: errno %d", errno);
+            vTaskDelay(pdMS_TO_TICKS(100));
+            continue;
+        }
+        lan_ctrl_handle(buf, len, &peer, esp_timer_get_time());
+    }
+}
+
+static esp_err_t lan_ctrl_md_init(mbedtls_md_context_t *md)
+{
+    mbedtls_md_init(md);
+    if (mbedtls_md_setup(md, mbedtls_md_info_from_type(MBEDTLS_MD_SHA256), 1) != 0
+        || mbedtls_md_hmac_starts(md, g_key, g_key_len) != 0) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t lan_ctrl_init(void)
+{
+    const char *hex = CONFIG_MENJIN_LAN_CTRL_KEY;
+    size_t hex_len = strlen(hex);
+    ESP_RETURN_ON_FALSE(hex_len >= 32 && hex_len % 2 == 0 && hex_len / 2 <= LAN_CTRL_KEY_MAX, ESP_ERR_INVALID_ARG,
+                        TAG, "LAN control key must be 16..64 bytes of hex, disabled");
+    for (g_key_len = 0; g_key_len < hex_len / 2; ++g_key_len) {
+        char byte[3] = {hex[g_key_len * 2], hex[g_key_len * 2 + 1], '\0'};
+        g_key[g_key_len] = strtoul(byte, NULL, 16);
+    }
+
+    ESP_RETURN_ON_ERROR(lan_ctrl_md_init(&g_rx_md), TAG, "HMAC setup failed");
+    ESP_RETURN_ON_ERROR(lan_ctrl_md_init(&g_tx_md), TAG, "HMAC setup failed");
+
+    // 计数器下限跨重启保存，重启前截获的帧不能重放
+    uint64_t floor = 0;
+    if (nvs_open(NAME_SPACE, NVS_READWRITE, &g_nvs) == ESP_OK) {
+        nvs_get_u64(g_nvs, KEY_FLOOR, &floor);
+    } else {
+        ESP_LOGW(TAG, "nvs open failed, counter floor not persisted");
+    }
+    lan_replay_init(&g_replay, floor, LAN_CTRL_COUNTER_RESERVE);
+
+    g_sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_IP);
+    ESP_RETURN_ON_FALSE(g_sock >= 0, ESP_FAIL, TAG, "socket failed: errno %d", errno);
+
+    struct sockaddr_in addr = {
+            .sin_family = AF_INET,
+            .sin_port = htons(CONFIG_MENJIN_LAN_CTRL_PORT),
+            .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    if (bind(g_sock, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        ESP_LOGE(TAG, "bind port %d failed: errno %d", CONFIG_MENJIN_LAN_CTRL_PORT, errno);
+        close(g_sock);
+        g_sock = -1;
+        return ESP_FAIL;
+    }
+
+    ESP_RETURN_ON_FALSE(xTaskCreate(lan_ctrl_task, "lan_ctrl_task", 3072, NULL, LAN_CTRL_TASK_PRIO, NULL) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "No memory for LAN control task");
+
+    ESP_LOGI(TAG, "LAN control listening on udp/%d, counter floor %llu", CONFIG_MENJIN_LAN_CTRL_PORT, floor);
+
+    return ESP_OK;
+}
+
+#endif // CONFIG_MENJIN_LAN_CTRL
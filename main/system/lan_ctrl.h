@@ -0,0 +1,30 @@
+// LAN control channel: authenticated command frames over UDP (see lan_frame.h), executed by the
+// MQTT command worker like commands from the cmd topic, without a round trip through the broker.
+// Every valid command gets an ACK right away and a DONE once it has run. Frames with a bad tag
+// are dropped without an answer.
+
+#ifndef ESP_MENJIN_LAN_CTRL_H
+#define ESP_MENJIN_LAN_CTRL_H
+
+#include <stdint.h>
+#include "esp_err.h"
+
+typedef struct {
+    uint32_t received;
+    uint32_t accepted;                      // handed to the command worker
+    uint32_t malformed;                     // not a frame of this protocol
+    uint32_t bad_auth;                      // tag mismatch
+    uint32_t replay;                        // counter not above the last accepted one
+    uint32_t rejected;                      // bad envelope or command slots full
+    uint32_t last_ack_us;                   // receive -> ACK sent
+    uint32_t max_ack_us;
+    uint32_t avg_ack_us;
+} lan_ctrl_stats_t;
+
+/**
+ * @brief Start the UDP listener on CONFIG_MENJIN_LAN_CTRL_PORT
+ */
+esp_err_t lan_ctrl_init(void);
+void lan_ctrl_get_stats(lan_ctrl_stats_t *stats);
+
+#endif //ESP_MENJIN_LAN_CTRL_H
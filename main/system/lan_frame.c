@@ -0,0 +1,109 @@
+#include <string.h>
+#include "lan_frame.h"
+
+static const uint8_t g_magic[2] = {'M', 'J'};
+
+static uint64_t get_u64(const uint8_t *p)
+{
+    uint64_t value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value = value << 8 | p[i];
+    }
+
+    return value;
+}
+
+static uint8_t *put_u32(uint8_t *p, uint32_t value)
+{
+    for (int i = 3; i >= 0; --i) {
+        *p++ = value >> (i * 8);
+    }
+
+    return p;
+}
+
+static uint8_t *put_u64(uint8_t *p, uint64_t value)
+{
+    p = put_u32(p, value >> 32);
+
+    return put_u32(p, value);
+}
+
+static uint8_t *put_header(uint8_t *p, uint8_t type, uint64_t counter)
+{
+    *p++ = g_magic[0];
+    *p++ = g_magic[1];
+    *p++ = LAN_FRAME_VERSION;
+    *p++ = type;
+
+    return put_u64(p, counter);
+}
+
+lan_frame_parse_t lan_frame_parse(const uint8_t *buf, size_t len, lan_frame_t *frame)
+{
+    if (len < LAN_FRAME_HEADER_LEN + LAN_FRAME_TAG_LEN) {
+        return LAN_FRAME_PARSE_SHORT;
+    }
+    if (memcmp(buf, g_magic, sizeof(g_magic)) != 0 || buf[2] != LAN_FRAME_VERSION) {
+        return LAN_FRAME_PARSE_MAGIC;
+    }
+    if (buf[3] != LAN_FRAME_CMD) {
+        return LAN_FRAME_PARSE_TYPE;
+    }
+
+    frame->type = buf[3];
+    frame->counter = get_u64(buf + 4);
+    frame->payload = buf + LAN_FRAME_HEADER_LEN;
+    frame->signed_len = len - LAN_FRAME_TAG_LEN;
+    frame->payload_len = frame->signed_len - LAN_FRAME_HEADER_LEN;
+    frame->tag = buf + frame->signed_len;
+
+    return LAN_FRAME_PARSE_OK;
+}
+
+size_t lan_frame_reply(uint8_t *buf, uint8_t type, uint64_t counter, const lan_reply_t *reply)
+{
+    uint8_t *p = put_header(buf, type, counter);
+    *p++ = reply->status;
+    *p++ = reply->op;
+    p = put_u32(p, (uint32_t) reply->ret);
+    p = put_u32(p, reply->time_us);
+    p = put_u32(p, reply->bus_us);
+    p = put_u64(p, reply->floor);
+
+    return p - buf;
+}
+
+bool lan_frame_tag_equal(const uint8_t *a, const uint8_t *b)
+{
+    uint8_t diff = 0;
+    for (int i = 0; i < LAN_FRAME_TAG_LEN; ++i) {
+        diff |= a[i] ^ b[i];
+    }
+
+    return diff == 0;
+}
+
+void lan_replay_init(lan_replay_t *replay, uint64_t floor, uint64_t reserve)
+{
+    replay->last = floor;
+    replay->limit = floor;
+    replay->reserve = reserve;
+}
+
+bool lan_replay_accept(lan_replay_t *replay, uint64_t counter, bool *persist)
+{
+    *persist = false;
+    if (counter <= replay->last) {
+        return false;
+    }
+
+    replay->last = counter;
+    // 重启后从 limit 开始，保证不低于任何已接受的计数；每前进 reserve 才写一次 NVS
+    if (counter > replay->limit) {
+        replay->limit = counter + replay->reserve < counter ? UINT64_MAX : counter + replay->reserve;
+        *persist = true;
+    }
+
+    return true;
+}
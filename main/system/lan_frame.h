@@ -0,0 +1,99 @@
+// Binary frames of the LAN control channel (UDP), all integers big-endian.
+//
+//     header  'M' 'J' | version | type | counter (u64)
+//     command header | envelope (binary form, see cmd_envelope.h)                  | tag
+//     reply   header | status | op | ret (i32) | time_us (u32) | bus_us (u32) | floor (u64) | tag
+//
+// tag is HMAC-SHA256 over everything before it, truncated to LAN_FRAME_TAG_LEN bytes. The counter
+// of a command must be larger than any counter accepted before; replies echo it. Pure C, the HMAC
+// itself is computed by the caller.
+
+#ifndef ESP_MENJIN_LAN_FRAME_H
+#define ESP_MENJIN_LAN_FRAME_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define LAN_FRAME_VERSION       1
+#define LAN_FRAME_HEADER_LEN    12
+#define LAN_FRAME_REPLY_LEN     (LAN_FRAME_HEADER_LEN + 22)     // without the tag
+#define LAN_FRAME_TAG_LEN       16
+#define LAN_FRAME_MAX           128
+
+typedef enum {
+    LAN_FRAME_CMD = 0x01,
+    LAN_FRAME_ACK = 0x81,       // command accepted or rejected, sent as soon as it is parsed
+    LAN_FRAME_DONE = 0x82,      // command executed, same fields as the MQTT reply
+} lan_frame_type_t;
+
+typedef enum {
+    LAN_STATUS_OK = 0,
+    LAN_STATUS_BUSY,            // all command slots in use, retry later
+    LAN_STATUS_BAD_REQUEST,     // envelope malformed or unknown op
+    LAN_STATUS_REPLAY,          // counter not above floor, resend with a larger one
+    LAN_STATUS_ERROR,           // executed and failed, see ret
+} lan_status_t;
+
+typedef enum {
+    LAN_FRAME_PARSE_OK = 0,
+    LAN_FRAME_PARSE_SHORT,
+    LAN_FRAME_PARSE_MAGIC,      // not ours, or another protocol version
+    LAN_FRAME_PARSE_TYPE,
+} lan_frame_parse_t;
+
+typedef struct {
+    uint8_t type;
+    uint64_t counter;
+    const uint8_t *payload;
+    size_t payload_len;
+    const uint8_t *tag;
+    size_t signed_len;          // bytes covered by the tag
+} lan_frame_t;
+
+typedef struct {
+    uint8_t status;
+    uint8_t op;
+    int32_t ret;
+    uint32_t time_us;           // ACK: receive -> ack; DONE: receive -> bus write done
+    uint32_t bus_us;
+    uint64_t floor;             // REPLAY: counters up to this value are rejected
+} lan_reply_t;
+
+/**
+ * @brief Split a received command frame, the tag is not checked here
+ */
+lan_frame_parse_t lan_frame_parse(const uint8_t *buf, size_t len, lan_frame_t *frame);
+
+/**
+ * @brief Write a reply without its tag
+ *
+ * @param buf at least LAN_FRAME_REPLY_LEN + LAN_FRAME_TAG_LEN bytes, the tag goes right after the reply
+ * @return LAN_FRAME_REPLY_LEN
+ */
+size_t lan_frame_reply(uint8_t *buf, uint8_t type, uint64_t counter, const lan_reply_t *reply);
+
+/**
+ * @brief Compare tags in constant time
+ */
+bool lan_frame_tag_equal(const uint8_t *a, const uint8_t *b);
+
+typedef struct {
+    uint64_t last;              // highest accepted counter
+    uint64_t limit;             // persisted floor, restored as `last` after a reboot
+    uint64_t reserve;           // how far `limit` is moved ahead of `last` at a time
+} lan_replay_t;
+
+/**
+ * @param floor persisted limit from the previous boot, 0 on first use
+ */
+void lan_replay_init(lan_replay_t *replay, uint64_t floor, uint64_t reserve);
+
+/**
+ * @brief Accept a counter if it is above every counter accepted so far
+ *
+ * @param persist set when `limit` moved and must be saved before the next reboot
+ */
+bool lan_replay_accept(lan_replay_t *replay, uint64_t counter, bool *persist);
+
+#endif //ESP_MENJIN_LAN_FRAME_H
@@ -3,6 +3,7 @@
 //
 #include <stdio.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include <esp_tls.h>
 #include <esp_mac.h>
@@ -12,25 +13,250 @@
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_timer.h"
 
 #include "esp_log.h"
 #include "mqtt_client.h"
 #include "settings.h"
 #include "app_menjin.h"
+#include "app_macro.h"
 #include "mqtt.h"
+#include "outbox.h"
+#include "cmd_envelope.h"
+#include "mqtt_tls.h"
+#include "pub_ring.h"
 #include "wifi_mgr.h"
+#include "json_writer.h"
 
 #define MQTT_TOPIC_PREFIX "menjin/"
 
+// 命令分发：事件任务只拷贝到固定槽位，由 worker 执行
+#define MQTT_CMD_SLOTS          4
+#define MQTT_CMD_DATA_MAX       64
+#define MQTT_CMD_WORKER_PRIO    5
+// 等待门禁命令写入完成后再回复
+#define MQTT_CMD_DONE_TIMEOUT_MS    2000
+// 发布任务（发件箱 + 各发送通道）：高于 esp-mqtt 任务（5），入队后先记录 msg_id 再让出 CPU
+#define MQTT_PUB_TASK_PRIO      6
+#define MQTT_OUTBOX_ACK_TIMEOUT_MS  (10 * 1000)
+// 发送通道容量（2 的幂）和单条消息上限
+#define MQTT_PUB_EVENT_SLOTS    8
+#define MQTT_PUB_REPLY_SLOTS    4
+#define MQTT_PUB_REPLY_MAX      384
+#define MQTT_PUB_BULK_SLOTS     4
+#define MQTT_PUB_BULK_MAX       768
+
 static const char *TAG = "MQTT";
 
 static esp_mqtt_client_handle_t g_client;
 static char g_topic_cmd[64];
 static char g_topic_notify[64];
+static char g_topic_resp[64];
+static char g_topic_telemetry[64];
+
+// 重连耗时，online 消息中上报
+static int64_t g_connect_start_us = 0;
+static int64_t g_connected_us = 0;
+static bool g_session_present = false;
+static bool g_tls_transport = false;
+static int g_subscribe_msg_id = -1;
+
+typedef struct {
+    int64_t rx_us;
+    int len;
+    char data[MQTT_CMD_DATA_MAX];
+    mqtt_cmd_reply_cb_t reply_cb;           // NULL: reply on the resp topic
+    void *reply_arg;
+} mqtt_cmd_slot_t;
+
+static mqtt_cmd_slot_t g_cmd_slots[MQTT_CMD_SLOTS];
+static QueueHandle_t g_cmd_free = NULL;     // free slot indexes
+static QueueHandle_t g_cmd_ready = NULL;    // slot indexes waiting for the worker
+static mqtt_dispatch_stats_t g_dispatch_stats = {0};
+static portMUX_TYPE g_dispatch_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// worker 等待的门禁命令结果，由写任务的完成回调填写，g_dispatch_stats_lock 保护
+typedef struct {
+    uint32_t gen;                           // 超时后递增，迟到的回调被忽略
+    bool done;
+    esp_err_t i2c_ret;
+    uint32_t bus_us;
+    int64_t done_us;
+} mqtt_cmd_result_t;
+
+static TaskHandle_t g_cmd_worker = NULL;
+static mqtt_cmd_result_t g_cmd_result = {0};
+
+// 正在等待 PUBACK 的一批发件箱条目，事件任务只在临界区内修改，不做阻塞操作
+typedef struct {
+    bool connected;
+    uint8_t count;
+    uint8_t acked;
+    int msg_ids[CONFIG_MENJIN_OUTBOX_BATCH];
+    uint32_t last_seq;
+    TickType_t sent_at;
+} mqtt_outbox_batch_t;
+
+static TaskHandle_t g_pub_task = NULL;
+static mqtt_outbox_batch_t g_outbox_batch = {0};
+static portMUX_TYPE g_outbox_lock = portMUX_INITIALIZER_UNLOCKED;
+
+typedef enum {
+    MQTT_TOPIC_NOTIFY = 0,
+    MQTT_TOPIC_RESP,
+    MQTT_TOPIC_TELEMETRY,
+    MQTT_TOPIC_HEALTH,                      // published on the notify topic, coalesced apart from other notices
+} mqtt_topic_t;
+
+// 生产者只写无锁环形缓冲区并唤醒发布任务，从不等待 esp-mqtt 的 API 锁
+static uint8_t g_pub_event_buf[MQTT_PUB_EVENT_SLOTS * PUB_RING_SLOT_SIZE(OUTBOX_DATA_MAX)];
+static uint8_t g_pub_reply_buf[MQTT_PUB_REPLY_SLOTS * PUB_RING_SLOT_SIZE(MQTT_PUB_REPLY_MAX)];
+static uint8_t g_pub_bulk_buf[MQTT_PUB_BULK_SLOTS * PUB_RING_SLOT_SIZE(MQTT_PUB_BULK_MAX)];
+static pub_ring_t g_pub_rings[MQTT_PUB_LANE_MAX];
+static volatile bool g_pub_ready = false;
+static mqtt_pub_stats_t g_pub_stats[MQTT_PUB_LANE_MAX] = {0};
+static portMUX_TYPE g_pub_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// 事件写入发件箱时的时间，按 seq 查找，用于统计到发出的延迟；重启前的条目没有记录
+typedef struct {
+    uint32_t seq;
+    uint32_t time_us;
+    bool valid;
+} mqtt_event_time_t;
+
+static mqtt_event_time_t g_event_times[CONFIG_MENJIN_OUTBOX_LEN];
 
 extern const uint8_t server_root_cert_pem_start[] asm("_binary_server_root_cert_pem_start");
 extern const uint8_t server_root_cert_pem_end[]   asm("_binary_server_root_cert_pem_end");
 
+static void mqtt_pub_kick(void)
+{
+    if (g_pub_task != NULL) {
+        xTaskNotifyGive(g_pub_task);
+    }
+}
+
+/**
+ * @brief Queue a message on a publish lane and wake the publish task, never blocks
+ *
+ * @return
+ *     - ESP_ERR_INVALID_STATE publish task not started
+ *     - ESP_ERR_NO_MEM lane full or message longer than a slot, message dropped
+ */
+static esp_err_t mqtt_pub_push(mqtt_pub_lane_t lane, mqtt_topic_t topic, int qos, const char *data, size_t len)
+{
+    if (!g_pub_ready) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    bool queued = pub_ring_push(&g_pub_rings[lane], topic, qos, esp_timer_get_time(), data, len);
+    uint32_t depth = pub_ring_depth(&g_pub_rings[lane]);
+
+    taskENTER_CRITICAL(&g_pub_stats_lock);
+    if (queued) {
+        g_pub_stats[lane].pushed++;
+        if (depth > g_pub_stats[lane].max_depth) {
+            g_pub_stats[lane].max_depth = depth;
+        }
+    } else {
+        g_pub_stats[lane].dropped++;
+    }
+    taskEXIT_CRITICAL(&g_pub_stats_lock);
+
+    if (!queued) {
+        ESP_LOGW(TAG, "publish lane %d full, drop %d bytes", lane, len);
+        return ESP_ERR_NO_MEM;
+    }
+
+    mqtt_pub_kick();
+
+    return ESP_OK;
+}
+
+// 生产者 -> esp_mqtt_client_enqueue 的延迟
+static void mqtt_pub_sent(mqtt_pub_lane_t lane, uint32_t time_us)
+{
+    uint32_t latency_us = (uint32_t) esp_timer_get_time() - time_us;
+
+    taskENTER_CRITICAL(&g_pub_stats_lock);
+    mqtt_pub_stats_t *stats = &g_pub_stats[lane];
+    stats->sent++;
+    stats->last_latency_us = latency_us;
+    if (latency_us > stats->max_latency_us) {
+        stats->max_latency_us = latency_us;
+    }
+    // EWMA, 1/8
+    if (stats->avg_latency_us == 0) {
+        stats->avg_latency_us = latency_us;
+    } else {
+        stats->avg_latency_us += ((int32_t) latency_us - (int32_t) stats->avg_latency_us) / 8;
+    }
+    taskEXIT_CRITICAL(&g_pub_stats_lock);
+}
+
+static void mqtt_pub_count(mqtt_pub_lane_t lane, bool coalesced)
+{
+    taskENTER_CRITICAL(&g_pub_stats_lock);
+    if (coalesced) {
+        g_pub_stats[lane].coalesced++;
+    } else {
+        g_pub_stats[lane].dropped++;
+    }
+    taskEXIT_CRITICAL(&g_pub_stats_lock);
+}
+
+void mqtt_get_pub_stats(mqtt_pub_stats_t *stats)
+{
+    taskENTER_CRITICAL(&g_pub_stats_lock);
+    memcpy(stats, g_pub_stats, sizeof(g_pub_stats));
+    taskEXIT_CRITICAL(&g_pub_stats_lock);
+
+    for (int i = 0; i < MQTT_PUB_LANE_MAX; ++i) {
+        stats[i].depth = g_pub_ready ? pub_ring_depth(&g_pub_rings[i]) : 0;
+    }
+}
+
+static int health_stats_to_json(char *buf, size_t size, int len, const char *name, const i2c_health_stats_t *stats)
+{
+    return json_appendf(buf, size, len,
+                        "\"%s\":{\"ok\":%lu,\"nack\":%lu,\"timeout\":%lu,\"arb_lost\":%lu,\"stuck\":%lu,"
+                        "\"error\":%lu,\"recoveries\":%lu,\"recover_failed\":%lu}",
+                        name, stats->ok, stats->nack, stats->timeout, stats->arb_lost, stats->stuck,
+                        stats->error, stats->recoveries, stats->recover_failed);
+}
+
+// 总线健康、发件箱和命令分发统计发布到 notify 主题
+static void mqtt_publish_health(void)
+{
+    char json[768];
+    i2c_health_stats_t master, keyboard;
+    mqtt_dispatch_stats_t dispatch;
+    outbox_stats_t outbox;
+    menjin_get_health_stats(&master, &keyboard);
+    mqtt_get_dispatch_stats(&dispatch);
+    outbox_get_stats(&outbox);
+
+    int len = snprintf(json, sizeof(json), "{\"action\":\"health\",\"deviceId\":\"%s\",", mqtt_client_id());
+    len = health_stats_to_json(json, sizeof(json), len, "master", &master);
+    len = json_appendf(json, sizeof(json), len, ",");
+    len = health_stats_to_json(json, sizeof(json), len, "keyboard", &keyboard);
+    len = json_appendf(json, sizeof(json), len,
+                       ",\"outbox\":{\"queued\":%lu,\"appended\":%lu,\"delivered\":%lu,\"dropped\":%lu,\"next_seq\":%lu}",
+                       outbox.queued, outbox.appended, outbox.delivered, outbox.dropped, outbox.head);
+    len = json_appendf(json, sizeof(json), len,
+                       ",\"dispatch\":{\"received\":%lu,\"executed\":%lu,\"busy\":%lu,\"oversize\":%lu,"
+                       "\"last_latency_us\":%lu,\"max_latency_us\":%lu,\"avg_latency_us\":%lu}}",
+                       dispatch.received, dispatch.executed, dispatch.busy, dispatch.oversize,
+                       dispatch.last_latency_us, dispatch.max_latency_us, dispatch.avg_latency_us);
+    if (len >= sizeof(json)) {
+        ESP_LOGW(TAG, "health over %d bytes, dropped", (int) sizeof(json));
+        return;
+    }
+
+    mqtt_pub_push(MQTT_PUB_LANE_BULK, MQTT_TOPIC_HEALTH, 1, json, len);
+}
+
 void mqtt_handle_menjin_cmd(char *payload, int len)
 {
     if (len == 0) {
@@ -39,58 +265,647 @@ void mqtt_handle_menjin_cmd(char *payload, int len)
 
     if (strncmp(payload, "cmd ", 4) == 0) {
         char cmd_str[4] = {0};
-        strncpy(cmd_str, payload + 4, len -4);
+        strncpy(cmd_str, payload + 4, len - 4 < sizeof(cmd_str) - 1 ? len - 4 : sizeof(cmd_str) - 1);
         uint8_t cmd = atoi(cmd_str);
-        esp_err_t ret = menjin_cmd_write(cmd);
+        esp_err_t ret = menjin_cmd_enqueue(cmd, MENJIN_PRIO_REMOTE, NULL, NULL);
         ESP_LOGI(TAG, "[menjin] do cmd: %d(%s), ret: %d", cmd, cmd_str, ret);
-    } else if (strncmp(payload, "open", len) == 0) {
-        ESP_LOGI(TAG, "mqtt open start");
-        // 接听的时候会有声音，会导致触发ring_callback，这里先干掉callback，解锁完再解开
-        void *cb = menjin_get_ring_callback();
-        menjin_set_ring_callback(NULL);
-        menjin_cmd_write(MENJIN_CMD_KEY4_SPEAKER);
-        vTaskDelay(3000 / portTICK_PERIOD_MS);
-        menjin_cmd_write(MENJIN_CMD_KEY3_UNLOCK);
-        vTaskDelay(2000 / portTICK_PERIOD_MS);
-        menjin_cmd_write(MENJIN_CMD_KEY4_SPEAKER);
-        menjin_set_ring_callback(cb);
-        ESP_LOGI(TAG, "mqtt open end");
+    } else if (len == strlen("health") && memcmp(payload, "health", len) == 0) {
+        mqtt_publish_health();
+    } else if (len == strlen("autotune") && memcmp(payload, "autotune", len) == 0) {
+        esp_err_t ret = menjin_autotune_start();
+        ESP_LOGI(TAG, "[menjin] autotune, ret: %d", ret);
+    } else {
+        // 其余按宏名称处理，如 "open"
+        char name[APP_MACRO_NAME_LEN] = {0};
+        strncpy(name, payload, len < sizeof(name) - 1 ? len : sizeof(name) - 1);
+        esp_err_t ret = app_macro_run(name, MENJIN_PRIO_REMOTE);
+        if (ret == ESP_ERR_NOT_FOUND) {
+            ESP_LOGW(TAG, "[menjin] unknown cmd: %.*s", len, payload);
+        } else {
+            ESP_LOGI(TAG, "[menjin] run macro: %s, ret: %d", name, ret);
+        }
+    }
+}
+
+// 写任务中调用，只记录结果并唤醒 worker
+static void mqtt_cmd_done_cb(uint8_t cmd, size_t len, esp_err_t ret, void *arg)
+{
+    menjin_queue_stats_t stats;
+    menjin_get_queue_stats(&stats);
+    int64_t now_us = esp_timer_get_time();
+    bool current;
+
+    taskENTER_CRITICAL(&g_dispatch_stats_lock);
+    current = g_cmd_result.gen == (uint32_t) (uintptr_t) arg;
+    if (current) {
+        g_cmd_result.done = true;
+        g_cmd_result.i2c_ret = ret;
+        g_cmd_result.bus_us = stats.last_bus_us;
+        g_cmd_result.done_us = now_us;
+    }
+    taskEXIT_CRITICAL(&g_dispatch_stats_lock);
+
+    if (current) {
+        xTaskNotifyGive(g_cmd_worker);
+    }
+}
+
+/**
+ * @brief Queue a controller command and wait for the writer task to finish it
+ */
+static esp_err_t mqtt_cmd_execute(uint8_t cmd, mqtt_cmd_result_t *result)
+{
+    taskENTER_CRITICAL(&g_dispatch_stats_lock);
+    g_cmd_result.done = false;
+    uint32_t gen = g_cmd_result.gen;
+    taskEXIT_CRITICAL(&g_dispatch_stats_lock);
+    // 清除上次超时后可能残留的通知
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    esp_err_t ret = menjin_cmd_enqueue(cmd, MENJIN_PRIO_REMOTE, mqtt_cmd_done_cb, (void *) (uintptr_t) gen);
+    if (ret == ESP_OK) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MQTT_CMD_DONE_TIMEOUT_MS));
+    }
+
+    taskENTER_CRITICAL(&g_dispatch_stats_lock);
+    *result = g_cmd_result;
+    g_cmd_result.gen++;
+    taskEXIT_CRITICAL(&g_dispatch_stats_lock);
+
+    if (ret == ESP_OK && !result->done) {
+        ret = ESP_ERR_TIMEOUT;
+    }
+
+    return ret;
+}
+
+static const char *mqtt_reply_status(esp_err_t ret)
+{
+    switch (ret) {
+        case ESP_OK:
+            return "ok";
+        case ESP_ERR_INVALID_ARG:
+            return "bad_request";
+        case ESP_ERR_NOT_FOUND:
+            return "not_found";
+        case ESP_ERR_INVALID_STATE:
+        case ESP_ERR_NO_MEM:
+            return "busy";
+        case ESP_ERR_TIMEOUT:
+            return "timeout";
+        case ESP_ERR_NOT_SUPPORTED:
+            return "unknown_op";
+        default:
+            return "error";
+    }
+}
+
+// 请求 ID 原样带回，转义引号和控制字符
+static void json_escape(char *out, size_t size, const char *in)
+{
+    size_t n = 0;
+    for (; *in != '\0' && n + 7 < size; ++in) {
+        if (*in == '"' || *in == '\\') {
+            out[n++] = '\\';
+            out[n++] = *in;
+        } else if ((uint8_t) *in < 0x20) {
+            n += snprintf(out + n, size - n, "\\u%04x", *in);
+        } else {
+            out[n++] = *in;
+        }
+    }
+    out[n] = '\0';
+}
+
+/**
+ * @brief Collect the result and timings of an envelope command
+ *
+ * @param i2c      bus result, only for CMD_OP_CMD
+ * @param rx_us    command received
+ * @param start_us worker picked the command up, 0 if it never did
+ */
+static void mqtt_cmd_reply_fill(mqtt_cmd_reply_t *reply, esp_err_t ret, const mqtt_cmd_result_t *i2c,
+                                int64_t rx_us, int64_t start_us)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    memset(reply, 0, sizeof(mqtt_cmd_reply_t));
+    reply->ret = ret;
+    reply->bus_done = i2c != NULL && i2c->done;
+    reply->queue_us = start_us > 0 ? (uint32_t) (start_us - rx_us) : 0;
+    reply->total_us = now_us - rx_us;
+    if (reply->bus_done) {
+        reply->i2c_ret = i2c->i2c_ret;
+        reply->exec_us = i2c->done_us - start_us;
+        reply->bus_us = i2c->bus_us;
+    }
+}
+
+/**
+ * @brief Publish the result of an envelope command on the resp topic
+ */
+static void mqtt_publish_reply(const cmd_envelope_t *env, const mqtt_cmd_reply_t *reply)
+{
+    char id[CMD_ENVELOPE_ID_LEN * 2];
+    char json[320];
+
+    json_escape(id, sizeof(id), env->id);
+    int len = snprintf(json, sizeof(json), "{\"id\":\"%s\",\"op\":\"%s\",\"status\":\"%s\",\"ret\":%d",
+                       id, cmd_op_name(env->op), mqtt_reply_status(reply->ret), reply->ret);
+    if (reply->bus_done) {
+        len = json_appendf(json, sizeof(json), len, ",\"i2c_ret\":%d", reply->i2c_ret);
+    }
+    // 接收 -> worker -> 门禁写入完成 -> 回复
+    len = json_appendf(json, sizeof(json), len, ",\"t\":{\"queue_us\":%lu", reply->queue_us);
+    if (reply->bus_done) {
+        len = json_appendf(json, sizeof(json), len, ",\"exec_us\":%lu,\"bus_us\":%lu",
+                           reply->exec_us, reply->bus_us);
+    }
+    len = json_appendf(json, sizeof(json), len, ",\"total_us\":%lu}}", reply->total_us);
+    if (len >= sizeof(json)) {
+        ESP_LOGW(TAG, "reply over %d bytes, dropped", (int) sizeof(json));
+        return;
+    }
+
+    mqtt_pub_push(MQTT_PUB_LANE_REPLY, MQTT_TOPIC_RESP, 0, json, len);
+}
+
+static void mqtt_handle_envelope(const cmd_envelope_t *env, cmd_envelope_result_t result, int64_t rx_us, int64_t start_us,
+                                 mqtt_cmd_reply_cb_t reply_cb, void *reply_arg)
+{
+    mqtt_cmd_result_t i2c = {0};
+    esp_err_t ret = ESP_ERR_INVALID_ARG;
+
+    if (result == CMD_ENVELOPE_ERR_OP) {
+        ret = ESP_ERR_NOT_SUPPORTED;
+    } else if (result == CMD_ENVELOPE_OK) {
+        switch (env->op) {
+            case CMD_OP_CMD: {
+                char *end;
+                unsigned long cmd = strtoul(env->arg, &end, 0);
+                if (end != env->arg && *end == '\0' && cmd <= UINT8_MAX) {
+                    ret = mqtt_cmd_execute(cmd, &i2c);
+                }
+                break;
+            }
+            case CMD_OP_MACRO:
+                ret = app_macro_run(env->arg, MENJIN_PRIO_REMOTE);
+                break;
+            case CMD_OP_HEALTH:
+                mqtt_publish_health();
+                ret = ESP_OK;
+                break;
+            case CMD_OP_AUTOTUNE:
+                ret = menjin_autotune_start();
+                break;
+            default:
+                ret = ESP_ERR_NOT_SUPPORTED;
+                break;
+        }
+        if (ret == ESP_OK && i2c.done && i2c.i2c_ret != ESP_OK) {
+            ret = ESP_FAIL;
+        }
+    }
+
+    ESP_LOGI(TAG, "[menjin] envelope id: %s, op: %s, arg: %s, ret: %d", env->id, cmd_op_name(env->op), env->arg, ret);
+
+    mqtt_cmd_reply_t reply;
+    mqtt_cmd_reply_fill(&reply, ret, &i2c, rx_us, start_us);
+    if (reply_cb != NULL) {
+        reply_cb(env, &reply, reply_arg);
+    } else {
+        mqtt_publish_reply(env, &reply);
+    }
+}
+
+void mqtt_get_dispatch_stats(mqtt_dispatch_stats_t *stats)
+{
+    taskENTER_CRITICAL(&g_dispatch_stats_lock);
+    *stats = g_dispatch_stats;
+    taskEXIT_CRITICAL(&g_dispatch_stats_lock);
+}
+
+static void mqtt_outbox_connected(bool connected)
+{
+    taskENTER_CRITICAL(&g_outbox_lock);
+    g_outbox_batch.connected = connected;
+    // 断线后未确认的条目重连时重发
+    g_outbox_batch.count = 0;
+    g_outbox_batch.acked = 0;
+    taskEXIT_CRITICAL(&g_outbox_lock);
+
+    if (connected) {
+        mqtt_pub_kick();
+    }
+}
+
+static void mqtt_outbox_published(int msg_id)
+{
+    bool done = false;
+
+    taskENTER_CRITICAL(&g_outbox_lock);
+    for (int i = 0; i < g_outbox_batch.count; ++i) {
+        if (g_outbox_batch.msg_ids[i] == msg_id) {
+            g_outbox_batch.msg_ids[i] = -1;
+            done = ++g_outbox_batch.acked == g_outbox_batch.count;
+            break;
+        }
+    }
+    taskEXIT_CRITICAL(&g_outbox_lock);
+
+    if (done) {
+        mqtt_pub_kick();
+    }
+}
+
+/**
+ * @brief Publish the outbox in batches of CONFIG_MENJIN_OUTBOX_BATCH with QoS1, the next batch once the previous one is acked
+ */
+static void mqtt_outbox_send(void)
+{
+    outbox_entry_t entry;
+
+    taskENTER_CRITICAL(&g_outbox_lock);
+    mqtt_outbox_batch_t batch = g_outbox_batch;
+    bool complete = batch.count > 0 && batch.acked == batch.count;
+    bool expired = batch.count > 0 && !complete
+                   && xTaskGetTickCount() - batch.sent_at >= pdMS_TO_TICKS(MQTT_OUTBOX_ACK_TIMEOUT_MS);
+    if (complete || expired) {
+        g_outbox_batch.count = 0;
+        g_outbox_batch.acked = 0;
+    }
+    taskEXIT_CRITICAL(&g_outbox_lock);
+
+    if (complete) {
+        outbox_ack(batch.last_seq);
+    } else if (expired) {
+        ESP_LOGW(TAG, "outbox batch not acked in time, resend");
+    } else if (batch.count > 0) {
+        return;
+    }
+    if (!batch.connected) {
+        return;
+    }
+
+    uint32_t seq = 0;
+    uint8_t count = 0;
+    int msg_ids[CONFIG_MENJIN_OUTBOX_BATCH];
+    // 读不出的条目结束这一批，轮到它成为最旧的条目时 outbox_peek 会丢弃它
+    while (count < CONFIG_MENJIN_OUTBOX_BATCH && outbox_peek(seq, &entry) == ESP_OK) {
+        int msg_id = esp_mqtt_client_enqueue(g_client, g_topic_notify, entry.data, entry.len, 1, 0, true);
+        if (msg_id < 0) {
+            break;
+        }
+        // 只统计首次发出，重发不计
+        mqtt_event_time_t *time = &g_event_times[entry.seq % CONFIG_MENJIN_OUTBOX_LEN];
+        if (time->valid && time->seq == entry.seq) {
+            time->valid = false;
+            mqtt_pub_sent(MQTT_PUB_LANE_EVENT, time->time_us);
+        }
+        msg_ids[count++] = msg_id;
+        seq = entry.seq + 1;
+    }
+    if (count == 0) {
+        return;
+    }
+
+    taskENTER_CRITICAL(&g_outbox_lock);
+    // 入队期间断线则整批作废
+    if (g_outbox_batch.connected) {
+        memcpy(g_outbox_batch.msg_ids, msg_ids, sizeof(msg_ids));
+        g_outbox_batch.count = count;
+        g_outbox_batch.acked = 0;
+        g_outbox_batch.last_seq = seq - 1;
+        g_outbox_batch.sent_at = xTaskGetTickCount();
+    }
+    taskEXIT_CRITICAL(&g_outbox_lock);
+
+    ESP_LOGI(TAG, "outbox batch sent, %d entries up to seq %lu", count, seq - 1);
+}
+
+/**
+ * @brief Move queued events into the NVS outbox, the outbox then delivers them with QoS1
+ */
+static void mqtt_pub_events(void)
+{
+    pub_ring_t *ring = &g_pub_rings[MQTT_PUB_LANE_EVENT];
+    const pub_msg_t *msg;
+
+    while ((msg = pub_ring_peek(ring)) != NULL) {
+        uint32_t seq;
+        if (outbox_append(msg->data, msg->len, &seq) == ESP_OK) {
+            g_event_times[seq % CONFIG_MENJIN_OUTBOX_LEN] = (mqtt_event_time_t) {
+                    .seq = seq,
+                    .time_us = msg->time_us,
+                    .valid = true,
+            };
+        } else if (g_outbox_batch.connected
+                   && esp_mqtt_client_enqueue(g_client, g_topic_notify, msg->data, msg->len, 1, 0, true) >= 0) {
+            // 写入 NVS 失败时直接发布，不再保证送达
+            mqtt_pub_sent(MQTT_PUB_LANE_EVENT, msg->time_us);
+        } else {
+            mqtt_pub_count(MQTT_PUB_LANE_EVENT, false);
+        }
+        pub_ring_pop(ring);
+    }
+}
+
+// 同一类的报告后面还有更新的一帧在排队，只发最新的，这一条可以丢弃
+static bool mqtt_pub_superseded(pub_ring_t *ring, const pub_msg_t *msg)
+{
+    const pub_msg_t *next;
+
+    for (uint32_t i = 1; (next = pub_ring_peek_at(ring, i)) != NULL; ++i) {
+        if (next->topic == msg->topic) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Hand the oldest message of a lane to the MQTT client
+ *
+ * @return false if the lane is empty
+ */
+static bool mqtt_pub_send_one(mqtt_pub_lane_t lane)
+{
+    static const char *topics[] = {
+            [MQTT_TOPIC_NOTIFY] = g_topic_notify,
+            [MQTT_TOPIC_RESP] = g_topic_resp,
+            [MQTT_TOPIC_TELEMETRY] = g_topic_telemetry,
+            [MQTT_TOPIC_HEALTH] = g_topic_notify,
+    };
+    pub_ring_t *ring = &g_pub_rings[lane];
+
+    const pub_msg_t *msg = pub_ring_peek(ring);
+    if (msg == NULL) {
+        return false;
+    }
+
+    if (lane == MQTT_PUB_LANE_BULK && mqtt_pub_superseded(ring, msg)) {
+        mqtt_pub_count(lane, true);
+    } else if (g_outbox_batch.connected
+               && esp_mqtt_client_enqueue(g_client, topics[msg->topic], msg->data, msg->len, msg->qos, 0, true) >= 0) {
+        mqtt_pub_sent(lane, msg->time_us);
     } else {
-        ESP_LOGW(TAG, "[menjin] unknown cmd: %.*s", len, payload);
+        // 离线时回复和报告没有意义，不保留
+        mqtt_pub_count(lane, false);
+    }
+    pub_ring_pop(ring);
+
+    return true;
+}
+
+/**
+ * @brief Single consumer of all publish lanes
+ *
+ * Events always go first: every message taken from a lower lane is preceded by a check of the
+ * event lane, so a ring is never queued behind telemetry.
+ */
+_Noreturn static void mqtt_pub_task(void *param)
+{
+    while (1) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MQTT_OUTBOX_ACK_TIMEOUT_MS));
+
+        do {
+            mqtt_pub_events();
+            mqtt_outbox_send();
+        } while (mqtt_pub_send_one(MQTT_PUB_LANE_REPLY) || mqtt_pub_send_one(MQTT_PUB_LANE_BULK));
+    }
+}
+
+esp_err_t mqtt_pub_start(void)
+{
+    if (g_pub_ready) {
+        return ESP_OK;
+    }
+
+    pub_ring_init(&g_pub_rings[MQTT_PUB_LANE_EVENT], g_pub_event_buf, MQTT_PUB_EVENT_SLOTS, OUTBOX_DATA_MAX);
+    pub_ring_init(&g_pub_rings[MQTT_PUB_LANE_REPLY], g_pub_reply_buf, MQTT_PUB_REPLY_SLOTS, MQTT_PUB_REPLY_MAX);
+    pub_ring_init(&g_pub_rings[MQTT_PUB_LANE_BULK], g_pub_bulk_buf, MQTT_PUB_BULK_SLOTS, MQTT_PUB_BULK_MAX);
+
+    if (xTaskCreate(mqtt_pub_task, "mqtt_pub_task", 3072, NULL, MQTT_PUB_TASK_PRIO, &g_pub_task) != pdPASS) {
+        ESP_LOGE(TAG, "No memory for publish task");
+        return ESP_ERR_NO_MEM;
+    }
+    g_pub_ready = true;
+
+    return ESP_OK;
+}
+
+_Noreturn static void mqtt_cmd_worker_task(void *param)
+{
+    uint8_t index;
+
+    while (1) {
+        xQueueReceive(g_cmd_ready, &index, portMAX_DELAY);
+        mqtt_cmd_slot_t *slot = &g_cmd_slots[index];
+
+        uint32_t latency_us = esp_timer_get_time() - slot->rx_us;
+        taskENTER_CRITICAL(&g_dispatch_stats_lock);
+        g_dispatch_stats.executed++;
+        g_dispatch_stats.last_latency_us = latency_us;
+        if (latency_us > g_dispatch_stats.max_latency_us) {
+            g_dispatch_stats.max_latency_us = latency_us;
+        }
+        // EWMA, 1/8
+        if (g_dispatch_stats.avg_latency_us == 0) {
+            g_dispatch_stats.avg_latency_us = latency_us;
+        } else {
+            g_dispatch_stats.avg_latency_us += ((int32_t) latency_us - (int32_t) g_dispatch_stats.avg_latency_us) / 8;
+        }
+        taskEXIT_CRITICAL(&g_dispatch_stats_lock);
+
+        cmd_envelope_t env;
+        cmd_envelope_result_t result = cmd_envelope_parse(slot->data, slot->len, &env);
+        if (result == CMD_ENVELOPE_LEGACY) {
+            mqtt_handle_menjin_cmd(slot->data, slot->len);
+        } else {
+            mqtt_handle_envelope(&env, result, slot->rx_us, slot->rx_us + latency_us, slot->reply_cb, slot->reply_arg);
+        }
+
+        xQueueSend(g_cmd_free, &index, 0);
+    }
+}
+
+static esp_err_t mqtt_cmd_dispatch_init(void)
+{
+    if (g_cmd_free != NULL) {
+        return ESP_OK;
+    }
+
+    g_cmd_free = xQueueCreate(MQTT_CMD_SLOTS, sizeof(uint8_t));
+    g_cmd_ready = xQueueCreate(MQTT_CMD_SLOTS, sizeof(uint8_t));
+    if (g_cmd_free == NULL || g_cmd_ready == NULL) {
+        ESP_LOGE(TAG, "No memory for mqtt cmd queues");
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (uint8_t i = 0; i < MQTT_CMD_SLOTS; ++i) {
+        xQueueSend(g_cmd_free, &i, 0);
+    }
+
+    if (xTaskCreate(mqtt_cmd_worker_task, "mqtt_cmd_worker_task", 3072, NULL, MQTT_CMD_WORKER_PRIO, &g_cmd_worker) != pdPASS) {
+        ESP_LOGE(TAG, "No memory for mqtt cmd worker");
+        return ESP_ERR_NO_MEM;
+    }
+
+    return ESP_OK;
+}
+
+// 所有槽位都在使用时回复 busy，由发送方稍后重试
+static void mqtt_publish_busy(const char *data, int len)
+{
+    char cmd[33];
+    char escaped[sizeof(cmd) * 6];
+    char json[280];
+
+    // 命令原样回显，非 ASCII 字节替换掉，截断后不会留下半个 UTF-8 字符
+    int n = len < sizeof(cmd) - 1 ? len : sizeof(cmd) - 1;
+    for (int i = 0; i < n; ++i) {
+        cmd[i] = (uint8_t) data[i] < 0x80 ? data[i] : '?';
+    }
+    cmd[n] = '\0';
+    json_escape(escaped, sizeof(escaped), cmd);
+
+    snprintf(json, sizeof(json), "{\"action\":\"busy\",\"deviceId\":\"%s\",\"cmd\":\"%s\"}",
+             mqtt_client_id(), escaped);
+
+    mqtt_pub_push(MQTT_PUB_LANE_REPLY, MQTT_TOPIC_NOTIFY, 0, json, strlen(json));
+}
+
+esp_err_t mqtt_cmd_submit(const char *data, size_t len, int64_t rx_us, mqtt_cmd_reply_cb_t reply_cb, void *reply_arg)
+{
+    uint8_t index;
+
+    if (g_cmd_free == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (len > MQTT_CMD_DATA_MAX) {
+        return ESP_ERR_INVALID_SIZE;
     }
+    if (xQueueReceive(g_cmd_free, &index, 0) != pdTRUE) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    mqtt_cmd_slot_t *slot = &g_cmd_slots[index];
+    slot->rx_us = rx_us;
+    slot->len = len;
+    memcpy(slot->data, data, len);
+    slot->reply_cb = reply_cb;
+    slot->reply_arg = reply_arg;
+
+    xQueueSend(g_cmd_ready, &index, 0);
+
+    return ESP_OK;
 }
 
+/**
+ * @brief Copy a command into a free slot and wake the worker, called from the MQTT event task
+ */
+static void mqtt_cmd_dispatch(esp_mqtt_event_handle_t event)
+{
+    int64_t rx_us = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&g_dispatch_stats_lock);
+    g_dispatch_stats.received++;
+    taskEXIT_CRITICAL(&g_dispatch_stats_lock);
+
+    // 分片或过长的消息不是有效命令
+    if (event->current_data_offset != 0 || event->total_data_len > MQTT_CMD_DATA_MAX) {
+        taskENTER_CRITICAL(&g_dispatch_stats_lock);
+        g_dispatch_stats.oversize++;
+        taskEXIT_CRITICAL(&g_dispatch_stats_lock);
+        ESP_LOGW(TAG, "drop mqtt cmd, len: %d", event->total_data_len);
+        return;
+    }
+
+    if (mqtt_cmd_submit(event->data, event->data_len, rx_us, NULL, NULL) != ESP_OK) {
+        taskENTER_CRITICAL(&g_dispatch_stats_lock);
+        g_dispatch_stats.busy++;
+        taskEXIT_CRITICAL(&g_dispatch_stats_lock);
+        ESP_LOGW(TAG, "mqtt cmd slots full, reply busy, len: %d", event->data_len);
+        cmd_envelope_t env;
+        if (cmd_envelope_parse(event->data, event->data_len, &env) == CMD_ENVELOPE_LEGACY) {
+            mqtt_publish_busy(event->data, event->data_len);
+        } else {
+            mqtt_cmd_reply_t reply;
+            mqtt_cmd_reply_fill(&reply, ESP_ERR_NO_MEM, NULL, rx_us, 0);
+            mqtt_publish_reply(&env, &reply);
+        }
+    }
+}
+
+// 订阅完成后上线，附带连接各阶段耗时
+static void mqtt_publish_online(void)
+{
+    char json[384];
+    char ip[16] = {0};
+    int64_t now_us = esp_timer_get_time();
+    wifi_mgr_get_ip(ip);
+
+    int len = snprintf(json, sizeof(json),
+                       "{\"action\":\"%s\",\"deviceId\":\"%s\",\"localIp\":\"%s\",\"sessionPresent\":%s,"
+                       "\"connectMs\":%lu,\"subscribeMs\":%lu",
+                       "online", mqtt_client_id(), ip, g_session_present ? "true" : "false",
+                       (uint32_t) ((g_connected_us - g_connect_start_us) / 1000),
+                       (uint32_t) ((now_us - g_connect_start_us) / 1000));
+    if (g_tls_transport) {
+        mqtt_tls_stats_t tls;
+        mqtt_tls_get_stats(&tls);
+        len = json_appendf(json, sizeof(json), len,
+                           ",\"tlsMs\":%lu,\"tlsSession\":\"%s\",\"tlsProfile\":\"%s\",\"tlsHeapPeak\":%lu,\"tlsHeapSteady\":%lu",
+                           tls.connect_ms, mqtt_tls_session_src_name(tls.session), mqtt_tls_profile_name(),
+                           tls.heap_handshake_peak, tls.heap_steady);
+    }
+    len = json_appendf(json, sizeof(json), len, ",\"heapFree\":%lu,\"heapMin\":%lu",
+                       esp_get_free_heap_size(), esp_get_minimum_free_heap_size());
+    len = json_appendf(json, sizeof(json), len, "}");
+    if (len >= sizeof(json)) {
+        ESP_LOGW(TAG, "online over %d bytes, dropped", (int) sizeof(json));
+        return;
+    }
+
+    mqtt_pub_push(MQTT_PUB_LANE_REPLY, MQTT_TOPIC_NOTIFY, 1, json, len);
+    ESP_LOGI(TAG, "publish %s to %s", json, g_topic_notify);
+}
 
 static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event)
 {
     esp_mqtt_client_handle_t client = event->client;
 
-    int msg_id;
     // your_context_t *context = event->context;
     switch (event->event_id) {
-        case MQTT_EVENT_CONNECTED:
-            ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED");
+        case MQTT_EVENT_BEFORE_CONNECT:
+            g_connect_start_us = esp_timer_get_time();
+            break;
 
-            char json[128] = {0};
-            char ip[15] = {0};
-            wifi_mgr_get_ip(ip);
-            sprintf(json, "{\"action\":\"%s\",\"deviceId\":\"%s\",\"localIp\":\"%s\"}", "online", mqtt_client_id(), ip);
+        case MQTT_EVENT_CONNECTED:
+            g_connected_us = esp_timer_get_time();
+            g_session_present = event->session_present;
+            ESP_LOGI(TAG, "MQTT_EVENT_CONNECTED, session_present=%d", event->session_present);
 
-            msg_id = esp_mqtt_client_publish(client, g_topic_notify, json, 0, 1, 0);
-            ESP_LOGI(TAG, "publish %s to %s successful, msg_id=%d", json, g_topic_notify, msg_id);
+            // QoS1 订阅，离线期间的命令由 broker 保存在持久会话中
+            g_subscribe_msg_id = esp_mqtt_client_subscribe(client, g_topic_cmd, 1);
+            ESP_LOGI(TAG, "subscribe %s successful, msg_id=%d", g_topic_cmd, g_subscribe_msg_id);
 
-            msg_id = esp_mqtt_client_subscribe(client, g_topic_cmd, 0);
-            ESP_LOGI(TAG, "subscribe %s successful, msg_id=%d", g_topic_cmd, msg_id);
+            mqtt_outbox_connected(true);
             break;
 
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGI(TAG, "MQTT_EVENT_DISCONNECTED");
+            mqtt_outbox_connected(false);
             break;
 
         case MQTT_EVENT_SUBSCRIBED:
 //            ESP_LOGI(TAG, "MQTT_EVENT_SUBSCRIBED, msg_id=%d", event->msg_id);
 //            msg_id = esp_mqtt_client_publish(client, "/topic/qos0", "data", 0, 0, 0);
 //            ESP_LOGI(TAG, "sent publish successful, msg_id=%d", msg_id);
+            if (event->msg_id == g_subscribe_msg_id) {
+                mqtt_publish_online();
+            }
             break;
 
         case MQTT_EVENT_UNSUBSCRIBED:
@@ -99,13 +914,14 @@ static esp_err_t mqtt_event_handler_cb(esp_mqtt_event_handle_t event)
 
         case MQTT_EVENT_PUBLISHED:
             ESP_LOGI(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
+            mqtt_outbox_published(event->msg_id);
             break;
 
         case MQTT_EVENT_DATA:
             ESP_LOGI(TAG, "MQTT_EVENT_DATA");
             ESP_LOGI(TAG, "Receive [%.*s] DATA: %.*s", event->topic_len, event->topic, event->data_len, event->data);
 
-            mqtt_handle_menjin_cmd(event->data, event->data_len);
+            mqtt_cmd_dispatch(event);
 
             break;
 
@@ -153,9 +969,17 @@ void mqtt_task(void *pvParameters)
 {
     g_topic_cmd[0] = '\0';
     g_topic_notify[0] = '\0';
+    g_topic_resp[0] = '\0';
+    g_topic_telemetry[0] = '\0';
 
     sys_param_t *settings = settings_get_parameter();
 
+    // 局域网控制通道也使用命令 worker，未配置 MQTT 时同样启动
+    if (mqtt_cmd_dispatch_init() != ESP_OK) {
+        vTaskDelete(NULL);
+        return;
+    }
+
     if (strlen(settings->mqtt_url) == 0) {
         ESP_LOGE(TAG, "mqtt_url is empty, mqtt client will not start");
         vTaskDelete(NULL);
@@ -166,6 +990,8 @@ void mqtt_task(void *pvParameters)
 
     sprintf(g_topic_cmd, MQTT_TOPIC_PREFIX "%s/cmd", client_id);
     sprintf(g_topic_notify, MQTT_TOPIC_PREFIX "%s/notify", client_id);
+    sprintf(g_topic_resp, MQTT_TOPIC_PREFIX "%s/resp", client_id);
+    sprintf(g_topic_telemetry, MQTT_TOPIC_PREFIX "%s/telemetry", client_id);
 
 
 #if CONFIG_IDF_TARGET_ESP8266
@@ -203,19 +1029,44 @@ void mqtt_task(void *pvParameters)
     }
 #endif
 
+#ifdef CONFIG_MENJIN_MQTT_TLS_PSK
+    // 自建 broker 使用预共享密钥，不校验证书
+    if (strncmp(settings->mqtt_url, "mqtts://", 8) == 0) {
+        mqtt_cfg.network.transport = mqtt_tls_transport_create(NULL, 0, settings->mqtt_url);
+        g_tls_transport = mqtt_cfg.network.transport != NULL;
+    }
+#else
     if (strncmp(settings->mqtt_url, "mqtts://", 8) == 0
         && (
                 strstr(settings->mqtt_url, "witgine.com") != NULL
                 || strstr(settings->mqtt_url, "emqx") != NULL
             )
     ) {
-        mqtt_cfg.broker.verification.certificate = (const char *) server_root_cert_pem_start;
+        // 自定义传输层：缓存 TLS 会话，应用 TLS 配置并统计握手内存
+        mqtt_cfg.network.transport = mqtt_tls_transport_create((const char *) server_root_cert_pem_start,
+                                                               server_root_cert_pem_end - server_root_cert_pem_start,
+                                                               settings->mqtt_url);
+        g_tls_transport = mqtt_cfg.network.transport != NULL;
+        if (!g_tls_transport) {
+            mqtt_cfg.broker.verification.certificate = (const char *) server_root_cert_pem_start;
+        }
     }
+#endif
+
+#ifdef CONFIG_MENJIN_MQTT_PERSISTENT_SESSION
+    // client_id 保存在 NVS 中保持不变，broker 据此恢复会话
+    mqtt_cfg.session.disable_clean_session = true;
+#endif
 
     ESP_LOGI(TAG, "mqtt_cfg.uri: %s", settings->mqtt_url);
     ESP_LOGI(TAG, "mqtt_cfg.username: %s", settings->mqtt_username);
     ESP_LOGI(TAG, "mqtt_cfg.password: %s", settings->mqtt_password);
 
+    if (mqtt_pub_start() != ESP_OK) {
+        vTaskDelete(NULL);
+        return;
+    }
+
     g_client = esp_mqtt_client_init(&mqtt_cfg);
     esp_mqtt_client_register_event(g_client, ESP_EVENT_ANY_ID, mqtt_event_handler, g_client);
     esp_mqtt_client_start(g_client);
@@ -226,5 +1077,18 @@ void mqtt_task(void *pvParameters)
 
 void mqtt_notify(char* content)
 {
-    esp_mqtt_client_publish(g_client, g_topic_notify, content, 0, 1, 0);
-}
\ No newline at end of file
+    // 调用方是振铃检测任务：只放入事件通道，落盘和发布都由发布任务完成，未连接时也一样
+    if (mqtt_pub_push(MQTT_PUB_LANE_EVENT, MQTT_TOPIC_NOTIFY, 1, content, strlen(content)) != ESP_OK) {
+        ESP_LOGW(TAG, "notify event dropped: %s", content);
+    }
+}
+
+esp_err_t mqtt_publish_telemetry(const char *data, int len)
+{
+    if (!g_outbox_batch.connected) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // QoS0，丢失的帧由下一个关键帧补齐
+    return mqtt_pub_push(MQTT_PUB_LANE_BULK, MQTT_TOPIC_TELEMETRY, 0, data, len);
+}
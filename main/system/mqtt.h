@@ -4,9 +4,94 @@
 
 #ifndef ESP_MENJIN_MQTT_H
 #define ESP_MENJIN_MQTT_H
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <esp_err.h>
+#include "cmd_envelope.h"
+
+typedef struct {
+    uint32_t received;                      // MQTT_EVENT_DATA on the cmd topic
+    uint32_t executed;
+    uint32_t busy;                          // all slots in use, "busy" published
+    uint32_t oversize;                      // fragmented or longer than a slot, dropped
+    uint32_t last_latency_us;               // received -> worker starts the command
+    uint32_t max_latency_us;
+    uint32_t avg_latency_us;
+} mqtt_dispatch_stats_t;
+
+typedef enum {
+    MQTT_PUB_LANE_EVENT = 0,                // ring and other notify events, stored in the outbox
+    MQTT_PUB_LANE_REPLY,                    // command replies, busy and online notices
+    MQTT_PUB_LANE_BULK,                     // telemetry and health reports, only the latest of each kind kept
+    MQTT_PUB_LANE_MAX,
+} mqtt_pub_lane_t;
+
+typedef struct {
+    uint32_t pushed;
+    uint32_t sent;                          // handed to the MQTT client
+    uint32_t dropped;                       // lane full, message too long or offline
+    uint32_t coalesced;                     // a newer report of the same kind queued behind it
+    uint32_t depth;                         // messages waiting now
+    uint32_t max_depth;
+    uint32_t last_latency_us;               // producer -> esp_mqtt_client_enqueue
+    uint32_t max_latency_us;
+    uint32_t avg_latency_us;
+} mqtt_pub_stats_t;
+
+typedef struct {
+    esp_err_t ret;
+    bool bus_done;                          // the command reached the bus, fields below are valid
+    esp_err_t i2c_ret;
+    uint32_t queue_us;                      // received -> worker
+    uint32_t exec_us;                       // worker -> bus write done
+    uint32_t bus_us;
+    uint32_t total_us;                      // received -> reply
+} mqtt_cmd_reply_t;
+
+/**
+ * @brief Result of a command submitted with mqtt_cmd_submit(), called from the worker task
+ */
+typedef void (*mqtt_cmd_reply_cb_t)(const cmd_envelope_t *env, const mqtt_cmd_reply_t *reply, void *arg);
+
 int generate_mqtt_client_id(char*);
 char* mqtt_client_id();
 void mqtt_task(void *pvParameters);
+/**
+ * @brief Start the publish task, before Wi-Fi so that events queued offline go to the outbox
+ *
+ * Called again by mqtt_task, does nothing once started.
+ */
+esp_err_t mqtt_pub_start(void);
+/**
+ * @brief Queue a notify event, never blocks; delivered with QoS1 through the outbox
+ */
 void mqtt_notify(char* content);
+void mqtt_get_dispatch_stats(mqtt_dispatch_stats_t *stats);
+
+/**
+ * @brief Run a command on the MQTT command worker, like one received on the cmd topic
+ *
+ * @param rx_us    receive time, reply timings start here
+ * @param reply_cb envelope result goes here instead of the resp topic, NULL to publish it;
+ *                 never called for legacy text commands
+ * @return
+ *     - ESP_ERR_INVALID_STATE worker not started
+ *     - ESP_ERR_INVALID_SIZE command longer than a slot
+ *     - ESP_ERR_NO_MEM all slots in use
+ */
+esp_err_t mqtt_cmd_submit(const char *data, size_t len, int64_t rx_us, mqtt_cmd_reply_cb_t reply_cb, void *reply_arg);
+
+/**
+ * @param stats array of MQTT_PUB_LANE_MAX
+ */
+void mqtt_get_pub_stats(mqtt_pub_stats_t *stats);
+
+/**
+ * @brief Publish a telemetry frame, QoS 0
+ *
+ * @return ESP_ERR_INVALID_STATE when not connected, the frame is not queued
+ */
+esp_err_t mqtt_publish_telemetry(const char *data, int len);
 
 #endif //ESP_MENJIN_MQTT_H
\ No newline at end of file
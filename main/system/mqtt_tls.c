@@ -0,0 +1,390 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_crc.h"
+#include "esp_tls.h"
+#include "mbedtls/ssl.h"
+#include "mbedtls/ssl_ciphersuites.h"
+#include "lwip/sockets.h"
+#include "mqtt_tls.h"
+
+static const char *TAG = "MQTT_TLS";
+
+#define MQTT_TLS_DEFAULT_PORT       8883
+#define RTC_SESSION_MAGIC           0x4d514c53      // "MQLS"
+// 保留对端证书时序列化后约 1.2KB
+#define RTC_SESSION_MAX             1536
+
+#if defined(CONFIG_MENJIN_MQTT_TLS_RESUME) && defined(CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS)
+#define MQTT_TLS_RESUME
+#endif
+
+// 限制密码套件：减少握手中协商和证书校验的内存占用
+#if defined(CONFIG_MENJIN_MQTT_TLS_PSK)
+static const int g_ciphersuites[] = {
+        MBEDTLS_TLS_PSK_WITH_AES_128_GCM_SHA256,
+        MBEDTLS_TLS_PSK_WITH_AES_128_CBC_SHA256,
+        0
+};
+#elif defined(CONFIG_MENJIN_MQTT_TLS_CIPHERS_ECDHE_GCM)
+static const int g_ciphersuites[] = {
+        MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+        MBEDTLS_TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256,
+        0
+};
+#elif defined(CONFIG_MENJIN_MQTT_TLS_CIPHERS_ECDSA)
+static const int g_ciphersuites[] = {
+        MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_GCM_SHA256,
+        MBEDTLS_TLS_ECDHE_ECDSA_WITH_AES_128_CBC_SHA256,
+        0
+};
+#endif
+
+#ifdef CONFIG_MENJIN_MQTT_TLS_PSK
+// 十六进制字符串，如 "1a2b3c..."，启动时转换
+#define PSK_KEY_LEN                 ((sizeof(CONFIG_MENJIN_MQTT_TLS_PSK_KEY) - 1) / 2)
+static uint8_t g_psk_key[PSK_KEY_LEN];
+static const psk_hint_key_t g_psk = {
+        .key = g_psk_key,
+        .key_size = PSK_KEY_LEN,
+        .hint = CONFIG_MENJIN_MQTT_TLS_PSK_HINT,
+};
+#endif
+
+typedef struct {
+    esp_tls_t *tls;
+    const char *cacert;
+    size_t cacert_len;
+} mqtt_tls_ctx_t;
+
+// 软重启后仍保留，魔数和 CRC 校验通过才使用
+typedef struct {
+    uint32_t magic;
+    uint32_t uri_crc;
+    uint32_t len;
+    uint32_t crc;
+    uint8_t data[RTC_SESSION_MAX];
+} rtc_session_t;
+
+static RTC_NOINIT_ATTR rtc_session_t g_rtc_session;
+static esp_tls_client_session_t *g_session = NULL;
+static mqtt_tls_session_src_t g_session_src = MQTT_TLS_SESSION_NONE;
+static uint32_t g_uri_crc = 0;
+static mqtt_tls_stats_t g_stats = {0};
+
+#ifdef MQTT_TLS_RESUME
+/*
+ * esp_tls_client_session_t only wraps an mbedtls_ssl_session (esp-tls, mbedTLS backend) and is
+ * released by esp_tls_free_client_session(), so a session loaded from RTC memory is built the
+ * same way.
+ */
+static mbedtls_ssl_session *session_of(esp_tls_client_session_t *session)
+{
+    return (mbedtls_ssl_session *) session;
+}
+
+static void rtc_session_save(esp_tls_client_session_t *session)
+{
+    size_t len = 0;
+    if (mbedtls_ssl_session_save(session_of(session), g_rtc_session.data, sizeof(g_rtc_session.data), &len) != 0) {
+        ESP_LOGW(TAG, "session too large for RTC memory, not saved");
+        g_rtc_session.magic = 0;
+        return;
+    }
+
+    g_rtc_session.uri_crc = g_uri_crc;
+    g_rtc_session.len = len;
+    g_rtc_session.crc = esp_rom_crc32_le(0, g_rtc_session.data, len);
+    g_rtc_session.magic = RTC_SESSION_MAGIC;
+}
+
+static esp_tls_client_session_t *rtc_session_load(void)
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    if (reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT
+        || g_rtc_session.magic != RTC_SESSION_MAGIC || g_rtc_session.uri_crc != g_uri_crc
+        || g_rtc_session.len > sizeof(g_rtc_session.data)
+        || g_rtc_session.crc != esp_rom_crc32_le(0, g_rtc_session.data, g_rtc_session.len)) {
+        g_rtc_session.magic = 0;
+        return NULL;
+    }
+
+    esp_tls_client_session_t *session = calloc(1, sizeof(mbedtls_ssl_session));
+    if (session == NULL) {
+        return NULL;
+    }
+    mbedtls_ssl_session_init(session_of(session));
+    if (mbedtls_ssl_session_load(session_of(session), g_rtc_session.data, g_rtc_session.len) != 0) {
+        ESP_LOGW(TAG, "saved session rejected by mbedtls");
+        esp_tls_free_client_session(session);
+        g_rtc_session.magic = 0;
+        return NULL;
+    }
+
+    return session;
+}
+
+static void session_drop(void)
+{
+    if (g_session != NULL) {
+        esp_tls_free_client_session(g_session);
+        g_session = NULL;
+    }
+    g_rtc_session.magic = 0;
+}
+#endif
+
+static int mqtt_tls_poll(esp_transport_handle_t t, int timeout_ms, bool write)
+{
+    mqtt_tls_ctx_t *ctx = esp_transport_get_context_data(t);
+    int fd = -1;
+
+    if (ctx->tls == NULL || esp_tls_get_conn_sockfd(ctx->tls, &fd) != ESP_OK || fd < 0) {
+        return -1;
+    }
+    // mbedTLS 内部已缓存的数据不会让 socket 可读
+    if (!write && esp_tls_get_bytes_avail(ctx->tls) > 0) {
+        return 1;
+    }
+
+    fd_set fds, errfds;
+    FD_ZERO(&fds);
+    FD_ZERO(&errfds);
+    FD_SET(fd, &fds);
+    FD_SET(fd, &errfds);
+    struct timeval timeout = {
+            .tv_sec = timeout_ms / 1000,
+            .tv_usec = (timeout_ms % 1000) * 1000,
+    };
+
+    int ret = select(fd + 1, write ? NULL : &fds, write ? &fds : NULL, &errfds, timeout_ms >= 0 ? &timeout : NULL);
+    if (ret > 0 && FD_ISSET(fd, &errfds)) {
+        return -1;
+    }
+
+    return ret;
+}
+
+static int mqtt_tls_poll_read(esp_transport_handle_t t, int timeout_ms)
+{
+    return mqtt_tls_poll(t, timeout_ms, false);
+}
+
+static int mqtt_tls_poll_write(esp_transport_handle_t t, int timeout_ms)
+{
+    return mqtt_tls_poll(t, timeout_ms, true);
+}
+
+static int mqtt_tls_connect(esp_transport_handle_t t, const char *host, int port, int timeout_ms)
+{
+    mqtt_tls_ctx_t *ctx = esp_transport_get_context_data(t);
+
+    ctx->tls = esp_tls_init();
+    if (ctx->tls == NULL) {
+        return ERR_TCP_TRANSPORT_NO_MEM;
+    }
+
+    esp_tls_cfg_t cfg = {
+            .cacert_buf = (const unsigned char *) ctx->cacert,
+            .cacert_bytes = ctx->cacert_len,
+            .timeout_ms = timeout_ms,
+#if defined(CONFIG_MENJIN_MQTT_TLS_PSK)
+            .psk_hint_key = &g_psk,
+#endif
+#if defined(CONFIG_MENJIN_MQTT_TLS_PSK) || !defined(CONFIG_MENJIN_MQTT_TLS_CIPHERS_DEFAULT)
+            .ciphersuites_list = g_ciphersuites,
+#endif
+    };
+    mqtt_tls_session_src_t src = MQTT_TLS_SESSION_NONE;
+#ifdef MQTT_TLS_RESUME
+    if (g_session != NULL) {
+        cfg.client_session = g_session;
+        src = g_session_src;
+    }
+#endif
+
+    // 握手期间的最低空闲堆，其他任务同时分配的内存也计算在内
+    size_t heap_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    heap_caps_monitor_local_minimum_free_size_start();
+
+    int64_t start_us = esp_timer_get_time();
+    int ret = esp_tls_conn_new_sync(host, strlen(host), port, &cfg, ctx->tls);
+    uint32_t connect_ms = (esp_timer_get_time() - start_us) / 1000;
+
+    size_t heap_min = heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT);
+    heap_caps_monitor_local_minimum_free_size_stop();
+
+    if (ret <= 0) {
+        ESP_LOGE(TAG, "connect %s:%d failed after %lums", host, port, connect_ms);
+        esp_tls_conn_destroy(ctx->tls);
+        ctx->tls = NULL;
+        g_stats.failed++;
+#ifdef MQTT_TLS_RESUME
+        // 缓存的会话可能已失效，下次完整握手
+        if (src != MQTT_TLS_SESSION_NONE) {
+            session_drop();
+        }
+#endif
+        return -1;
+    }
+
+    g_stats.connects++;
+    g_stats.connect_ms = connect_ms;
+    g_stats.session = src;
+    g_stats.heap_before = heap_before;
+    g_stats.heap_handshake_peak = heap_before > heap_min ? heap_before - heap_min : 0;
+
+#ifdef MQTT_TLS_RESUME
+    // 握手中服务器可能签发了新票据，总是取最新的
+    esp_tls_client_session_t *session = esp_tls_get_client_session(ctx->tls);
+    if (session != NULL) {
+        if (g_session != NULL) {
+            esp_tls_free_client_session(g_session);
+        }
+        g_session = session;
+        g_session_src = MQTT_TLS_SESSION_RAM;
+        rtc_session_save(session);
+    }
+#endif
+
+    // 握手缓冲释放后仍占用的部分，会话缓存也计算在内
+    size_t heap_after = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    g_stats.heap_steady = heap_before > heap_after ? heap_before - heap_after : 0;
+
+    ESP_LOGI(TAG, "connected to %s:%d in %lums, session: %s, profile: %s, heap peak: %lu, steady: %lu",
+             host, port, connect_ms, mqtt_tls_session_src_name(src), mqtt_tls_profile_name(),
+             g_stats.heap_handshake_peak, g_stats.heap_steady);
+
+    return 0;
+}
+
+static int mqtt_tls_read(esp_transport_handle_t t, char *buffer, int len, int timeout_ms)
+{
+    mqtt_tls_ctx_t *ctx = esp_transport_get_context_data(t);
+
+    int poll = mqtt_tls_poll(t, timeout_ms, false);
+    if (poll < 0) {
+        return ERR_TCP_TRANSPORT_CONNECTION_FAILED;
+    }
+    if (poll == 0) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+
+    int ret = esp_tls_conn_read(ctx->tls, (unsigned char *) buffer, len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_READ || ret == ESP_TLS_ERR_SSL_TIMEOUT) {
+        return ERR_TCP_TRANSPORT_CONNECTION_TIMEOUT;
+    }
+    if (ret == 0) {
+        return ERR_TCP_TRANSPORT_CONNECTION_CLOSED_BY_FIN;
+    }
+
+    return ret < 0 ? ERR_TCP_TRANSPORT_CONNECTION_FAILED : ret;
+}
+
+static int mqtt_tls_write(esp_transport_handle_t t, const char *buffer, int len, int timeout_ms)
+{
+    mqtt_tls_ctx_t *ctx = esp_transport_get_context_data(t);
+
+    int poll = mqtt_tls_poll(t, timeout_ms, true);
+    if (poll <= 0) {
+        return poll;
+    }
+
+    int ret = esp_tls_conn_write(ctx->tls, (const unsigned char *) buffer, len);
+    if (ret == ESP_TLS_ERR_SSL_WANT_WRITE) {
+        return 0;
+    }
+
+    return ret;
+}
+
+static int mqtt_tls_close(esp_transport_handle_t t)
+{
+    mqtt_tls_ctx_t *ctx = esp_transport_get_context_data(t);
+
+    if (ctx->tls != NULL) {
+        esp_tls_conn_destroy(ctx->tls);
+        ctx->tls = NULL;
+    }
+
+    return 0;
+}
+
+static int mqtt_tls_destroy(esp_transport_handle_t t)
+{
+    mqtt_tls_close(t);
+    free(esp_transport_get_context_data(t));
+
+    return 0;
+}
+
+esp_transport_handle_t mqtt_tls_transport_create(const char *cacert, size_t cacert_len, const char *uri)
+{
+    mqtt_tls_ctx_t *ctx = calloc(1, sizeof(mqtt_tls_ctx_t));
+    esp_transport_handle_t t = esp_transport_init();
+    if (ctx == NULL || t == NULL) {
+        ESP_LOGE(TAG, "No memory for mqtt tls transport");
+        free(ctx);
+        if (t != NULL) {
+            esp_transport_destroy(t);
+        }
+        return NULL;
+    }
+
+    ctx->cacert = cacert;
+    ctx->cacert_len = cacert_len;
+    esp_transport_set_context_data(t, ctx);
+    esp_transport_set_func(t, mqtt_tls_connect, mqtt_tls_read, mqtt_tls_write, mqtt_tls_close,
+                           mqtt_tls_poll_read, mqtt_tls_poll_write, mqtt_tls_destroy);
+    esp_transport_set_default_port(t, MQTT_TLS_DEFAULT_PORT);
+
+#ifdef CONFIG_MENJIN_MQTT_TLS_PSK
+    const char *hex = CONFIG_MENJIN_MQTT_TLS_PSK_KEY;
+    for (size_t i = 0; i < PSK_KEY_LEN; ++i) {
+        char byte[3] = {hex[i * 2], hex[i * 2 + 1], '\0'};
+        g_psk_key[i] = strtoul(byte, NULL, 16);
+    }
+#endif
+
+    g_uri_crc = esp_rom_crc32_le(0, (const uint8_t *) uri, strlen(uri));
+#ifdef MQTT_TLS_RESUME
+    if (g_session == NULL) {
+        g_session = rtc_session_load();
+        g_session_src = MQTT_TLS_SESSION_RTC;
+        ESP_LOGI(TAG, "TLS session %s", g_session != NULL ? "restored from RTC memory" : "not cached");
+    }
+#endif
+
+    return t;
+}
+
+void mqtt_tls_get_stats(mqtt_tls_stats_t *stats)
+{
+    *stats = g_stats;
+}
+
+const char *mqtt_tls_profile_name(void)
+{
+#ifdef CONFIG_MENJIN_MQTT_TLS_LOW_MEM
+    return "lowmem";
+#else
+    return "default";
+#endif
+}
+
+const char *mqtt_tls_session_src_name(mqtt_tls_session_src_t src)
+{
+    switch (src) {
+        case MQTT_TLS_SESSION_RAM:
+            return "ram";
+        case MQTT_TLS_SESSION_RTC:
+            return "rtc";
+        default:
+            return "none";
+    }
+}
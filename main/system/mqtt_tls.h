@@ -0,0 +1,46 @@
+// mqtts transport on top of esp-tls that resumes the previous TLS session on reconnect.
+// The session is kept in RAM and, serialized, in RTC memory so it also survives soft reboots.
+// Also applies the TLS profile from Kconfig (cipher suites, PSK) and measures the heap used by
+// the handshake, see sdkconfig.defaults.tls_lowmem for the low-memory mbedTLS settings.
+
+#ifndef ESP_MENJIN_MQTT_TLS_H
+#define ESP_MENJIN_MQTT_TLS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_transport.h"
+
+typedef enum {
+    MQTT_TLS_SESSION_NONE = 0,              // full handshake
+    MQTT_TLS_SESSION_RAM,                   // offered the session of the previous connection
+    MQTT_TLS_SESSION_RTC,                   // offered the session saved before the last soft reboot
+} mqtt_tls_session_src_t;
+
+typedef struct {
+    uint32_t connect_ms;                    // DNS + TCP + TLS handshake of the last connection
+    mqtt_tls_session_src_t session;         // session offered for the last connection
+    uint32_t connects;
+    uint32_t failed;
+    // 8-bit heap, last connection
+    uint32_t heap_before;                   // free before connecting
+    uint32_t heap_handshake_peak;           // lowest free during the handshake, below heap_before
+    uint32_t heap_steady;                   // still held once connected
+} mqtt_tls_stats_t;
+
+/**
+ * @brief Create the transport, pass it as network.transport; esp-mqtt destroys it with the client
+ *
+ * @param cacert  PEM, including the terminating '\0', NULL with CONFIG_MENJIN_MQTT_TLS_PSK
+ * @param uri     broker URI, a saved session is only reused for the same URI
+ */
+esp_transport_handle_t mqtt_tls_transport_create(const char *cacert, size_t cacert_len, const char *uri);
+void mqtt_tls_get_stats(mqtt_tls_stats_t *stats);
+const char *mqtt_tls_session_src_name(mqtt_tls_session_src_t src);
+
+/**
+ * @brief Name of the TLS profile built in, "lowmem" or "default"
+ */
+const char *mqtt_tls_profile_name(void);
+
+#endif //ESP_MENJIN_MQTT_TLS_H
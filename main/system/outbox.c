@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "nvs.h"
+#include "sdkconfig.h"
+#include "outbox.h"
+
+static const char *TAG = "NOTIFY_OUTBOX";
+
+#define NAME_SPACE  "outbox"
+#define KEY_HEAD    "head"
+#define KEY_TAIL    "tail"
+
+static nvs_handle_t g_nvs = 0;
+static SemaphoreHandle_t g_lock = NULL;
+static outbox_stats_t g_stats = {0};
+
+static void entry_key(uint32_t seq, char *key, size_t size)
+{
+    snprintf(key, size, "e%02" PRIu32, seq % CONFIG_MENJIN_OUTBOX_LEN);
+}
+
+esp_err_t outbox_init(void)
+{
+    if (g_lock != NULL) {
+        return ESP_OK;
+    }
+
+    ESP_RETURN_ON_ERROR(nvs_open(NAME_SPACE, NVS_READWRITE, &g_nvs), TAG, "nvs open failed");
+
+    // 首次使用时不存在，从 0 开始
+    nvs_get_u32(g_nvs, KEY_HEAD, &g_stats.head);
+    nvs_get_u32(g_nvs, KEY_TAIL, &g_stats.tail);
+    if (g_stats.head - g_stats.tail > CONFIG_MENJIN_OUTBOX_LEN) {
+        ESP_LOGW(TAG, "invalid outbox range %" PRIu32 "..%" PRIu32 ", reset", g_stats.tail, g_stats.head);
+        g_stats.tail = g_stats.head;
+    }
+
+    g_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(g_lock != NULL, ESP_ERR_NO_MEM, TAG, "No memory for outbox lock");
+
+    ESP_LOGI(TAG, "outbox loaded, %" PRIu32 " entries queued, next seq: %" PRIu32, g_stats.head - g_stats.tail, g_stats.head);
+
+    return ESP_OK;
+}
+
+esp_err_t outbox_append(const char *data, size_t len, uint32_t *seq)
+{
+    ESP_RETURN_ON_FALSE(g_lock != NULL, ESP_ERR_INVALID_STATE, TAG, "outbox not initialized");
+    ESP_RETURN_ON_FALSE(len <= OUTBOX_DATA_MAX, ESP_ERR_INVALID_SIZE, TAG, "entry too long: %d", (int) len);
+
+    outbox_entry_t entry = {
+            .time = time(NULL),
+            .len = len,
+    };
+    memcpy(entry.data, data, len);
+    char key[8];
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+
+    uint32_t tail = g_stats.tail;
+    if (g_stats.head - tail >= CONFIG_MENJIN_OUTBOX_LEN) {
+        ESP_LOGW(TAG, "outbox full, evict seq %" PRIu32, tail);
+        tail++;
+    }
+
+    entry.seq = g_stats.head;
+    entry_key(entry.seq, key, sizeof(key));
+
+    esp_err_t ret = nvs_set_blob(g_nvs, key, &entry, offsetof(outbox_entry_t, data) + len);
+    if (ret == ESP_OK) {
+        ret = nvs_set_u32(g_nvs, KEY_HEAD, entry.seq + 1);
+    }
+    if (ret == ESP_OK && tail != g_stats.tail) {
+        ret = nvs_set_u32(g_nvs, KEY_TAIL, tail);
+    }
+    if (ret == ESP_OK) {
+        ret = nvs_commit(g_nvs);
+    }
+
+    if (ret == ESP_OK) {
+        g_stats.dropped += tail - g_stats.tail;
+        g_stats.tail = tail;
+        g_stats.head = entry.seq + 1;
+        g_stats.appended++;
+        if (seq != NULL) {
+            *seq = entry.seq;
+        }
+    } else {
+        g_stats.dropped++;
+    }
+
+    xSemaphoreGive(g_lock);
+
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "outbox append failed: %s", esp_err_to_name(ret));
+    }
+
+    return ret;
+}
+
+static esp_err_t entry_read(uint32_t seq, outbox_entry_t *entry)
+{
+    char key[8];
+    size_t len = sizeof(outbox_entry_t);
+
+    entry_key(seq, key, sizeof(key));
+    esp_err_t ret = nvs_get_blob(g_nvs, key, entry, &len);
+    if (ret != ESP_OK) {
+        ESP_LOGW(TAG, "outbox entry %" PRIu32 " unreadable: %s", seq, esp_err_to_name(ret));
+        return ret;
+    }
+    // 换过 CONFIG_MENJIN_OUTBOX_LEN 的固件会把同一个 key 对应到别的序号
+    if (entry->seq != seq) {
+        ESP_LOGW(TAG, "outbox entry %" PRIu32 " overwritten by %" PRIu32, seq, entry->seq);
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (len < offsetof(outbox_entry_t, data) || entry->len != len - offsetof(outbox_entry_t, data)) {
+        ESP_LOGW(TAG, "outbox entry %" PRIu32 " corrupt, %d bytes", seq, (int) len);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    return ESP_OK;
+}
+
+esp_err_t outbox_peek(uint32_t from_seq, outbox_entry_t *entry)
+{
+    ESP_RETURN_ON_FALSE(g_lock != NULL, ESP_ERR_INVALID_STATE, TAG, "outbox not initialized");
+
+    esp_err_t ret;
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+
+    while (true) {
+        uint32_t seq = (int32_t) (from_seq - g_stats.tail) > 0 ? from_seq : g_stats.tail;
+        if (seq == g_stats.head || (int32_t) (seq - g_stats.head) > 0) {
+            ret = ESP_ERR_NOT_FOUND;
+            break;
+        }
+        ret = entry_read(seq, entry);
+        if (ret == ESP_OK || seq != g_stats.tail) {
+            break;
+        }
+        // 读不出的最旧条目永远发不出去，算作丢弃并越过，否则整个 outbox 卡住
+        g_stats.tail = seq + 1;
+        g_stats.dropped++;
+        if (nvs_set_u32(g_nvs, KEY_TAIL, g_stats.tail) != ESP_OK || nvs_commit(g_nvs) != ESP_OK) {
+            ESP_LOGW(TAG, "outbox tail %" PRIu32 " not saved", g_stats.tail);
+        }
+    }
+
+    xSemaphoreGive(g_lock);
+
+    return ret;
+}
+
+esp_err_t outbox_ack(uint32_t seq)
+{
+    ESP_RETURN_ON_FALSE(g_lock != NULL, ESP_ERR_INVALID_STATE, TAG, "outbox not initialized");
+
+    esp_err_t ret = ESP_OK;
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+
+    uint32_t tail = seq + 1;
+    if ((int32_t) (tail - g_stats.head) > 0) {
+        tail = g_stats.head;
+    }
+    // 已被淘汰的条目不再确认
+    if ((int32_t) (tail - g_stats.tail) > 0) {
+        ret = nvs_set_u32(g_nvs, KEY_TAIL, tail);
+        if (ret == ESP_OK) {
+            ret = nvs_commit(g_nvs);
+        }
+        if (ret == ESP_OK) {
+            g_stats.delivered += tail - g_stats.tail;
+            g_stats.tail = tail;
+        }
+    }
+
+    xSemaphoreGive(g_lock);
+
+    return ret;
+}
+
+void outbox_get_stats(outbox_stats_t *stats)
+{
+    if (g_lock == NULL) {
+        memset(stats, 0, sizeof(outbox_stats_t));
+        return;
+    }
+
+    xSemaphoreTake(g_lock, portMAX_DELAY);
+    *stats = g_stats;
+    xSemaphoreGive(g_lock);
+    stats->queued = stats->head - stats->tail;
+}
@@ -0,0 +1,55 @@
+// Persistent notify outbox: an append-only ring log in NVS, survives broker outages and reboots.
+// Entries are numbered by a sequence that never goes back; once the log holds
+// CONFIG_MENJIN_OUTBOX_LEN entries the oldest one is evicted.
+
+#ifndef ESP_MENJIN_OUTBOX_H
+#define ESP_MENJIN_OUTBOX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#define OUTBOX_DATA_MAX     96
+
+typedef struct {
+    uint32_t seq;
+    uint32_t time;                          // unix time when queued
+    uint16_t len;
+    char data[OUTBOX_DATA_MAX];
+} outbox_entry_t;
+
+typedef struct {
+    uint32_t queued;                        // entries waiting for delivery now
+    uint32_t appended;                      // counters since boot
+    uint32_t delivered;
+    uint32_t dropped;                       // evicted before delivery, failed to store, or unreadable
+    uint32_t head;                          // next sequence number
+    uint32_t tail;                          // oldest undelivered sequence number
+} outbox_stats_t;
+
+esp_err_t outbox_init(void);
+
+/**
+ * @brief Append an entry, evicting the oldest one when the log is full
+ *
+ * @param seq optional, sequence number of the new entry
+ */
+esp_err_t outbox_append(const char *data, size_t len, uint32_t *seq);
+
+/**
+ * @brief Read the oldest undelivered entry with a sequence number >= from_seq
+ *
+ * The oldest entry is dropped and skipped when it cannot be read (missing, corrupt, or stored
+ * under another sequence number after CONFIG_MENJIN_OUTBOX_LEN changed), so it never blocks the log.
+ *
+ * @return ESP_ERR_NOT_FOUND when there is none, an error if a later entry cannot be read
+ */
+esp_err_t outbox_peek(uint32_t from_seq, outbox_entry_t *entry);
+
+/**
+ * @brief Mark every entry up to and including seq as delivered
+ */
+esp_err_t outbox_ack(uint32_t seq);
+void outbox_get_stats(outbox_stats_t *stats);
+
+#endif //ESP_MENJIN_OUTBOX_H
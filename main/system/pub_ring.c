@@ -0,0 +1,88 @@
+#include <string.h>
+#include "pub_ring.h"
+
+static pub_msg_t *ring_slot(pub_ring_t *ring, uint32_t pos)
+{
+    return (pub_msg_t *) (ring->slots + (size_t) (pos & (ring->capacity - 1)) * ring->slot_size);
+}
+
+void pub_ring_init(pub_ring_t *ring, void *slots, uint16_t capacity, uint16_t data_max)
+{
+    ring->slots = slots;
+    ring->slot_size = PUB_RING_SLOT_SIZE(data_max);
+    ring->capacity = capacity;
+    ring->tail = 0;
+    atomic_init(&ring->head, 0);
+
+    // seq == pos: 空闲，可由 pos 处的生产者占用；seq == pos + 1: 已写入，可读
+    for (uint32_t i = 0; i < capacity; ++i) {
+        atomic_init(&ring_slot(ring, i)->seq, i);
+    }
+}
+
+bool pub_ring_push(pub_ring_t *ring, uint8_t topic, uint8_t qos, uint32_t time_us, const char *data, size_t len)
+{
+    if (len > ring->slot_size - sizeof(pub_msg_t)) {
+        return false;
+    }
+
+    uint32_t pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    pub_msg_t *msg;
+
+    while (1) {
+        msg = ring_slot(ring, pos);
+        int32_t diff = (int32_t) (atomic_load_explicit(&msg->seq, memory_order_acquire) - pos);
+        if (diff == 0) {
+            // 失败时 pos 更新为最新的 head
+            if (atomic_compare_exchange_weak_explicit(&ring->head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return false;
+        } else {
+            pos = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        }
+    }
+
+    msg->time_us = time_us;
+    msg->len = len;
+    msg->topic = topic;
+    msg->qos = qos;
+    memcpy(msg->data, data, len);
+    atomic_store_explicit(&msg->seq, pos + 1, memory_order_release);
+
+    return true;
+}
+
+const pub_msg_t *pub_ring_peek_at(pub_ring_t *ring, uint32_t ahead)
+{
+    uint32_t pos = ring->tail + ahead;
+    if (ahead >= ring->capacity) {
+        return NULL;
+    }
+
+    pub_msg_t *msg = ring_slot(ring, pos);
+    if (atomic_load_explicit(&msg->seq, memory_order_acquire) != pos + 1) {
+        return NULL;
+    }
+
+    return msg;
+}
+
+const pub_msg_t *pub_ring_peek(pub_ring_t *ring)
+{
+    return pub_ring_peek_at(ring, 0);
+}
+
+void pub_ring_pop(pub_ring_t *ring)
+{
+    pub_msg_t *msg = ring_slot(ring, ring->tail);
+    atomic_store_explicit(&msg->seq, ring->tail + ring->capacity, memory_order_release);
+    ring->tail++;
+}
+
+uint32_t pub_ring_depth(pub_ring_t *ring)
+{
+    return atomic_load_explicit(&ring->head, memory_order_relaxed) - ring->tail;
+}
@@ -0,0 +1,66 @@
+// Bounded lock-free multi-producer / single-consumer message ring (per-slot sequence numbers).
+// Producers never block or take a lock, so it can be filled from the ring detect task or the
+// MQTT event task; a single publish task drains it. Slots have a fixed size set at init time.
+// Pure C11 atomics, no ESP-IDF dependency.
+
+#ifndef ESP_MENJIN_PUB_RING_H
+#define ESP_MENJIN_PUB_RING_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    atomic_uint seq;            // slot state, owned by the ring
+    uint32_t time_us;           // producer timestamp
+    uint16_t len;
+    uint8_t topic;
+    uint8_t qos;
+    char data[];
+} pub_msg_t;
+
+#define PUB_RING_SLOT_SIZE(data_max)    ((sizeof(pub_msg_t) + (data_max) + 3) & ~3u)
+
+typedef struct {
+    uint8_t *slots;
+    uint16_t slot_size;
+    uint16_t capacity;          // power of two
+    atomic_uint head;           // next position claimed by a producer
+    uint32_t tail;              // next position read by the consumer
+} pub_ring_t;
+
+/**
+ * @param slots    capacity * PUB_RING_SLOT_SIZE(data_max) bytes
+ * @param capacity power of two
+ */
+void pub_ring_init(pub_ring_t *ring, void *slots, uint16_t capacity, uint16_t data_max);
+
+/**
+ * @brief Copy a message into the ring, never blocks
+ *
+ * @return false if the ring is full or the message is longer than a slot
+ */
+bool pub_ring_push(pub_ring_t *ring, uint8_t topic, uint8_t qos, uint32_t time_us, const char *data, size_t len);
+
+/**
+ * @brief Oldest committed message, NULL if none; stays valid until pub_ring_pop(). Consumer only.
+ */
+const pub_msg_t *pub_ring_peek(pub_ring_t *ring);
+
+/**
+ * @brief Message `ahead` positions after the oldest one, NULL if not committed yet. Consumer only.
+ */
+const pub_msg_t *pub_ring_peek_at(pub_ring_t *ring, uint32_t ahead);
+
+/**
+ * @brief Release the message returned by pub_ring_peek(). Consumer only.
+ */
+void pub_ring_pop(pub_ring_t *ring);
+
+/**
+ * @brief Messages claimed but not popped yet, may include ones still being written
+ */
+uint32_t pub_ring_depth(pub_ring_t *ring);
+
+#endif //ESP_MENJIN_PUB_RING_H
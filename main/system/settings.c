@@ -8,6 +8,7 @@
 #include "nvs_flash.h"
 #include "nvs.h"
 #include "settings.h"
+#include "menjin_ring.h"
 
 static const char *TAG = "settings";
 
@@ -26,6 +27,11 @@ const sys_param_t g_default_sys_param = {
         .i2c_address = 0x50,
         .last_update_time = 0,
         .ring_adc_threshold = 1200,
+        .ring_adaptive = 0,
+        .ring_margin = 400,
+        .ring_baseline = 0,
+        // 免提 -> 3s -> 开锁 -> 2s -> 挂断
+        .macros = "open=97,3000,99,2000,97",
 };
 
 esp_err_t settings_read_parameter_from_nvs(void)
@@ -44,6 +50,8 @@ esp_err_t settings_read_parameter_from_nvs(void)
         goto err;
     }
 
+    // fields appended in newer firmware keep their default values when an older blob is loaded
+    memcpy(&g_sys_param, &g_default_sys_param, sizeof(sys_param_t));
     size_t len = sizeof(sys_param_t);
     ret = nvs_get_blob(my_handle, KEY, &g_sys_param, &len);
     if (ESP_OK != ret) {
@@ -64,6 +72,13 @@ esp_err_t settings_write_parameter_to_nvs(void)
 {
     ESP_LOGI(TAG, "Saving settings");
 
+    // 振铃检测任务只在统计里发布学习到的基线，保存时才写回设置
+    menjin_ring_stats_t ring;
+    menjin_get_ring_stats(&ring);
+    if (g_sys_param.ring_adaptive && ring.baseline > 0) {
+        g_sys_param.ring_baseline = ring.baseline;
+    }
+
     nvs_handle_t my_handle = {0};
     esp_err_t err = nvs_open(NAME_SPACE, NVS_READWRITE, &my_handle);
     if (err != ESP_OK) {
@@ -97,4 +112,8 @@ void settings_dump(void)
     ESP_LOGI(TAG, "\ti2c_clock: %d", g_sys_param.i2c_clock);
     ESP_LOGI(TAG, "\ti2c_address: %d", g_sys_param.i2c_address);
     ESP_LOGI(TAG, "\tring_adc_threshold: %lu", g_sys_param.ring_adc_threshold);
+    ESP_LOGI(TAG, "\tring_adaptive: %d", g_sys_param.ring_adaptive);
+    ESP_LOGI(TAG, "\tring_margin: %lu", g_sys_param.ring_margin);
+    ESP_LOGI(TAG, "\tring_baseline: %lu", g_sys_param.ring_baseline);
+    ESP_LOGI(TAG, "\tmacros: %s", g_sys_param.macros);
 }
\ No newline at end of file
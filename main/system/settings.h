@@ -17,6 +17,10 @@ typedef struct {
     uint8_t i2c_address;
     uint32_t last_update_time;
     uint32_t ring_adc_threshold;
+    uint8_t ring_adaptive;          // track the ADC baseline instead of the static threshold
+    uint32_t ring_margin;           // adaptive: arm at baseline + margin, disarm at baseline + margin / 2
+    uint32_t ring_baseline;         // adaptive: learned baseline, seeds the detector at boot
+    char macros[128];               // command sequences, see app_macro.h
 } sys_param_t;
 
 esp_err_t settings_read_parameter_from_nvs(void);
@@ -0,0 +1,225 @@
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "sdkconfig.h"
+#include "app_menjin.h"
+#include "menjin_ring.h"
+#include "mqtt.h"
+#include "telemetry.h"
+#include "json_writer.h"
+
+static const char *TAG = "TELEMETRY";
+
+#define TELEMETRY_TASK_PRIO     2
+#define TELEMETRY_JSON_LEN      1024
+
+// 计数器按组发送，组内顺序见 telemetry.h
+#define RING_COUNTERS           7
+#define BUS_COUNTERS            8
+#define PUB_COUNTERS            4
+#define GROUP_COUNTERS_MAX      8
+#define TELEMETRY_COUNTERS      (RING_COUNTERS + BUS_COUNTERS * 2 + PUB_COUNTERS)
+
+typedef struct {
+    const char *key;
+    uint8_t offset;
+    uint8_t count;
+} telemetry_group_t;
+
+static const telemetry_group_t g_groups[] = {
+        {"rg", 0,                                RING_COUNTERS},
+        {"m",  RING_COUNTERS,                    BUS_COUNTERS},
+        {"kb", RING_COUNTERS + BUS_COUNTERS,     BUS_COUNTERS},
+        {"pd", RING_COUNTERS + BUS_COUNTERS * 2, PUB_COUNTERS},
+};
+
+typedef struct {
+    const char *name;           // FreeRTOS 只保存前 15 个字符，按截断后的名字查找
+    const char *key;
+} telemetry_task_t;
+
+static const telemetry_task_t g_tasks[] = {
+        {"menjin_cmd_writ", "wr"},
+        {"keyboard_i2c_re", "kb"},
+        {"menjin_ring_det", "rd"},
+        {"key_event_handl", "ke"},
+        {"mqtt_task",       "mq"},
+        {"mqtt_cmd_worker", "cw"},
+        {"mqtt_pub_task",   "pb"},
+        {"telemetry_task",  "tm"},
+};
+
+#define TELEMETRY_TASKS (sizeof(g_tasks) / sizeof(g_tasks[0]))
+
+// 上一次成功发布时的值，增量相对它计算
+static uint32_t g_last_counters[TELEMETRY_COUNTERS];
+static uint32_t g_last_stack[TELEMETRY_TASKS];
+static uint32_t g_seq = 0;
+
+static uint8_t bus_counters(uint32_t *out, const i2c_health_stats_t *stats)
+{
+    out[0] = stats->ok;
+    out[1] = stats->nack;
+    out[2] = stats->timeout;
+    out[3] = stats->arb_lost;
+    out[4] = stats->stuck;
+    out[5] = stats->error;
+    out[6] = stats->recoveries;
+    out[7] = stats->recover_failed;
+
+    return BUS_COUNTERS;
+}
+
+static void telemetry_counters(uint32_t *out, const menjin_ring_stats_t *ring, const mqtt_pub_stats_t *pub)
+{
+    i2c_health_stats_t master, keyboard;
+    menjin_get_health_stats(&master, &keyboard);
+
+    out[0] = ring->detect.windows;
+    out[1] = ring->detect.on_windows;
+    out[2] = ring->detect.bursts;
+    out[3] = ring->detect.rejected;
+    out[4] = ring->detect.detections;
+    out[5] = ring->reported;
+    out[6] = ring->suppressed;
+    out += RING_COUNTERS;
+    out += bus_counters(out, &master);
+    out += bus_counters(out, &keyboard);
+    out[0] = pub[MQTT_PUB_LANE_EVENT].dropped;
+    out[1] = pub[MQTT_PUB_LANE_REPLY].dropped;
+    out[2] = pub[MQTT_PUB_LANE_BULK].dropped;
+    out[3] = pub[MQTT_PUB_LANE_BULK].coalesced;
+}
+
+static int append_counters(char *buf, size_t size, int len, const uint32_t *counters, bool keyframe)
+{
+    for (int g = 0; g < sizeof(g_groups) / sizeof(g_groups[0]); ++g) {
+        const telemetry_group_t *group = &g_groups[g];
+        uint32_t values[GROUP_COUNTERS_MAX];
+        bool changed = keyframe;
+
+        for (int i = 0; i < group->count; ++i) {
+            uint32_t value = counters[group->offset + i];
+            values[i] = keyframe ? value : value - g_last_counters[group->offset + i];
+            changed |= values[i] != 0;
+        }
+        if (!changed) {
+            continue;
+        }
+
+        len = json_appendf(buf, size, len, ",\"%s\":[", group->key);
+        for (int i = 0; i < group->count; ++i) {
+            len = json_appendf(buf, size, len, i > 0 ? ",%lu" : "%lu", values[i]);
+        }
+        len = json_appendf(buf, size, len, "]");
+    }
+
+    return len;
+}
+
+static int append_stacks(char *buf, size_t size, int len, uint32_t *marks, bool keyframe)
+{
+    int count = 0;
+
+    for (int i = 0; i < TELEMETRY_TASKS; ++i) {
+        TaskHandle_t task = xTaskGetHandle(g_tasks[i].name);
+        marks[i] = task != NULL ? uxTaskGetStackHighWaterMark(task) : 0;
+        if (marks[i] == 0 || (!keyframe && marks[i] == g_last_stack[i])) {
+            continue;
+        }
+        len = json_appendf(buf, size, len, "%s\"%s\":%lu", count++ > 0 ? "," : ",\"st\":{",
+                           g_tasks[i].key, marks[i]);
+    }
+    if (count > 0) {
+        len = json_appendf(buf, size, len, "}");
+    }
+
+    return len;
+}
+
+static void telemetry_publish(void)
+{
+    char json[TELEMETRY_JSON_LEN];
+    uint32_t counters[TELEMETRY_COUNTERS];
+    uint32_t marks[TELEMETRY_TASKS];
+    menjin_ring_stats_t ring;
+    mqtt_pub_stats_t pub[MQTT_PUB_LANE_MAX];
+    latency_hist_t hist;
+    wifi_ap_record_t ap;
+
+    bool keyframe = g_seq % CONFIG_MENJIN_TELEMETRY_KEYFRAME == 0;
+
+    menjin_get_ring_stats(&ring);
+    menjin_get_latency_hist(&hist);
+    mqtt_get_pub_stats(pub);
+    telemetry_counters(counters, &ring, pub);
+
+    int len = snprintf(json, sizeof(json), "{\"s\":%lu%s,\"up\":%lu,\"h\":[%lu,%lu,%u]",
+                       g_seq, keyframe ? ",\"k\":1" : "", (uint32_t) (esp_timer_get_time() / 1000000),
+                       esp_get_free_heap_size(), esp_get_minimum_free_heap_size(),
+                       heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+    if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+        len = json_appendf(json, sizeof(json), len, ",\"r\":%d", ap.rssi);
+    }
+    len = json_appendf(json, sizeof(json), len, ",\"rt\":[%lu,%lu,%lu]",
+                       ring.threshold, ring.baseline, ring.last_avg);
+    len = append_counters(json, sizeof(json), len, counters, keyframe);
+    if (hist.count > 0) {
+        len = json_appendf(json, sizeof(json), len, ",\"lat\":[%lu,%lu,%lu,%lu,%lu]",
+                           hist.count, latency_hist_percentile(&hist, 50), latency_hist_percentile(&hist, 90),
+                           latency_hist_percentile(&hist, 99), hist.max);
+    }
+    for (int i = 0; i < MQTT_PUB_LANE_MAX; ++i) {
+        len = json_appendf(json, sizeof(json), len, "%s[%lu,%lu,%lu,%lu]", i > 0 ? "," : ",\"pq\":[",
+                           pub[i].depth, pub[i].max_depth, pub[i].avg_latency_us, pub[i].max_latency_us);
+    }
+    len = json_appendf(json, sizeof(json), len, "]");
+    len = append_stacks(json, sizeof(json), len, marks, keyframe);
+    len = json_appendf(json, sizeof(json), len, "}");
+    if (len >= sizeof(json)) {
+        ESP_LOGW(TAG, "telemetry frame over %d bytes, dropped", (int) sizeof(json));
+        return;
+    }
+
+    // 未连接时保留上次的值，下一帧的增量覆盖这段时间
+    if (mqtt_publish_telemetry(json, len) != ESP_OK) {
+        return;
+    }
+
+    // 发出去才开始新的统计窗口，失败时这段延迟并入下一帧
+    menjin_consume_latency_hist(&hist);
+    memcpy(g_last_counters, counters, sizeof(g_last_counters));
+    memcpy(g_last_stack, marks, sizeof(g_last_stack));
+    g_seq++;
+    ESP_LOGD(TAG, "published %d bytes: %s", len, json);
+}
+
+_Noreturn static void telemetry_task(void *param)
+{
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (1) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(CONFIG_MENJIN_TELEMETRY_PERIOD_S * 1000));
+        telemetry_publish();
+    }
+}
+
+esp_err_t telemetry_init(void)
+{
+    if (CONFIG_MENJIN_TELEMETRY_PERIOD_S == 0) {
+        ESP_LOGI(TAG, "telemetry disabled");
+        return ESP_OK;
+    }
+
+    ESP_RETURN_ON_FALSE(xTaskCreate(telemetry_task, "telemetry_task", 3328, NULL, TELEMETRY_TASK_PRIO, NULL) == pdPASS,
+                        ESP_ERR_NO_MEM, TAG, "No memory for telemetry task");
+
+    return ESP_OK;
+}
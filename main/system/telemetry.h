@@ -0,0 +1,28 @@
+// Periodic device telemetry on menjin/<id>/telemetry, QoS 0.
+//
+// Payload is a short-key JSON object. Gauges are sent every time; counters are sent as deltas
+// since the previous frame and omitted when nothing changed. Every
+// CONFIG_MENJIN_TELEMETRY_KEYFRAME frames a keyframe ("k":1) carries absolute counters and all
+// stack marks, so a consumer can resync after missing frames (gaps show up in "s").
+//
+//   s    frame sequence since boot         up   uptime, seconds
+//   h    [free, min free, largest block]   r    AP RSSI, dBm
+//   rg   ring [windows, on windows, bursts, rejected, detections, reported, suppressed]
+//   rt   ring [threshold, baseline, last block average]
+//   m/kb master / keyboard bus [ok, nack, timeout, arb lost, stuck, error, recoveries, recover failed]
+//   pd   publish lanes [event dropped, reply dropped, bulk dropped, bulk coalesced]
+//   lat  command latency in this period, us [count, p50, p90, p99, max]
+//   pq   per publish lane [depth, max depth, avg latency us, max latency us]
+//   st   stack high-water marks in bytes, only when changed
+
+#ifndef ESP_MENJIN_TELEMETRY_H
+#define ESP_MENJIN_TELEMETRY_H
+
+#include "esp_err.h"
+
+/**
+ * @brief Start the telemetry task, does nothing if CONFIG_MENJIN_TELEMETRY_PERIOD_S is 0
+ */
+esp_err_t telemetry_init(void);
+
+#endif //ESP_MENJIN_TELEMETRY_H
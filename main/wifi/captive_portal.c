@@ -5,18 +5,32 @@
 #include <esp_log.h>
 #include <esp_wifi_types.h>
 #include <esp_wifi.h>
+#include <stdlib.h>
 #include <ctype.h>
 #include <sys/stat.h>
+#include <sys/param.h>
 #include <esp_check.h>
 #include <lwip/sockets.h>
-#include <cJSON.h>
 #include <esp_chip_info.h>
+#include <esp_timer.h>
 #include "captive_portal.h"
 #include "wifi_mgr.h"
+#include "scan_cache.h"
 #include "settings.h"
-#include "json_parser.h"
 #include "app_menjin.h"
+#include "menjin_ring.h"
+#include "app_macro.h"
+#ifdef CONFIG_MENJIN_BUS_SIM
+#include "menjin_sim.h"
+#endif
+#include "app_ring_capture.h"
 #include "mqtt.h"
+#include "web_bundle.h"
+#include "json_reader.h"
+#include "json_writer.h"
+#ifdef CONFIG_MENJIN_LAN_CTRL
+#include "lan_ctrl.h"
+#endif
 
 static const char *TAG = "CAPTIVE_PORTAL";
 
@@ -33,20 +47,72 @@ static const char *TAG = "CAPTIVE_PORTAL";
 
 #define FILE_PATH_MAX 255
 #define HTML_BUF_SIZE 2048
-#define SCRATCH_BUFSIZE 10240
+#define JSON_BUF_SIZE 512
+#define CONFIG_RECV_SIZE 128
 #define CHECK_FILE_EXTENSION(filename, ext) (strcasecmp(&filename[strlen(filename) - strlen(ext)], ext) == 0)
+// 带 ?v=<hash> 的资源内容不会变，缓存一年；其余每次用 ETag 验证
+#define CACHE_CONTROL_VERSIONED "public, max-age=31536000, immutable"
+#define CACHE_CONTROL_REVALIDATE "no-cache"
 
 static httpd_handle_t server = NULL;
 
 
 typedef struct rest_server_context {
     char base_path[FILE_PATH_MAX + 1];
-    char scratch[SCRATCH_BUFSIZE];
 } rest_server_context_t;
 
+// 构建时由 tools/web_assets.py 打包，嵌入固件
+extern const uint8_t web_assets_bin_start[] asm("_binary_web_assets_bin_start");
+extern const uint8_t web_assets_bin_end[]   asm("_binary_web_assets_bin_end");
+static bool g_web_bundle_valid = false;
+
+typedef struct {
+    httpd_req_t *req;
+    bool chunked;
+} json_resp_t;
+
+static int json_resp_flush(void *ctx, const char *data, size_t len, bool last)
+{
+    json_resp_t *resp = ctx;
+
+    // 一个缓冲区就装得下时不分块，直接带 Content-Length 发送
+    if (last && !resp->chunked) {
+        return httpd_resp_send(resp->req, data, len);
+    }
+    resp->chunked = true;
+    if (len > 0 && httpd_resp_send_chunk(resp->req, data, len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+
+    return last ? httpd_resp_send_chunk(resp->req, NULL, 0) : ESP_OK;
+}
+
+/* JSON response written straight into chunks through a buffer on the handler's stack */
+static void json_resp_start(json_writer_t *w, json_resp_t *resp, httpd_req_t *req, char *buf, size_t size)
+{
+    resp->req = req;
+    resp->chunked = false;
+    httpd_resp_set_type(req, "application/json");
+    json_writer_init(w, buf, size, json_resp_flush, resp);
+}
+
+static esp_err_t json_resp_finish(json_writer_t *w)
+{
+    ESP_RETURN_ON_FALSE(json_writer_finish(w) == 0, ESP_FAIL, TAG, "send json response failed");
+
+    return ESP_OK;
+}
+
 /* Set HTTP response content type according to file extension */
 static esp_err_t set_content_type_from_file(httpd_req_t *req, const char *filename)
 {
+    char name[FILE_PATH_MAX];
+    // 压缩版本按原文件类型
+    if (CHECK_FILE_EXTENSION(filename, ".gz")) {
+        strlcpy(name, filename, MIN(sizeof(name), strlen(filename) - strlen(".gz") + 1));
+        filename = name;
+    }
+
     const char *type = "text/plain";
     if (CHECK_FILE_EXTENSION(filename, ".html")) {
         type = "text/html";
@@ -64,6 +130,8 @@ static esp_err_t set_content_type_from_file(httpd_req_t *req, const char *filena
         type = "image/x-icon";
     } else if (CHECK_FILE_EXTENSION(filename, ".svg")) {
         type = "text/xml";
+    } else if (CHECK_FILE_EXTENSION(filename, ".bin")) {
+        type = "application/octet-stream";
     }
     return httpd_resp_set_type(req, type);
 }
@@ -151,73 +219,128 @@ static esp_err_t send_file_response(httpd_req_t *req, char* filename)
     return ret;
 }
 
+// 请求头里是否包含 token，header 不存在或过长时视为不包含
+static bool header_contains(httpd_req_t *req, const char *field, const char *token)
+{
+    char value[128];
+    size_t len = httpd_req_get_hdr_value_len(req, field);
+
+    if (len == 0 || len >= sizeof(value) || httpd_req_get_hdr_value_str(req, field, value, sizeof(value)) != ESP_OK) {
+        return false;
+    }
+
+    return strstr(value, token) != NULL;
+}
+
+/* Send a web UI asset from the bundle: ETag/If-None-Match, Cache-Control and the gzip variant when accepted */
+static esp_err_t send_asset_response(httpd_req_t *req, const web_bundle_asset_t *asset)
+{
+    char etag[24];
+    char query[32];
+    char version[WEB_BUNDLE_HASH_LEN + 4];
+
+    // 同一内容的压缩与未压缩版本共用弱 ETag
+    snprintf(etag, sizeof(etag), "W/\"%.*s\"", WEB_BUNDLE_HASH_LEN, asset->hash);
+    bool versioned = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+                     && httpd_query_key_value(query, "v", version, sizeof(version)) == ESP_OK
+                     && strlen(version) == WEB_BUNDLE_HASH_LEN
+                     && strncmp(version, asset->hash, WEB_BUNDLE_HASH_LEN) == 0;
+
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", versioned ? CACHE_CONTROL_VERSIONED : CACHE_CONTROL_REVALIDATE);
+
+    if (header_contains(req, "If-None-Match", etag + 2) || header_contains(req, "If-None-Match", "*")) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    set_content_type_from_file(req, asset->path);
+    const uint8_t *data = asset->data;
+    size_t len = asset->len;
+    if (asset->gz != NULL) {
+        httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+        if (header_contains(req, "Accept-Encoding", "gzip")) {
+            httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+            data = asset->gz;
+            len = asset->gz_len;
+        }
+    }
+
+    // 直接从 flash 映射发送，不拷贝
+    return httpd_resp_send(req, (const char *) data, len);
+}
+
 /* Send HTTP response with the contents of the requested file */
 static esp_err_t rest_common_get_handler(httpd_req_t *req)
 {
     char filepath[FILE_PATH_MAX];
 
     rest_server_context_t *rest_context = (rest_server_context_t *)req->user_ctx;
-    strlcpy(filepath, rest_context->base_path, sizeof(filepath));
-    if (req->uri[strlen(req->uri) - 1] == '/') {
+    const char *path = req->uri;
+    // 去掉查询串，?v=<hash> 只用于缓存
+    size_t path_len = strcspn(path, "?");
+    if (path_len == 0 || path[path_len - 1] == '/') {
         // try to handle captive portal request for root request.
         if (handle_captive_portal_request(req)) {
             return ESP_OK;
         }
-        strlcat(filepath, "/index.html", sizeof(filepath));
-    } else {
-        strlcat(filepath, req->uri, sizeof(filepath));
+        path = "/index.html";
+        path_len = strlen(path);
+    }
+
+    web_bundle_asset_t asset;
+    if (g_web_bundle_valid && web_bundle_find(web_assets_bin_start, path, path_len, &asset)) {
+        return send_asset_response(req, &asset);
     }
 
+    // 不在资源包里的按 SPIFFS 文件处理
+    snprintf(filepath, sizeof(filepath), "%s%.*s", rest_context->base_path, (int) path_len, path);
+
     return send_file_response(req, filepath);
 }
 
+// 直接返回缓存的扫描结果，?refresh=1 同时在后台重新扫描
 static esp_err_t scan_get_handler(httpd_req_t *req)
 {
-    esp_err_t ret = ESP_OK;
-    uint16_t number = 10;
-    uint16_t size = number * sizeof(wifi_ap_record_t);
-    wifi_ap_record_t *ap_info = malloc(number * sizeof(wifi_ap_record_t));
-    uint16_t ap_count = 0;
-    char *resp = NULL;
-    char json_obj[128];
-    uint16_t resp_buf_len;
-
-    memset(ap_info, 0, size);
-
-    ESP_GOTO_ON_ERROR(wifi_scan(number, ap_info, &ap_count), end, TAG, "wifi_scan failed");
-
-    httpd_resp_set_type(req, "text/html");
-
-    if (ap_count > 0) {
-        resp_buf_len = ap_count * (sizeof(ap_info->ssid) + 22);
-        resp = malloc(resp_buf_len);
-        memset(resp, 0, resp_buf_len);
-
-        resp[0] = '[';
-
-        int resp_len = 1;
-        for (int i = 0; (i < number) && (i < ap_count); i++) {
-            resp_len += sprintf(json_obj, "{\"ssid\":\"%s\", \"rssi\":%d}", ap_info[i].ssid, ap_info[i].rssi);
-            if (i > 0) {
-                strcat(resp, ",");
-                resp_len += 1;
-            }
-            strcat(resp, json_obj);
-        }
-        strcat(resp, "]");
-//        resp[resp_len+1] = '\0';
-        resp_len += 1;
-        ESP_LOGD(TAG, "resp: %s", resp);
-        ESP_RETURN_ON_ERROR(httpd_resp_send(req, resp, resp_len), TAG, "send response failed");
-        free(resp);
-    } else {
-        ESP_RETURN_ON_ERROR(httpd_resp_sendstr(req, "[]"), TAG, "send response failed");
+    char query[32];
+    char refresh[4];
+    scan_cache_status_t status;
+    scan_cache_ap_t *aps = malloc(SCAN_CACHE_MAX_AP * sizeof(scan_cache_ap_t));
+    char buf[JSON_BUF_SIZE];
+    json_writer_t w;
+    json_resp_t resp;
+
+    ESP_RETURN_ON_FALSE(aps != NULL, ESP_ERR_NO_MEM, TAG, "No memory for scan result");
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+        && httpd_query_key_value(query, "refresh", refresh, sizeof(refresh)) == ESP_OK
+        && strcmp(refresh, "1") == 0) {
+        scan_cache_refresh();
     }
 
-    end:
-    free(ap_info);
+    size_t count = scan_cache_get(aps, SCAN_CACHE_MAX_AP, &status);
+    int64_t now = esp_timer_get_time();
+
+    json_resp_start(&w, &resp, req, buf, sizeof(buf));
+    json_writer_object_start(&w, NULL);
+    // 距上次扫描完成的毫秒数，-1 表示还没有结果
+    json_writer_int(&w, "age_ms", status.updated_us > 0 ? (now - status.updated_us) / 1000 : -1);
+    json_writer_bool(&w, "scanning", status.scanning);
+    json_writer_array_start(&w, "aps");
+    for (size_t i = 0; i < count; i++) {
+        json_writer_object_start(&w, NULL);
+        json_writer_string(&w, "ssid", aps[i].ssid);
+        json_writer_int(&w, "rssi", aps[i].rssi);
+        json_writer_int(&w, "channel", aps[i].channel);
+        json_writer_int(&w, "auth", aps[i].authmode);
+        json_writer_int(&w, "age_ms", (now - aps[i].seen_us) / 1000);
+        json_writer_object_end(&w);
+    }
+    json_writer_array_end(&w);
+    json_writer_object_end(&w);
+    free(aps);
 
-    return ret;
+    return json_resp_finish(&w);
 }
 
 static esp_err_t captive_portal_handler(httpd_req_t *req)
@@ -285,41 +408,83 @@ static void async_wifi_connect(void* arg)
     vTaskDelete(NULL);
 }
 
-static const char* settings_to_json(cJSON *root)
+static const char *autotune_state_name(menjin_autotune_state_t state)
+{
+    switch (state) {
+        case MENJIN_AUTOTUNE_RUNNING:
+            return "running";
+        case MENJIN_AUTOTUNE_DONE:
+            return "done";
+        case MENJIN_AUTOTUNE_FAILED:
+            return "failed";
+        default:
+            return "idle";
+    }
+}
+
+static void autotune_to_json(json_writer_t *w, const char *key)
+{
+    menjin_autotune_result_t result;
+    menjin_get_autotune_result(&result);
+
+    json_writer_object_start(w, key);
+    json_writer_string(w, "state", autotune_state_name(result.state));
+    json_writer_int(w, "best_clock", result.best_clock);
+    json_writer_array_start(w, "rates");
+    for (int i = 0; i < result.count; ++i) {
+        json_writer_object_start(w, NULL);
+        json_writer_int(w, "clock", result.rates[i].clock);
+        json_writer_int(w, "probes", result.rates[i].probes);
+        json_writer_int(w, "errors", result.rates[i].errors);
+        json_writer_int(w, "avg_us", result.rates[i].avg_us);
+        json_writer_int(w, "max_us", result.rates[i].max_us);
+        json_writer_object_end(w);
+    }
+    json_writer_array_end(w);
+    json_writer_object_end(w);
+}
+
+static void settings_to_json(json_writer_t *w)
 {
     wifi_config_t wifiConfig;
     esp_wifi_get_config(WIFI_IF_STA, &wifiConfig);
     sys_param_t *settings = settings_get_parameter();
 
-    cJSON_AddStringToObject(root, "wifi_ssid", (char*)wifiConfig.sta.ssid);
-    cJSON_AddStringToObject(root, "wifi_password", (char*)wifiConfig.sta.password);
-    cJSON_AddNumberToObject(root, "wifi_channel", wifiConfig.sta.channel);
+    json_writer_object_start(w, NULL);
+    json_writer_string(w, "wifi_ssid", (char*)wifiConfig.sta.ssid);
+    json_writer_string(w, "wifi_password", (char*)wifiConfig.sta.password);
+    json_writer_int(w, "wifi_channel", wifiConfig.sta.channel);
     // add mqtt configs
-    cJSON_AddStringToObject(root, "mqtt_client_id", settings->mqtt_client_id);
-    cJSON_AddStringToObject(root, "mqtt_url", settings->mqtt_url);
-    cJSON_AddStringToObject(root, "mqtt_username", settings->mqtt_username);
-    cJSON_AddStringToObject(root, "mqtt_password", settings->mqtt_password);
+    json_writer_string(w, "mqtt_client_id", settings->mqtt_client_id);
+    json_writer_string(w, "mqtt_url", settings->mqtt_url);
+    json_writer_string(w, "mqtt_username", settings->mqtt_username);
+    json_writer_string(w, "mqtt_password", settings->mqtt_password);
     // add i2c configs
-    cJSON_AddNumberToObject(root, "i2c_clock", settings->i2c_clock);
-    cJSON_AddNumberToObject(root, "i2c_address", settings->i2c_address);
+    json_writer_int(w, "i2c_clock", settings->i2c_clock);
+    json_writer_int(w, "i2c_address", settings->i2c_address);
+    autotune_to_json(w, "i2c_autotune");
     // add other configs
-    cJSON_AddNumberToObject(root, "ring_adc_threshold", settings->ring_adc_threshold);
-    const char *sys_info = cJSON_Print(root);
-
-    return sys_info;
+    json_writer_int(w, "ring_adc_threshold", settings->ring_adc_threshold);
+    json_writer_bool(w, "ring_adaptive", settings->ring_adaptive);
+    json_writer_int(w, "ring_margin", settings->ring_margin);
+    menjin_ring_stats_t ring;
+    menjin_get_ring_stats(&ring);
+    json_writer_int(w, "ring_baseline", ring.baseline > 0 ? ring.baseline : settings->ring_baseline);
+    json_writer_int(w, "ring_tone_hz", ring.tone_hz);
+    json_writer_string(w, "macros", settings->macros);
+    json_writer_object_end(w);
 }
 
 static esp_err_t config_get_handler(httpd_req_t  *req)
 {
-    httpd_resp_set_type(req, "application/json");
+    char buf[JSON_BUF_SIZE];
+    json_writer_t w;
+    json_resp_t resp;
 
-    cJSON *root = cJSON_CreateObject();
-    const char *sys_info = settings_to_json(root);
-    httpd_resp_sendstr(req, sys_info);
-    free((void *)sys_info);
-    cJSON_Delete(root);
+    json_resp_start(&w, &resp, req, buf, sizeof(buf));
+    settings_to_json(&w);
 
-    return ESP_OK;
+    return json_resp_finish(&w);
 }
 
 static void restart_task(void *arg)
@@ -337,73 +502,124 @@ esp_err_t api_handler_restart(httpd_req_t *req)
     return ESP_OK;
 }
 
-static esp_err_t config_post_handler(httpd_req_t *req)
+typedef struct {
+    sys_param_t settings;
+    wifi_config_t wifi;
+    bool macros_changed;
+} config_staged_t;
+
+static void config_set_string(char *dst, size_t size, const char *key, const json_reader_value_t *value)
 {
-    int total_len = req->content_len;
-    int cur_len = 0;
-    char *buf = ((rest_server_context_t *)(req->user_ctx))->scratch;
-    int received = 0;
-    if (total_len >= SCRATCH_BUFSIZE) {
-        /* Respond with 500 Internal Server Error */
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "content too long");
-        return ESP_FAIL;
+    if (value->type != JSON_READER_STRING || value->truncated || value->len >= size) {
+        ESP_LOGW(TAG, "config %s ignored", key);
+        return;
+    }
+    memcpy(dst, value->str, value->len + 1);
+}
+
+static void config_set_int(void *dst, size_t size, const char *key, const json_reader_value_t *value)
+{
+    if (value->type != JSON_READER_NUMBER) {
+        ESP_LOGW(TAG, "config %s ignored", key);
+        return;
+    }
+    if (size == sizeof(uint8_t)) {
+        *(uint8_t *) dst = value->num;
+    } else {
+        *(uint32_t *) dst = value->num;
+    }
+}
+
+// 边接收边解析，识别的字段直接写入暂存的配置
+static void config_on_value(void *ctx, const char *key, const json_reader_value_t *value)
+{
+    config_staged_t *staged = ctx;
+    sys_param_t *settings = &staged->settings;
+
+    if (strcmp(key, "wifi_ssid") == 0) {
+        config_set_string((char *) staged->wifi.sta.ssid, sizeof(staged->wifi.sta.ssid), key, value);
+    } else if (strcmp(key, "wifi_password") == 0) {
+        config_set_string((char *) staged->wifi.sta.password, sizeof(staged->wifi.sta.password), key, value);
+    } else if (strcmp(key, "mqtt_url") == 0) {
+        config_set_string(settings->mqtt_url, sizeof(settings->mqtt_url), key, value);
+    } else if (strcmp(key, "mqtt_username") == 0) {
+        config_set_string(settings->mqtt_username, sizeof(settings->mqtt_username), key, value);
+    } else if (strcmp(key, "mqtt_password") == 0) {
+        config_set_string(settings->mqtt_password, sizeof(settings->mqtt_password), key, value);
+    } else if (strcmp(key, "i2c_clock") == 0) {
+        config_set_int(&settings->i2c_clock, sizeof(settings->i2c_clock), key, value);
+    } else if (strcmp(key, "i2c_address") == 0) {
+        config_set_int(&settings->i2c_address, sizeof(settings->i2c_address), key, value);
+    } else if (strcmp(key, "ring_adc_threshold") == 0) {
+        config_set_int(&settings->ring_adc_threshold, sizeof(settings->ring_adc_threshold), key, value);
+    } else if (strcmp(key, "ring_margin") == 0) {
+        config_set_int(&settings->ring_margin, sizeof(settings->ring_margin), key, value);
+    } else if (strcmp(key, "ring_adaptive") == 0) {
+        if (value->type == JSON_READER_BOOL) {
+            settings->ring_adaptive = value->num;
+        }
+    } else if (strcmp(key, "macros") == 0) {
+        config_set_string(settings->macros, sizeof(settings->macros), key, value);
+        staged->macros_changed = true;
     }
-    while (cur_len < total_len) {
-        received = httpd_req_recv(req, buf + cur_len, total_len);
+}
+
+static bool config_macros_valid(const char *str)
+{
+    app_macro_t macros[APP_MACRO_MAX];
+
+    return app_macro_parse(str, macros, APP_MACRO_MAX) >= 0;
+}
+
+static esp_err_t config_post_handler(httpd_req_t *req)
+{
+    char buf[CONFIG_RECV_SIZE];
+    json_reader_t reader;
+    sys_param_t *settings = settings_get_parameter();
+    config_staged_t staged = {.settings = *settings};
+    int remaining = req->content_len;
+    esp_err_t ret = ESP_OK;
+
+    json_reader_init(&reader, config_on_value, &staged);
+    while (remaining > 0) {
+        int received = httpd_req_recv(req, buf, MIN(remaining, sizeof(buf)));
+        if (received == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
         if (received <= 0) {
             /* Respond with 500 Internal Server Error */
             httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to post control value");
             return ESP_FAIL;
         }
-        cur_len += received;
+        remaining -= received;
+        if (json_reader_feed(&reader, buf, received) != 0) {
+            break;
+        }
     }
-    buf[total_len] = '\0';
-    ESP_LOGI(TAG, "Request body: %s", buf);
-
-    esp_err_t ret = ESP_OK;
-
-    jparse_ctx_t *jctx = NULL;
-    jctx = (jparse_ctx_t *)malloc(sizeof(jparse_ctx_t));
-    ret = json_parse_start(jctx, buf, req->content_len);
-    if (ret != OS_SUCCESS) {
-        ESP_LOGE(TAG, "json_parse_start failed\n");
+    if (json_reader_finish(&reader) != 0) {
+        ESP_LOGE(TAG, "json parse failed");
         httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "json parse failed");
         return ESP_FAIL;
     }
-    sys_param_t *settings = settings_get_parameter();
-    char str_val[128] = {0};
-    if (json_obj_get_string(jctx, "mqtt_url", (char *) &str_val, sizeof(settings->mqtt_url)) == OS_SUCCESS) {
-        strcpy(settings->mqtt_url, str_val);
-    }
-    if (json_obj_get_string(jctx, "mqtt_username", (char *) &str_val, sizeof(settings->mqtt_username)) == OS_SUCCESS) {
-        strcpy(settings->mqtt_username, str_val);
-    }
-    if (json_obj_get_string(jctx, "mqtt_password", (char *) &str_val, sizeof(settings->mqtt_password)) == OS_SUCCESS) {
-        strcpy(settings->mqtt_password, str_val);
-    }
-    int int_val;
-    if (json_obj_get_int(jctx, "i2c_clock", &int_val) == OS_SUCCESS) {
-        settings->i2c_clock = int_val;
-    }
-    if (json_obj_get_int(jctx, "i2c_address", &int_val) == OS_SUCCESS) {
-        settings->i2c_address = int_val;
-    }
-    if (json_obj_get_int(jctx, "ring_adc_threshold", &int_val) == OS_SUCCESS) {
-        settings->ring_adc_threshold = int_val;
-    }
 
-    wifi_config_t wifi_cfg = {0};
-    json_obj_get_string(jctx, "wifi_ssid", (char *) &wifi_cfg.sta.ssid, sizeof(wifi_cfg.sta.ssid));
-    json_obj_get_string(jctx, "wifi_password", (char *) &wifi_cfg.sta.password, sizeof(wifi_cfg.sta.password));
+    if (staged.macros_changed && !config_macros_valid(staged.settings.macros)) {
+        ESP_LOGW(TAG, "invalid macros ignored: %s", staged.settings.macros);
+        strcpy(staged.settings.macros, settings->macros);
+        staged.macros_changed = false;
+    }
 
     // 至少要有wifi ssid
-    if (strlen((char*)wifi_cfg.sta.ssid) > 0) {
+    if (strlen((char*)staged.wifi.sta.ssid) > 0) {
         ESP_LOGI(TAG, "WiFi settings accepted!");
 
         httpd_resp_set_type(req, "text/html");
         if (esp_wifi_set_storage(WIFI_STORAGE_FLASH) == ESP_OK &&
-            esp_wifi_set_config(WIFI_IF_STA, &wifi_cfg) == ESP_OK) {
+            esp_wifi_set_config(WIFI_IF_STA, &staged.wifi) == ESP_OK) {
             ESP_LOGI(TAG, "WiFi settings applied and stored to flash");
+            *settings = staged.settings;
+            if (staged.macros_changed) {
+                app_macro_reload(settings->macros);
+            }
             settings_dump();
             if (settings_write_parameter_to_nvs() != ESP_OK) {
                 ESP_LOGE(TAG, "Save settings failed");
@@ -481,15 +697,8 @@ esp_err_t api_handler_menjin_cmd(httpd_req_t *req)
             esp_err_t cmd_ret = ESP_OK;
 
             if (cmd >= MENJIN_CMD_KEY4_SPEAKER && cmd <= MENJIN_CMD_KEY1) {
-                cmd_ret = menjin_cmd_write(cmd);
-                ESP_LOGI(TAG, "[api_handler_menjin_cmd] menjin_cmd_write(%d) => %d", cmd, cmd_ret);
-            } else if (strcmp(param, "open") == 0) {
-                cmd_ret = menjin_cmd_write(MENJIN_CMD_KEY4_SPEAKER);
-                ESP_LOGI(TAG, "[api_handler_menjin_cmd] menjin_cmd_write(%d) => %d", MENJIN_CMD_KEY4_SPEAKER, cmd_ret);
-                cmd_ret = menjin_cmd_write(MENJIN_CMD_KEY3_UNLOCK);
-                ESP_LOGI(TAG, "[api_handler_menjin_cmd] menjin_cmd_write(%d) => %d", MENJIN_CMD_KEY3_UNLOCK, cmd_ret);
-                cmd_ret = menjin_cmd_write(MENJIN_CMD_KEY4_SPEAKER);
-                ESP_LOGI(TAG, "[api_handler_menjin_cmd] menjin_cmd_write(%d) => %d", MENJIN_CMD_KEY4_SPEAKER, cmd_ret);
+                cmd_ret = menjin_cmd_enqueue(cmd, MENJIN_PRIO_REMOTE, NULL, NULL);
+                ESP_LOGI(TAG, "[api_handler_menjin_cmd] menjin_cmd_enqueue(%d) => %d", cmd, cmd_ret);
             } else if (strcmp(param, "set_clock") == 0) {
                 if (httpd_query_key_value(buf, "value", param, sizeof(param)) == ESP_OK) {
                     int clock = atoi(param);
@@ -500,6 +709,7 @@ esp_err_t api_handler_menjin_cmd(httpd_req_t *req)
                     } else {
                         int old_clock = settings->i2c_clock;
                         settings->i2c_clock = clock;
+                        menjin_set_clock(clock);
                         cmd_ret = settings_write_parameter_to_nvs();
                         if (cmd_ret != ESP_OK) {
                             ESP_LOGE(TAG, "[api_handler_menjin_cmd] set_clock settings_write_parameter_to_nvs failed: %d", cmd_ret);
@@ -511,12 +721,25 @@ esp_err_t api_handler_menjin_cmd(httpd_req_t *req)
                     resp_str = "param 'value' not found";
                     ESP_LOGW(TAG, "[api_handler_menjin_cmd] request menjin set_clock without value param");
                 }
+            } else if (strcmp(param, "autotune") == 0) {
+                cmd_ret = menjin_autotune_start();
+                ESP_LOGI(TAG, "[api_handler_menjin_cmd] menjin_autotune_start() => %d", cmd_ret);
+            } else {
+                // 其余按宏名称处理，如 "open"
+                cmd_ret = app_macro_run(param, MENJIN_PRIO_REMOTE);
+                ESP_LOGI(TAG, "[api_handler_menjin_cmd] app_macro_run(%s) => %d", param, cmd_ret);
             }
             buf[0] = '\0';
 
-            if (cmd_ret != ESP_OK) {
+            if (cmd_ret == ESP_ERR_NOT_FOUND) {
+                httpd_resp_set_status(req, "400 Bad Request");
+                resp_str = "unknown cmd";
+            } else if (cmd_ret == ESP_ERR_INVALID_STATE) {
+                httpd_resp_set_status(req, "409 Conflict");
+                resp_str = "busy";
+            } else if (cmd_ret != ESP_OK) {
                 httpd_resp_set_status(req, "500 Server Internal Error");
-                sprintf(buf, "menjin_cmd_write failed: %d", cmd_ret);
+                sprintf(buf, "menjin cmd failed: %d", cmd_ret);
                 resp_str = (char *) &buf;
             }
 
@@ -539,6 +762,194 @@ esp_err_t api_handler_menjin_cmd(httpd_req_t *req)
 }
 
 
+static void health_stats_to_json(json_writer_t *w, const char *name, const i2c_health_stats_t *stats)
+{
+    json_writer_object_start(w, name);
+    json_writer_int(w, "ok", stats->ok);
+    json_writer_int(w, "nack", stats->nack);
+    json_writer_int(w, "timeout", stats->timeout);
+    json_writer_int(w, "arb_lost", stats->arb_lost);
+    json_writer_int(w, "stuck", stats->stuck);
+    json_writer_int(w, "error", stats->error);
+    json_writer_int(w, "recoveries", stats->recoveries);
+    json_writer_int(w, "recover_failed", stats->recover_failed);
+    json_writer_object_end(w);
+}
+
+static esp_err_t api_menjin_stats_get_handler(httpd_req_t *req)
+{
+    menjin_queue_stats_t stats;
+    menjin_get_queue_stats(&stats);
+
+    char buf[JSON_BUF_SIZE];
+    json_writer_t w;
+    json_resp_t resp;
+
+    json_resp_start(&w, &resp, req, buf, sizeof(buf));
+    json_writer_object_start(&w, NULL);
+    json_writer_object_start(&w, "queue");
+    json_writer_int(&w, "enqueued", stats.enqueued);
+    json_writer_int(&w, "completed", stats.completed);
+    json_writer_int(&w, "failed", stats.failed);
+    json_writer_int(&w, "dropped", stats.dropped);
+    json_writer_int(&w, "depth_key", stats.depth[MENJIN_PRIO_KEY]);
+    json_writer_int(&w, "depth_remote", stats.depth[MENJIN_PRIO_REMOTE]);
+    json_writer_int(&w, "max_depth_key", stats.max_depth[MENJIN_PRIO_KEY]);
+    json_writer_int(&w, "max_depth_remote", stats.max_depth[MENJIN_PRIO_REMOTE]);
+    json_writer_int(&w, "last_latency_us", stats.last_latency_us);
+    json_writer_int(&w, "avg_latency_us", stats.avg_latency_us);
+    json_writer_int(&w, "max_latency_us", stats.max_latency_us);
+    json_writer_int(&w, "last_bus_us", stats.last_bus_us);
+    json_writer_int(&w, "max_bus_us", stats.max_bus_us);
+    json_writer_object_end(&w);
+
+    menjin_bridge_stats_t bridge_stats;
+    menjin_get_bridge_stats(&bridge_stats);
+    json_writer_object_start(&w, "bridge");
+    json_writer_int(&w, "rx_bytes", bridge_stats.rx_bytes);
+    json_writer_int(&w, "rx_frames", bridge_stats.rx_frames);
+    json_writer_int(&w, "dropped", bridge_stats.dropped);
+    json_writer_int(&w, "tx_bytes", bridge_stats.tx_bytes);
+    json_writer_int(&w, "tx_frames", bridge_stats.tx_frames);
+    json_writer_int(&w, "tx_failed", bridge_stats.tx_failed);
+    json_writer_int(&w, "max_frame_len", bridge_stats.max_frame_len);
+    json_writer_int(&w, "last_latency_us", bridge_stats.last_latency_us);
+    json_writer_int(&w, "avg_latency_us", bridge_stats.avg_latency_us);
+    json_writer_int(&w, "max_latency_us", bridge_stats.max_latency_us);
+    json_writer_object_end(&w);
+
+    i2c_health_stats_t master_health, keyboard_health;
+    menjin_get_health_stats(&master_health, &keyboard_health);
+    json_writer_object_start(&w, "health");
+    health_stats_to_json(&w, "master", &master_health);
+    health_stats_to_json(&w, "keyboard", &keyboard_health);
+    json_writer_object_end(&w);
+
+#ifdef CONFIG_MENJIN_LAN_CTRL
+    lan_ctrl_stats_t lan_stats;
+    lan_ctrl_get_stats(&lan_stats);
+    json_writer_object_start(&w, "lan");
+    json_writer_int(&w, "received", lan_stats.received);
+    json_writer_int(&w, "accepted", lan_stats.accepted);
+    json_writer_int(&w, "malformed", lan_stats.malformed);
+    json_writer_int(&w, "bad_auth", lan_stats.bad_auth);
+    json_writer_int(&w, "replay", lan_stats.replay);
+    json_writer_int(&w, "rejected", lan_stats.rejected);
+    json_writer_int(&w, "last_ack_us", lan_stats.last_ack_us);
+    json_writer_int(&w, "avg_ack_us", lan_stats.avg_ack_us);
+    json_writer_int(&w, "max_ack_us", lan_stats.max_ack_us);
+    json_writer_object_end(&w);
+#endif
+    json_writer_object_end(&w);
+
+    return json_resp_finish(&w);
+}
+
+#ifdef CONFIG_MENJIN_BUS_SIM
+// ?inject=97,99 以键盘身份写入字节，返回模拟主控收到的命令
+static esp_err_t api_menjin_sim_get_handler(httpd_req_t *req)
+{
+    char query[128];
+    char value[96];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK
+        && httpd_query_key_value(query, "inject", value, sizeof(value)) == ESP_OK) {
+        uint8_t data[32];
+        size_t len = 0;
+        char *p = value;
+        while (*p != '\0' && len < sizeof(data)) {
+            data[len++] = strtoul(p, &p, 0);
+            if (*p != ',') {
+                break;
+            }
+            p++;
+        }
+        size_t sent = menjin_sim_keyboard_inject(data, len);
+        ESP_LOGI(TAG, "[sim] keyboard inject %d/%d bytes", sent, len);
+    }
+
+    menjin_sim_record_t *records = malloc(MENJIN_SIM_LOG_LEN * sizeof(menjin_sim_record_t));
+    if (records == NULL) {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "no memory");
+        return ESP_FAIL;
+    }
+    size_t count = menjin_sim_controller_log(records, MENJIN_SIM_LOG_LEN);
+
+    char buf[JSON_BUF_SIZE];
+    json_writer_t w;
+    json_resp_t resp;
+
+    json_resp_start(&w, &resp, req, buf, sizeof(buf));
+    json_writer_array_start(&w, NULL);
+    for (size_t i = 0; i < count; ++i) {
+        json_writer_object_start(&w, NULL);
+        json_writer_int(&w, "time_us", records[i].time_us);
+        json_writer_int(&w, "addr", records[i].addr);
+        json_writer_int(&w, "ret", records[i].ret);
+        json_writer_array_start(&w, "data");
+        for (int j = 0; j < records[i].len; ++j) {
+            json_writer_int(&w, NULL, records[i].data[j]);
+        }
+        json_writer_array_end(&w);
+        json_writer_object_end(&w);
+    }
+    json_writer_array_end(&w);
+    free(records);
+
+    return json_resp_finish(&w);
+}
+#endif
+
+static esp_err_t api_ring_captures_get_handler(httpd_req_t *req)
+{
+    app_ring_capture_info_t infos[CONFIG_MENJIN_RING_CAPTURE_FILES];
+    int count = app_ring_capture_list(infos, CONFIG_MENJIN_RING_CAPTURE_FILES);
+
+    char buf[JSON_BUF_SIZE];
+    json_writer_t w;
+    json_resp_t resp;
+
+    json_resp_start(&w, &resp, req, buf, sizeof(buf));
+    json_writer_array_start(&w, NULL);
+    for (int i = 0; i < count; ++i) {
+        json_writer_object_start(&w, NULL);
+        json_writer_int(&w, "id", infos[i].id);
+        json_writer_int(&w, "seq", infos[i].seq);
+        json_writer_int(&w, "timestamp", infos[i].timestamp);
+        json_writer_int(&w, "sample_rate", infos[i].sample_rate_hz);
+        json_writer_int(&w, "samples", infos[i].samples);
+        json_writer_int(&w, "trigger", infos[i].trigger);
+        json_writer_int(&w, "size", infos[i].size);
+        json_writer_bool(&w, "detected", infos[i].detected);
+        json_writer_bool(&w, "rejected", infos[i].rejected);
+        json_writer_object_end(&w);
+    }
+    json_writer_array_end(&w);
+
+    return json_resp_finish(&w);
+}
+
+static esp_err_t api_ring_capture_get_handler(httpd_req_t *req)
+{
+    char query[32];
+    char param[8];
+    char filepath[FILE_PATH_MAX];
+
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK
+        || httpd_query_key_value(query, "id", param, sizeof(param)) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "param 'id' not found");
+    }
+
+    if (app_ring_capture_path(atoi(param), filepath, sizeof(filepath)) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "param 'id' exceeds range");
+    }
+
+    char disposition[48];
+    snprintf(disposition, sizeof(disposition), "attachment; filename=\"%s\"", strrchr(filepath, '/') + 1);
+    httpd_resp_set_hdr(req, "Content-Disposition", disposition);
+
+    return send_file_response(req, filepath);
+}
+
 esp_err_t start_captive_portal(const char *base_path)
 {
     REST_CHECK(base_path, "wrong base path", err);
@@ -546,6 +957,15 @@ esp_err_t start_captive_portal(const char *base_path)
     REST_CHECK(rest_context, "No memory for rest context", err);
     strlcpy(rest_context->base_path, base_path, sizeof(rest_context->base_path));
 
+    g_web_bundle_valid = web_bundle_check(web_assets_bin_start, web_assets_bin_end - web_assets_bin_start);
+    if (!g_web_bundle_valid) {
+        ESP_LOGE(TAG, "Web asset bundle is corrupt, web UI unavailable");
+    }
+
+    if (scan_cache_init() != ESP_OK) {
+        ESP_LOGE(TAG, "Wi-Fi scan cache unavailable, /api/scan stays empty");
+    }
+
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.max_open_sockets = CONFIG_LWIP_MAX_SOCKETS - 3;
     config.lru_purge_enable = true;
@@ -603,6 +1023,28 @@ esp_err_t start_captive_portal(const char *base_path)
                 .method   = HTTP_GET,
                 .handler  = api_handler_menjin_cmd,
             },
+            {
+                .uri      = "/api/menjin/stats",
+                .method   = HTTP_GET,
+                .handler  = api_menjin_stats_get_handler,
+            },
+#ifdef CONFIG_MENJIN_BUS_SIM
+            {
+                .uri      = "/api/menjin/sim",
+                .method   = HTTP_GET,
+                .handler  = api_menjin_sim_get_handler,
+            },
+#endif
+            {
+                .uri      = "/api/ring/captures",
+                .method   = HTTP_GET,
+                .handler  = api_ring_captures_get_handler,
+            },
+            {
+                .uri      = "/api/ring/capture",
+                .method   = HTTP_GET,
+                .handler  = api_ring_capture_get_handler,
+            },
             {
                 .uri = "/*",
                 .method = HTTP_GET,
@@ -0,0 +1,416 @@
+#include <string.h>
+#include "json_reader.h"
+
+enum {
+    ST_START = 0,       // before '{'
+    ST_FIRST,           // after '{': key or '}'
+    ST_MEMBER,          // after ',': key
+    ST_KEY,
+    ST_COLON,
+    ST_VALUE,
+    ST_STRING,
+    ST_NUMBER,
+    ST_LITERAL,
+    ST_SKIP,
+    ST_NEXT,            // after a value: ',' or '}'
+    ST_DONE,
+    ST_ERROR,
+};
+
+#define REPLACEMENT_CHAR    0xFFFD
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static void string_start(json_reader_t *r, char *out, size_t size)
+{
+    r->out = out;
+    r->out_size = size;
+    r->out_len = 0;
+    r->out_truncated = false;
+    r->escape = 0;
+    r->high = 0;
+}
+
+// 放不下就整体标记截断，不再追加，避免截断后又拼上后面的短字符
+static void put_bytes(json_reader_t *r, const char *data, size_t len)
+{
+    if (r->out_truncated || r->out_len + len >= r->out_size) {
+        r->out_truncated = true;
+        return;
+    }
+    memcpy(r->out + r->out_len, data, len);
+    r->out_len += len;
+}
+
+static void put_code_point(json_reader_t *r, uint32_t cp)
+{
+    char utf8[4];
+    size_t len;
+
+    if (cp < 0x80) {
+        utf8[0] = cp;
+        len = 1;
+    } else if (cp < 0x800) {
+        utf8[0] = 0xC0 | cp >> 6;
+        utf8[1] = 0x80 | (cp & 0x3F);
+        len = 2;
+    } else if (cp < 0x10000) {
+        utf8[0] = 0xE0 | cp >> 12;
+        utf8[1] = 0x80 | (cp >> 6 & 0x3F);
+        utf8[2] = 0x80 | (cp & 0x3F);
+        len = 3;
+    } else {
+        utf8[0] = 0xF0 | cp >> 18;
+        utf8[1] = 0x80 | (cp >> 12 & 0x3F);
+        utf8[2] = 0x80 | (cp >> 6 & 0x3F);
+        utf8[3] = 0x80 | (cp & 0x3F);
+        len = 4;
+    }
+    put_bytes(r, utf8, len);
+}
+
+// High surrogate not followed by a low one
+static void drop_high(json_reader_t *r)
+{
+    if (r->high != 0) {
+        put_code_point(r, REPLACEMENT_CHAR);
+        r->high = 0;
+    }
+}
+
+static void put_utf16(json_reader_t *r, uint32_t code)
+{
+    if (r->high != 0 && code >= 0xDC00 && code <= 0xDFFF) {
+        put_code_point(r, 0x10000 + ((r->high - 0xD800) << 10) + (code - 0xDC00));
+        r->high = 0;
+        return;
+    }
+    drop_high(r);
+    if (code >= 0xD800 && code <= 0xDBFF) {
+        r->high = code;
+    } else if (code >= 0xDC00 && code <= 0xDFFF) {
+        put_code_point(r, REPLACEMENT_CHAR);
+    } else {
+        put_code_point(r, code);
+    }
+}
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+
+    return -1;
+}
+
+/**
+ * @return 1 when the closing quote was consumed, 0 to continue, -1 on error
+ */
+static int string_step(json_reader_t *r, char c)
+{
+    if (r->escape >= 2) {
+        int v = hex_value(c);
+        if (v < 0) {
+            return -1;
+        }
+        r->code = r->code << 4 | v;
+        if (++r->escape == 6) {
+            r->escape = 0;
+            put_utf16(r, r->code);
+        }
+        return 0;
+    }
+
+    if (r->escape == 1) {
+        char out;
+        switch (c) {
+            case '"':
+            case '\\':
+            case '/':
+                out = c;
+                break;
+            case 'b':
+                out = '\b';
+                break;
+            case 'f':
+                out = '\f';
+                break;
+            case 'n':
+                out = '\n';
+                break;
+            case 'r':
+                out = '\r';
+                break;
+            case 't':
+                out = '\t';
+                break;
+            case 'u':
+                r->escape = 2;
+                r->code = 0;
+                return 0;
+            default:
+                return -1;
+        }
+        r->escape = 0;
+        drop_high(r);
+        put_bytes(r, &out, 1);
+        return 0;
+    }
+
+    if (c == '\\') {
+        r->escape = 1;
+        return 0;
+    }
+    if ((uint8_t) c < 0x20) {
+        return -1;
+    }
+    drop_high(r);
+    if (c == '"') {
+        r->out[r->out_len] = '\0';
+        return 1;
+    }
+    put_bytes(r, &c, 1);
+
+    return 0;
+}
+
+static void report(json_reader_t *r)
+{
+    if (r->cb != NULL) {
+        r->cb(r->ctx, r->key, &r->value);
+    }
+    r->state = ST_NEXT;
+}
+
+static bool number_end(json_reader_t *r)
+{
+    // out_len 记录整数部分的位数
+    if (r->out_len == 0 || r->overflow) {
+        return false;
+    }
+    r->value.type = JSON_READER_NUMBER;
+    if (r->negative) {
+        r->value.num = -r->value.num;
+    }
+    report(r);
+
+    return true;
+}
+
+static bool literal_end(json_reader_t *r)
+{
+    r->literal[r->out_len] = '\0';
+    if (strcmp(r->literal, "true") == 0) {
+        r->value.type = JSON_READER_BOOL;
+        r->value.num = 1;
+    } else if (strcmp(r->literal, "false") == 0) {
+        r->value.type = JSON_READER_BOOL;
+        r->value.num = 0;
+    } else if (strcmp(r->literal, "null") == 0) {
+        r->value.type = JSON_READER_NULL;
+    } else {
+        return false;
+    }
+    report(r);
+
+    return true;
+}
+
+static void value_start(json_reader_t *r, char c)
+{
+    memset(&r->value, 0, sizeof(json_reader_value_t));
+
+    if (c == '"') {
+        string_start(r, r->str, sizeof(r->str));
+        r->state = ST_STRING;
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        r->negative = c == '-';
+        r->in_fraction = false;
+        r->overflow = false;
+        r->out_len = 0;
+        r->state = ST_NUMBER;
+        if (c != '-') {
+            r->value.num = c - '0';
+            r->out_len = 1;
+        }
+    } else if (c >= 'a' && c <= 'z') {
+        r->literal[0] = c;
+        r->out_len = 1;
+        r->state = ST_LITERAL;
+    } else if (c == '{' || c == '[') {
+        r->skip_depth = 1;
+        r->skip_string = false;
+        r->escape = 0;
+        r->state = ST_SKIP;
+    } else {
+        r->state = ST_ERROR;
+    }
+}
+
+/**
+ * @return false if `c` was not consumed and has to be fed again in the new state
+ */
+static bool step(json_reader_t *r, char c)
+{
+    switch (r->state) {
+        case ST_START:
+            if (c == '{') {
+                r->state = ST_FIRST;
+            } else if (!is_space(c)) {
+                r->state = ST_ERROR;
+            }
+            return true;
+        case ST_FIRST:
+        case ST_MEMBER:
+            if (c == '"') {
+                string_start(r, r->key, sizeof(r->key));
+                r->state = ST_KEY;
+            } else if (c == '}' && r->state == ST_FIRST) {
+                r->state = ST_DONE;
+            } else if (!is_space(c)) {
+                r->state = ST_ERROR;
+            }
+            return true;
+        case ST_KEY:
+            switch (string_step(r, c)) {
+                case 1:
+                    // 超长的 key 不可能匹配，置空
+                    if (r->out_truncated) {
+                        r->key[0] = '\0';
+                    }
+                    r->state = ST_COLON;
+                    break;
+                case -1:
+                    r->state = ST_ERROR;
+                    break;
+            }
+            return true;
+        case ST_COLON:
+            if (c == ':') {
+                r->state = ST_VALUE;
+            } else if (!is_space(c)) {
+                r->state = ST_ERROR;
+            }
+            return true;
+        case ST_VALUE:
+            if (!is_space(c)) {
+                value_start(r, c);
+            }
+            return true;
+        case ST_STRING:
+            switch (string_step(r, c)) {
+                case 1:
+                    r->value.type = JSON_READER_STRING;
+                    r->value.str = r->str;
+                    r->value.len = r->out_len;
+                    r->value.truncated = r->out_truncated;
+                    report(r);
+                    break;
+                case -1:
+                    r->state = ST_ERROR;
+                    break;
+            }
+            return true;
+        case ST_NUMBER:
+            if (c >= '0' && c <= '9') {
+                if (!r->in_fraction) {
+                    if (r->value.num > (INT64_MAX - 9) / 10) {
+                        r->overflow = true;
+                    }
+                    r->value.num = r->value.num * 10 + (c - '0');
+                    r->out_len++;
+                }
+            } else if (c == '.' || c == 'e' || c == 'E' || ((c == '+' || c == '-') && r->in_fraction)) {
+                r->in_fraction = true;
+            } else {
+                if (!number_end(r)) {
+                    r->state = ST_ERROR;
+                }
+                return false;
+            }
+            return true;
+        case ST_LITERAL:
+            if (c >= 'a' && c <= 'z') {
+                if (r->out_len + 1 >= sizeof(r->literal)) {
+                    r->state = ST_ERROR;
+                } else {
+                    r->literal[r->out_len++] = c;
+                }
+                return true;
+            }
+            if (!literal_end(r)) {
+                r->state = ST_ERROR;
+            }
+            return false;
+        case ST_SKIP:
+            if (r->skip_string) {
+                if (r->escape) {
+                    r->escape = 0;
+                } else if (c == '\\') {
+                    r->escape = 1;
+                } else if (c == '"') {
+                    r->skip_string = false;
+                }
+            } else if (c == '"') {
+                r->skip_string = true;
+            } else if (c == '{' || c == '[') {
+                if (++r->skip_depth == 0) {
+                    r->state = ST_ERROR;
+                }
+            } else if (c == '}' || c == ']') {
+                if (--r->skip_depth == 0) {
+                    r->state = ST_NEXT;
+                }
+            }
+            return true;
+        case ST_NEXT:
+            if (c == ',') {
+                r->state = ST_MEMBER;
+            } else if (c == '}') {
+                r->state = ST_DONE;
+            } else if (!is_space(c)) {
+                r->state = ST_ERROR;
+            }
+            return true;
+        case ST_DONE:
+            if (!is_space(c)) {
+                r->state = ST_ERROR;
+            }
+            return true;
+        default:
+            return true;
+    }
+}
+
+void json_reader_init(json_reader_t *r, json_reader_cb_t cb, void *ctx)
+{
+    memset(r, 0, sizeof(json_reader_t));
+    r->cb = cb;
+    r->ctx = ctx;
+    r->state = ST_START;
+}
+
+int json_reader_feed(json_reader_t *r, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len && r->state != ST_ERROR; ++i) {
+        while (!step(r, data[i]) && r->state != ST_ERROR) {
+        }
+    }
+
+    return r->state == ST_ERROR ? -1 : 0;
+}
+
+int json_reader_finish(json_reader_t *r)
+{
+    return r->state == ST_DONE ? 0 : -1;
+}
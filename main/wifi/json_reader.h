@@ -0,0 +1,71 @@
+// Streaming reader for a flat JSON object, the counterpart of json_writer.h. The body is fed in
+// chunks of any size as it arrives; each top-level member is reported once its value is
+// complete. Nested objects and arrays are skipped. No allocation, state lives in json_reader_t.
+// Pure C.
+//
+//     json_reader_init(&r, on_value, &staged);
+//     while ((n = recv(buf)) > 0) json_reader_feed(&r, buf, n);
+//     if (json_reader_finish(&r) != 0) ...
+
+#ifndef ESP_MENJIN_JSON_READER_H
+#define ESP_MENJIN_JSON_READER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_READER_KEY_MAX     32      // longer keys are truncated, so they never match
+#define JSON_READER_VALUE_MAX   128     // sizeof(sys_param_t.macros)
+
+typedef enum {
+    JSON_READER_STRING = 0,
+    JSON_READER_NUMBER,
+    JSON_READER_BOOL,
+    JSON_READER_NULL,
+} json_reader_type_t;
+
+typedef struct {
+    json_reader_type_t type;
+    const char *str;                    // STRING: decoded, NUL terminated
+    size_t len;
+    bool truncated;                     // STRING: did not fit into JSON_READER_VALUE_MAX - 1 bytes
+    int64_t num;                        // NUMBER: digits before any fraction or exponent; BOOL: 0 or 1
+} json_reader_value_t;
+
+typedef void (*json_reader_cb_t)(void *ctx, const char *key, const json_reader_value_t *value);
+
+typedef struct {
+    json_reader_cb_t cb;
+    void *ctx;
+    uint8_t state;
+    uint8_t escape;                     // position inside \uXXXX, 1 right after the backslash
+    uint8_t skip_depth;                 // nesting of a skipped object or array value
+    bool skip_string;
+    bool in_fraction;
+    bool negative;
+    bool overflow;
+    uint32_t code;                      // \u code unit being read
+    uint32_t high;                      // pending high surrogate
+    char *out;                          // string being decoded, key or value
+    size_t out_size;
+    size_t out_len;
+    bool out_truncated;
+    json_reader_value_t value;
+    char key[JSON_READER_KEY_MAX];
+    char literal[8];                    // true / false / null
+    char str[JSON_READER_VALUE_MAX];
+} json_reader_t;
+
+void json_reader_init(json_reader_t *r, json_reader_cb_t cb, void *ctx);
+
+/**
+ * @return 0, or -1 once the input is not valid JSON (sticky)
+ */
+int json_reader_feed(json_reader_t *r, const char *data, size_t len);
+
+/**
+ * @return 0 if the input was exactly one complete object
+ */
+int json_reader_finish(json_reader_t *r);
+
+#endif //ESP_MENJIN_JSON_READER_H
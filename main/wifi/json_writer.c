@@ -0,0 +1,209 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "json_writer.h"
+
+static void put_bytes(json_writer_t *w, const char *data, size_t len)
+{
+    while (len > 0 && !w->error) {
+        if (w->len == w->size) {
+            if (w->flush(w->ctx, w->buf, w->len, false) != 0) {
+                w->error = true;
+                return;
+            }
+            w->len = 0;
+        }
+        size_t n = w->size - w->len < len ? w->size - w->len : len;
+        memcpy(w->buf + w->len, data, n);
+        w->len += n;
+        data += n;
+        len -= n;
+    }
+}
+
+static void put_char(json_writer_t *w, char c)
+{
+    put_bytes(w, &c, 1);
+}
+
+static void put_escaped(json_writer_t *w, const char *s)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    put_char(w, '"');
+    while (*s != '\0') {
+        // 不需要转义的连续字节一次拷贝
+        const char *run = s;
+        while ((uint8_t) *s >= 0x20 && *s != '"' && *s != '\\') {
+            s++;
+        }
+        put_bytes(w, run, s - run);
+        if (*s == '\0') {
+            break;
+        }
+
+        char esc[6] = {'\\', 0};
+        size_t len = 2;
+        switch (*s) {
+            case '"':
+            case '\\':
+                esc[1] = *s;
+                break;
+            case '\b':
+                esc[1] = 'b';
+                break;
+            case '\f':
+                esc[1] = 'f';
+                break;
+            case '\n':
+                esc[1] = 'n';
+                break;
+            case '\r':
+                esc[1] = 'r';
+                break;
+            case '\t':
+                esc[1] = 't';
+                break;
+            default:
+                memcpy(esc + 1, "u00", 3);
+                esc[4] = hex[(uint8_t) *s >> 4];
+                esc[5] = hex[*s & 0x0F];
+                len = 6;
+                break;
+        }
+        put_bytes(w, esc, len);
+        s++;
+    }
+    put_char(w, '"');
+}
+
+// Separator and key before a value
+static void put_prefix(json_writer_t *w, const char *key)
+{
+    uint32_t bit = 1u << w->depth;
+
+    if (w->has_items & bit) {
+        put_char(w, ',');
+    }
+    w->has_items |= bit;
+    if (key != NULL) {
+        put_escaped(w, key);
+        put_char(w, ':');
+    }
+}
+
+void json_writer_init(json_writer_t *w, char *buf, size_t size, json_writer_flush_t flush, void *ctx)
+{
+    memset(w, 0, sizeof(json_writer_t));
+    w->buf = buf;
+    w->size = size;
+    w->flush = flush;
+    w->ctx = ctx;
+}
+
+static void container_start(json_writer_t *w, const char *key, char open)
+{
+    put_prefix(w, key);
+    if (w->depth + 1 >= JSON_WRITER_DEPTH_MAX) {
+        w->error = true;
+        return;
+    }
+    w->depth++;
+    w->has_items &= ~(1u << w->depth);
+    put_char(w, open);
+}
+
+static void container_end(json_writer_t *w, char close)
+{
+    if (w->depth == 0) {
+        w->error = true;
+        return;
+    }
+    w->depth--;
+    put_char(w, close);
+}
+
+void json_writer_object_start(json_writer_t *w, const char *key)
+{
+    container_start(w, key, '{');
+}
+
+void json_writer_object_end(json_writer_t *w)
+{
+    container_end(w, '}');
+}
+
+void json_writer_array_start(json_writer_t *w, const char *key)
+{
+    container_start(w, key, '[');
+}
+
+void json_writer_array_end(json_writer_t *w)
+{
+    container_end(w, ']');
+}
+
+void json_writer_string(json_writer_t *w, const char *key, const char *value)
+{
+    put_prefix(w, key);
+    if (value == NULL) {
+        put_bytes(w, "null", 4);
+    } else {
+        put_escaped(w, value);
+    }
+}
+
+void json_writer_int(json_writer_t *w, const char *key, int64_t value)
+{
+    char digits[20];
+    size_t pos = sizeof(digits);
+    uint64_t abs = value < 0 ? -(uint64_t) value : (uint64_t) value;
+
+    do {
+        digits[--pos] = '0' + abs % 10;
+        abs /= 10;
+    } while (abs > 0);
+
+    put_prefix(w, key);
+    if (value < 0) {
+        put_char(w, '-');
+    }
+    put_bytes(w, digits + pos, sizeof(digits) - pos);
+}
+
+void json_writer_bool(json_writer_t *w, const char *key, bool value)
+{
+    put_prefix(w, key);
+    if (value) {
+        put_bytes(w, "true", 4);
+    } else {
+        put_bytes(w, "false", 5);
+    }
+}
+
+int json_writer_finish(json_writer_t *w)
+{
+    if (w->depth != 0) {
+        w->error = true;
+    }
+    if (!w->error && w->flush(w->ctx, w->buf, w->len, true) != 0) {
+        w->error = true;
+    }
+    w->len = 0;
+
+    return w->error ? -1 : 0;
+}
+
+int json_appendf(char *buf, size_t size, int len, const char *fmt, ...)
+{
+    if (len < 0 || (size_t) len >= size) {
+        return (int) size;
+    }
+
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf + len, size - len, fmt, args);
+    va_end(args);
+
+    return n < 0 || (size_t) n >= size - len ? (int) size : len + n;
+}
@@ -0,0 +1,74 @@
+// Streaming JSON writer: values are escaped into a caller-provided buffer, which is handed to
+// the flush callback whenever it fills up and once more at the end. No allocation, no tree.
+// Pure C; errors are sticky and reported by json_writer_finish().
+//
+//     json_writer_object_start(&w, NULL);
+//     json_writer_string(&w, "ssid", ssid);
+//     json_writer_int(&w, "rssi", rssi);
+//     json_writer_object_end(&w);
+//     json_writer_finish(&w);
+
+#ifndef ESP_MENJIN_JSON_WRITER_H
+#define ESP_MENJIN_JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSON_WRITER_DEPTH_MAX   16
+
+/**
+ * @param last set on the final call, which may carry an empty buffer
+ * @return 0 on success, anything else aborts the document
+ */
+typedef int (*json_writer_flush_t)(void *ctx, const char *data, size_t len, bool last);
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    json_writer_flush_t flush;
+    void *ctx;
+    uint32_t has_items;                     // bit per nesting level: a value was written, next needs ','
+    uint8_t depth;
+    bool error;
+} json_writer_t;
+
+/**
+ * @param size any size above 0, larger buffers mean fewer flushes
+ */
+void json_writer_init(json_writer_t *w, char *buf, size_t size, json_writer_flush_t flush, void *ctx);
+
+/**
+ * Inside an object every value needs a key, in an array and at the top level `key` must be NULL.
+ */
+void json_writer_object_start(json_writer_t *w, const char *key);
+void json_writer_object_end(json_writer_t *w);
+void json_writer_array_start(json_writer_t *w, const char *key);
+void json_writer_array_end(json_writer_t *w);
+
+/**
+ * @param value NULL writes null
+ */
+void json_writer_string(json_writer_t *w, const char *key, const char *value);
+void json_writer_int(json_writer_t *w, const char *key, int64_t value);
+void json_writer_bool(json_writer_t *w, const char *key, bool value);
+
+/**
+ * @brief Flush what is left with `last` set
+ *
+ * @return 0 if the document is complete and every flush succeeded
+ */
+int json_writer_finish(json_writer_t *w);
+
+/**
+ * @brief snprintf onto buf + len for documents built in one fixed buffer
+ *
+ * Once the text no longer fits `len` sticks at `size` and later appends write nothing, so the
+ * caller checks `len >= size` once at the end and drops the message.
+ *
+ * @return the new length, `size` after an overflow
+ */
+int json_appendf(char *buf, size_t size, int len, const char *fmt, ...) __attribute__((format(printf, 4, 5)));
+
+#endif //ESP_MENJIN_JSON_WRITER_H
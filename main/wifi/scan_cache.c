@@ -0,0 +1,214 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "esp_log.h"
+#include "esp_check.h"
+#include "scan_cache.h"
+
+static const char *TAG = "SCAN_CACHE";
+
+#define SCAN_INTERVAL_US        (CONFIG_MENJIN_WIFI_SCAN_INTERVAL * 1000000LL)
+#define SCAN_AP_TTL_US          (CONFIG_MENJIN_WIFI_SCAN_AP_TTL * 1000000LL)
+#define SCAN_RETRY_US           (5 * 1000000LL)     // scan refused, e.g. while the station connects
+
+static portMUX_TYPE g_scan_lock = portMUX_INITIALIZER_UNLOCKED;
+static scan_cache_ap_t g_aps[SCAN_CACHE_MAX_AP];
+static size_t g_count = 0;
+static scan_cache_status_t g_status = {0};
+// 只在事件任务里使用，合并完成后在锁内一次性拷进 g_aps
+static scan_cache_ap_t g_next[SCAN_CACHE_MAX_AP];
+static esp_timer_handle_t g_scan_timer = NULL;
+// 只有配网 AP 开着时才定时扫描；STA 模式下扫描会离开信道，打断 MQTT 和局域网控制
+static volatile bool g_ap_up = false;
+
+static void schedule(int64_t delay_us)
+{
+    if (delay_us <= 0 || !g_ap_up) {
+        return;
+    }
+    esp_timer_stop(g_scan_timer);
+    esp_timer_start_once(g_scan_timer, delay_us);
+}
+
+/**
+ * Keep one entry per SSID and the strongest `SCAN_CACHE_MAX_AP` overall, sorted by RSSI.
+ * Returns the new count.
+ */
+static size_t table_merge(scan_cache_ap_t *table, size_t count, const scan_cache_ap_t *ap)
+{
+    size_t pos;
+
+    for (pos = 0; pos < count; ++pos) {
+        if (strcmp(table[pos].ssid, ap->ssid) == 0) {
+            break;
+        }
+    }
+    if (pos < count) {
+        // 同名的其他 BSSID 留下信号更强的；上次扫描的旧记录不覆盖新的
+        if (table[pos].seen_us > ap->seen_us || (table[pos].seen_us == ap->seen_us && table[pos].rssi >= ap->rssi)) {
+            return count;
+        }
+        memmove(&table[pos], &table[pos + 1], (count - pos - 1) * sizeof(scan_cache_ap_t));
+        count--;
+    }
+
+    for (pos = 0; pos < count && table[pos].rssi >= ap->rssi; ++pos) {
+    }
+    if (pos == SCAN_CACHE_MAX_AP) {
+        return count;
+    }
+    if (count == SCAN_CACHE_MAX_AP) {
+        count--;
+    }
+    memmove(&table[pos + 1], &table[pos], (count - pos) * sizeof(scan_cache_ap_t));
+    table[pos] = *ap;
+
+    return count + 1;
+}
+
+static void scan_done(const wifi_event_sta_scan_done_t *event)
+{
+    int64_t now = esp_timer_get_time();
+    size_t count = 0;
+    size_t found = 0;
+    wifi_ap_record_t record;
+    scan_cache_ap_t ap;
+
+    if (event->status == 0) {
+        // 逐条取出，不需要按 AP 数量分配记录数组
+        while (esp_wifi_scan_get_ap_record(&record) == ESP_OK) {
+            found++;
+            if (record.ssid[0] == '\0') {
+                continue;
+            }
+            memset(&ap, 0, sizeof(ap));
+            strlcpy(ap.ssid, (const char *) record.ssid, sizeof(ap.ssid));
+            ap.rssi = record.rssi;
+            ap.channel = record.primary;
+            ap.authmode = record.authmode;
+            ap.seen_us = now;
+            count = table_merge(g_next, count, &ap);
+        }
+    }
+    esp_wifi_clear_ap_list();
+
+    if (event->status == 0) {
+        // 这次没扫到的旧记录在过期前保留；g_aps 只有这里写，读不用加锁
+        for (size_t i = 0; i < g_count; ++i) {
+            if (now - g_aps[i].seen_us < SCAN_AP_TTL_US) {
+                count = table_merge(g_next, count, &g_aps[i]);
+            }
+        }
+    }
+
+    taskENTER_CRITICAL(&g_scan_lock);
+    if (event->status == 0) {
+        memcpy(g_aps, g_next, count * sizeof(scan_cache_ap_t));
+        g_count = count;
+        g_status.updated_us = now;
+        g_status.scans++;
+    } else {
+        g_status.failed++;
+    }
+    g_status.scanning = false;
+    taskEXIT_CRITICAL(&g_scan_lock);
+
+    ESP_LOGI(TAG, "scan %s, %u APs found, %u cached", event->status == 0 ? "done" : "failed",
+             (unsigned) found, (unsigned) count);
+
+    schedule(SCAN_INTERVAL_US);
+}
+
+static void scan_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    if (event_base != WIFI_EVENT) {
+        return;
+    }
+    switch (event_id) {
+        case WIFI_EVENT_SCAN_DONE:
+            scan_done((const wifi_event_sta_scan_done_t *) event_data);
+            break;
+        case WIFI_EVENT_AP_START:
+            g_ap_up = true;
+            scan_cache_refresh();
+            break;
+        case WIFI_EVENT_AP_STOP:
+            g_ap_up = false;
+            esp_timer_stop(g_scan_timer);
+            break;
+        default:
+            break;
+    }
+}
+
+esp_err_t scan_cache_refresh(void)
+{
+    bool scanning;
+
+    taskENTER_CRITICAL(&g_scan_lock);
+    scanning = g_status.scanning;
+    g_status.scanning = true;
+    taskEXIT_CRITICAL(&g_scan_lock);
+
+    if (scanning) {
+        return ESP_OK;
+    }
+
+    esp_err_t ret = esp_wifi_scan_start(NULL, false);
+    if (ret != ESP_OK) {
+        taskENTER_CRITICAL(&g_scan_lock);
+        g_status.scanning = false;
+        g_status.failed++;
+        taskEXIT_CRITICAL(&g_scan_lock);
+        ESP_LOGW(TAG, "scan not started: %s", esp_err_to_name(ret));
+        schedule(SCAN_RETRY_US);
+    }
+
+    return ret;
+}
+
+static void scan_timer_cb(void *arg)
+{
+    scan_cache_refresh();
+}
+
+size_t scan_cache_get(scan_cache_ap_t *aps, size_t max, scan_cache_status_t *status)
+{
+    taskENTER_CRITICAL(&g_scan_lock);
+    size_t count = g_count < max ? g_count : max;
+    memcpy(aps, g_aps, count * sizeof(scan_cache_ap_t));
+    if (status != NULL) {
+        *status = g_status;
+    }
+    taskEXIT_CRITICAL(&g_scan_lock);
+
+    return count;
+}
+
+esp_err_t scan_cache_init(void)
+{
+    ESP_RETURN_ON_FALSE(g_scan_timer == NULL, ESP_ERR_INVALID_STATE, TAG, "already initialized");
+
+    const esp_timer_create_args_t timer_args = {
+            .callback = scan_timer_cb,
+            .name = "wifi_scan",
+    };
+    ESP_RETURN_ON_ERROR(esp_timer_create(&timer_args, &g_scan_timer), TAG, "create scan timer failed");
+    ESP_RETURN_ON_ERROR(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_SCAN_DONE, &scan_event_handler, NULL),
+                        TAG, "register scan event failed");
+    ESP_RETURN_ON_ERROR(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_AP_START, &scan_event_handler, NULL),
+                        TAG, "register ap start event failed");
+    ESP_RETURN_ON_ERROR(esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_AP_STOP, &scan_event_handler, NULL),
+                        TAG, "register ap stop event failed");
+
+    // AP 可能在注册前已经启动；STA 模式下只在 ?refresh=1 时扫描
+    wifi_mode_t mode = WIFI_MODE_NULL;
+    if (esp_wifi_get_mode(&mode) == ESP_OK && (mode == WIFI_MODE_AP || mode == WIFI_MODE_APSTA)) {
+        g_ap_up = true;
+        // 首次扫描失败时会自行重试
+        scan_cache_refresh();
+    }
+
+    return ESP_OK;
+}
@@ -0,0 +1,54 @@
+// Wi-Fi scan cache: scans run in the background and never block the caller. While the
+// provisioning AP is up they also run on a schedule (CONFIG_MENJIN_WIFI_SCAN_INTERVAL); in STA
+// mode only on demand, so a provisioned device never leaves its channel on its own. Results are
+// merged into a table of the strongest access points, one entry per SSID, sorted by RSSI.
+
+#ifndef ESP_MENJIN_SCAN_CACHE_H
+#define ESP_MENJIN_SCAN_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include <esp_wifi_types.h>
+#include "sdkconfig.h"
+
+#define SCAN_CACHE_MAX_AP       CONFIG_MENJIN_WIFI_SCAN_MAX_AP
+
+typedef struct {
+    char ssid[33];
+    int8_t rssi;                // strongest of the BSSIDs sharing the SSID
+    uint8_t channel;
+    wifi_auth_mode_t authmode;
+    int64_t seen_us;            // esp_timer time of the last scan that saw it
+} scan_cache_ap_t;
+
+typedef struct {
+    int64_t updated_us;         // last completed scan, 0 if none yet
+    bool scanning;
+    uint32_t scans;
+    uint32_t failed;            // scans that could not be started or did not complete
+} scan_cache_status_t;
+
+/**
+ * @brief Register for scan and AP events; Wi-Fi must be initialized
+ *
+ * Scans right away if the provisioning AP is already up.
+ */
+esp_err_t scan_cache_init(void);
+
+/**
+ * @brief Start a background scan unless one is running, the only way to scan in STA mode
+ *
+ * @return ESP_OK if a scan is running now, ESP_ERR_WIFI_STATE while the station is connecting
+ */
+esp_err_t scan_cache_refresh(void);
+
+/**
+ * @brief Copy the cached access points, strongest first
+ *
+ * @return number of entries copied
+ */
+size_t scan_cache_get(scan_cache_ap_t *aps, size_t max, scan_cache_status_t *status);
+
+#endif //ESP_MENJIN_SCAN_CACHE_H
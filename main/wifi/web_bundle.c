@@ -0,0 +1,102 @@
+#include <string.h>
+#include "web_bundle.h"
+
+#define WEB_BUNDLE_VERSION      1
+#define WEB_BUNDLE_HEADER_LEN   8
+#define WEB_BUNDLE_ENTRY_LEN    (20 + WEB_BUNDLE_HASH_LEN)
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+static uint16_t bundle_count(const uint8_t *bundle)
+{
+    return get_u16(bundle + 6);
+}
+
+static const uint8_t *bundle_entry(const uint8_t *bundle, int i)
+{
+    return bundle + WEB_BUNDLE_HEADER_LEN + i * WEB_BUNDLE_ENTRY_LEN;
+}
+
+static bool range_valid(size_t len, uint32_t off, uint32_t size)
+{
+    return off <= len && size <= len - off;
+}
+
+bool web_bundle_check(const uint8_t *bundle, size_t len)
+{
+    if (len < WEB_BUNDLE_HEADER_LEN || memcmp(bundle, "MJWB", 4) != 0 || get_u16(bundle + 4) != WEB_BUNDLE_VERSION) {
+        return false;
+    }
+
+    int count = bundle_count(bundle);
+    if (!range_valid(len, WEB_BUNDLE_HEADER_LEN, count * WEB_BUNDLE_ENTRY_LEN)) {
+        return false;
+    }
+
+    const char *prev = NULL;
+    for (int i = 0; i < count; ++i) {
+        const uint8_t *entry = bundle_entry(bundle, i);
+        uint32_t path_off = get_u32(entry);
+        if (path_off >= len || memchr(bundle + path_off, '\0', len - path_off) == NULL
+            || !range_valid(len, get_u32(entry + 4), get_u32(entry + 8))
+            || (get_u32(entry + 12) != 0 && !range_valid(len, get_u32(entry + 12), get_u32(entry + 16)))) {
+            return false;
+        }
+        // 必须严格有序，否则二分查找会漏
+        const char *path = (const char *) bundle + path_off;
+        if (prev != NULL && strcmp(prev, path) >= 0) {
+            return false;
+        }
+        prev = path;
+    }
+
+    return true;
+}
+
+// strcmp() against a path that is not terminated
+static int path_compare(const char *entry_path, const char *path, size_t path_len)
+{
+    int cmp = strncmp(entry_path, path, path_len);
+    if (cmp != 0) {
+        return cmp;
+    }
+
+    return entry_path[path_len] == '\0' ? 0 : 1;
+}
+
+bool web_bundle_find(const uint8_t *bundle, const char *path, size_t path_len, web_bundle_asset_t *asset)
+{
+    int lo = 0;
+    int hi = bundle_count(bundle) - 1;
+
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        const uint8_t *entry = bundle_entry(bundle, mid);
+        const char *entry_path = (const char *) bundle + get_u32(entry);
+        int cmp = path_compare(entry_path, path, path_len);
+        if (cmp < 0) {
+            lo = mid + 1;
+        } else if (cmp > 0) {
+            hi = mid - 1;
+        } else {
+            uint32_t gz_off = get_u32(entry + 12);
+            asset->path = entry_path;
+            asset->data = bundle + get_u32(entry + 4);
+            asset->len = get_u32(entry + 8);
+            asset->gz = gz_off != 0 ? bundle + gz_off : NULL;
+            asset->gz_len = gz_off != 0 ? get_u32(entry + 16) : 0;
+            asset->hash = (const char *) entry + 20;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,35 @@
+// Read-only web UI bundle produced by tools/web_assets.py and embedded in the app image.
+// Lookups return pointers into the bundle, which stays in memory-mapped flash: nothing is
+// copied or allocated. Pure C, the layout is documented in the script.
+
+#ifndef ESP_MENJIN_WEB_BUNDLE_H
+#define ESP_MENJIN_WEB_BUNDLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define WEB_BUNDLE_HASH_LEN     16
+
+typedef struct {
+    const char *path;
+    const uint8_t *data;
+    size_t len;
+    const uint8_t *gz;                      // NULL when not stored compressed
+    size_t gz_len;
+    const char *hash;                       // WEB_BUNDLE_HASH_LEN hex digits, not terminated
+} web_bundle_asset_t;
+
+/**
+ * @brief Check the header and that every entry lies inside the bundle
+ */
+bool web_bundle_check(const uint8_t *bundle, size_t len);
+
+/**
+ * @brief Binary search for a path, e.g. "/index.html"; the bundle must have passed web_bundle_check()
+ *
+ * @param path_len path is not required to be terminated
+ */
+bool web_bundle_find(const uint8_t *bundle, const char *path, size_t path_len, web_bundle_asset_t *asset);
+
+#endif //ESP_MENJIN_WEB_BUNDLE_H
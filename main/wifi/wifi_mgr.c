@@ -105,134 +105,3 @@ void wifi_mgr_start(void)
 
     ESP_LOGI(TAG, "Wi-Fi connected");
 }
-
-//// WiFi scan
-
-static void print_auth_mode(int authmode)
-{
-    switch (authmode) {
-        case WIFI_AUTH_OPEN:
-            ESP_LOGI(TAG, "Authmode \tWIFI_AUTH_OPEN");
-            break;
-        case WIFI_AUTH_OWE:
-            ESP_LOGI(TAG, "Authmode \tWIFI_AUTH_OWE");
-            break;
-        case WIFI_AUTH_WEP:
-            ESP_LOGI(TAG, "Authmode \tWIFI_AUTH_WEP");
-            break;
-        case WIFI_AUTH_WPA_PSK:
-            ESP_LOGI(TAG, "Authmode \tWIFI_AUTH_WPA_PSK");
-            break;
-        case WIFI_AUTH_WPA2_PSK:
-            ESP_LOGI(TAG, "Authmode \tWIFI_AUTH_WPA2_PSK");
-            break;
-        case WIFI_AUTH_WPA_WPA2_PSK:
-            ESP_LOGI(TAG, "Authmode \tWIFI_AUTH_WPA_WPA2_PSK");
-            break;
-        case WIFI_AUTH_WPA2_ENTERPRISE:
-            ESP_LOGI(TAG, "Authmode \tWIFI_AUTH_WPA2_ENTERPRISE");
-            break;
-        case WIFI_AUTH_WPA3_PSK:
-            ESP_LOGI(TAG, "Authmode \tWIFI_AUTH_WPA3_PSK");
-            break;
-        case WIFI_AUTH_WPA2_WPA3_PSK:
-            ESP_LOGI(TAG, "Authmode \tWIFI_AUTH_WPA2_WPA3_PSK");
-            break;
-        default:
-            ESP_LOGI(TAG, "Authmode \tWIFI_AUTH_UNKNOWN");
-            break;
-    }
-}
-
-static void print_cipher_type(int pairwise_cipher, int group_cipher)
-{
-    switch (pairwise_cipher) {
-        case WIFI_CIPHER_TYPE_NONE:
-            ESP_LOGI(TAG, "Pairwise Cipher \tWIFI_CIPHER_TYPE_NONE");
-            break;
-        case WIFI_CIPHER_TYPE_WEP40:
-            ESP_LOGI(TAG, "Pairwise Cipher \tWIFI_CIPHER_TYPE_WEP40");
-            break;
-        case WIFI_CIPHER_TYPE_WEP104:
-            ESP_LOGI(TAG, "Pairwise Cipher \tWIFI_CIPHER_TYPE_WEP104");
-            break;
-        case WIFI_CIPHER_TYPE_TKIP:
-            ESP_LOGI(TAG, "Pairwise Cipher \tWIFI_CIPHER_TYPE_TKIP");
-            break;
-        case WIFI_CIPHER_TYPE_CCMP:
-            ESP_LOGI(TAG, "Pairwise Cipher \tWIFI_CIPHER_TYPE_CCMP");
-            break;
-        case WIFI_CIPHER_TYPE_TKIP_CCMP:
-            ESP_LOGI(TAG, "Pairwise Cipher \tWIFI_CIPHER_TYPE_TKIP_CCMP");
-            break;
-        case WIFI_CIPHER_TYPE_AES_CMAC128:
-            ESP_LOGI(TAG, "Pairwise Cipher \tWIFI_CIPHER_TYPE_AES_CMAC128");
-            break;
-        case WIFI_CIPHER_TYPE_SMS4:
-            ESP_LOGI(TAG, "Pairwise Cipher \tWIFI_CIPHER_TYPE_SMS4");
-            break;
-        case WIFI_CIPHER_TYPE_GCMP:
-            ESP_LOGI(TAG, "Pairwise Cipher \tWIFI_CIPHER_TYPE_GCMP");
-            break;
-        case WIFI_CIPHER_TYPE_GCMP256:
-            ESP_LOGI(TAG, "Pairwise Cipher \tWIFI_CIPHER_TYPE_GCMP256");
-            break;
-        default:
-            ESP_LOGI(TAG, "Pairwise Cipher \tWIFI_CIPHER_TYPE_UNKNOWN");
-            break;
-    }
-
-    switch (group_cipher) {
-        case WIFI_CIPHER_TYPE_NONE:
-            ESP_LOGI(TAG, "Group Cipher \tWIFI_CIPHER_TYPE_NONE");
-            break;
-        case WIFI_CIPHER_TYPE_WEP40:
-            ESP_LOGI(TAG, "Group Cipher \tWIFI_CIPHER_TYPE_WEP40");
-            break;
-        case WIFI_CIPHER_TYPE_WEP104:
-            ESP_LOGI(TAG, "Group Cipher \tWIFI_CIPHER_TYPE_WEP104");
-            break;
-        case WIFI_CIPHER_TYPE_TKIP:
-            ESP_LOGI(TAG, "Group Cipher \tWIFI_CIPHER_TYPE_TKIP");
-            break;
-        case WIFI_CIPHER_TYPE_CCMP:
-            ESP_LOGI(TAG, "Group Cipher \tWIFI_CIPHER_TYPE_CCMP");
-            break;
-        case WIFI_CIPHER_TYPE_TKIP_CCMP:
-            ESP_LOGI(TAG, "Group Cipher \tWIFI_CIPHER_TYPE_TKIP_CCMP");
-            break;
-        case WIFI_CIPHER_TYPE_SMS4:
-            ESP_LOGI(TAG, "Group Cipher \tWIFI_CIPHER_TYPE_SMS4");
-            break;
-        case WIFI_CIPHER_TYPE_GCMP:
-            ESP_LOGI(TAG, "Group Cipher \tWIFI_CIPHER_TYPE_GCMP");
-            break;
-        case WIFI_CIPHER_TYPE_GCMP256:
-            ESP_LOGI(TAG, "Group Cipher \tWIFI_CIPHER_TYPE_GCMP256");
-            break;
-        default:
-            ESP_LOGI(TAG, "Group Cipher \tWIFI_CIPHER_TYPE_UNKNOWN");
-            break;
-    }
-}
-
-/* Initialize Wi-Fi as sta and set scan method */
-esp_err_t wifi_scan(uint16_t number, wifi_ap_record_t *ap_info, uint16_t *ap_count)
-{
-    ESP_RETURN_ON_ERROR(esp_wifi_scan_start(NULL, true), TAG, "");
-    ESP_RETURN_ON_ERROR(esp_wifi_scan_get_ap_records(&number, ap_info), TAG, "");
-    ESP_RETURN_ON_ERROR(esp_wifi_scan_get_ap_num(ap_count), TAG, "");
-    ESP_LOGI(TAG, "Total APs scanned = %u", *ap_count);
-
-    for (int i = 0; (i < number) && (i < *ap_count); i++) {
-        ESP_LOGI(TAG, "SSID \t\t%s", ap_info[i].ssid);
-        ESP_LOGI(TAG, "RSSI \t\t%d", ap_info[i].rssi);
-        print_auth_mode(ap_info[i].authmode);
-        if (ap_info[i].authmode != WIFI_AUTH_WEP) {
-            print_cipher_type(ap_info[i].pairwise_cipher, ap_info[i].group_cipher);
-        }
-        ESP_LOGI(TAG, "Channel \t\t%d", ap_info[i].primary);
-    }
-
-    return ESP_OK;
-}
\ No newline at end of file
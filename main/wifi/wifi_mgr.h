@@ -14,6 +14,5 @@ void wifi_mgr_start(void);
 esp_err_t wifi_mgr_get_ip(char* ip);
 void smartconfig_initialise_wifi();
 void webconfig_initialise_wifi();
-esp_err_t wifi_scan(uint16_t number, wifi_ap_record_t *ap_info, uint16_t *ap_count);
 
 #endif //WT_HOMEGW_WIFI_MGR_H
@@ -0,0 +1,569 @@
+// Host test for components/dns_server/dns_packet.c: the name parser against plain, compressed,
+// looping, truncated and oversized names, and the mDNS responder's A/PTR/SRV/TXT answers read
+// back through the same parser, for multicast, QU and legacy queries and the announcement.
+//
+//     cc -O2 -Icomponents/dns_server/include -o dns_packet_test tools/dns_packet_test.c components/dns_server/dns_packet.c
+//     ./dns_packet_test
+
+#include <stdio.h>
+#include <string.h>
+#include "dns_packet.h"
+
+#define HOST_IP             0x0104A8C0      // 192.168.4.1, network byte order
+#define MAX_RECORDS         32
+
+static int g_checks = 0;
+static int g_failures = 0;
+
+#define CHECK(cond) do { \
+        g_checks++; \
+        if (!(cond)) { \
+            g_failures++; \
+            printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+static const mdns_service_t g_services[] = {
+        {.type = "_http._tcp", .port = 80, .txt = "path=/"},
+        {.type = "_menjin._tcp", .port = 8266, .txt = NULL},
+};
+
+static const mdns_host_t g_host = {
+        .hostname = "menjin",
+        .ip = HOST_IP,
+        .num_of_services = 2,
+        .service = g_services,
+};
+
+typedef struct {
+    char name[DNS_NAME_MAX_LEN];
+    uint16_t type;
+    uint16_t class;
+    uint32_t ttl;
+    const uint8_t *rdata;
+    uint16_t rdlength;
+} record_t;
+
+typedef struct {
+    uint16_t id;
+    uint16_t flags;
+    uint16_t qd_count;
+    int an_count;
+    int ar_count;
+    record_t rec[MAX_RECORDS];
+} reply_t;
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+/* ---------- query builder ---------- */
+
+static size_t put_name(uint8_t *buf, size_t off, const char *dotted)
+{
+    while (*dotted != '\0') {
+        const char *dot = strchr(dotted, '.');
+        size_t len = dot ? (size_t)(dot - dotted) : strlen(dotted);
+        buf[off++] = len;
+        memcpy(buf + off, dotted, len);
+        off += len;
+        dotted += len + (dot ? 1 : 0);
+    }
+    buf[off++] = 0;
+
+    return off;
+}
+
+static size_t put_question(uint8_t *buf, size_t off, const char *name, uint16_t type, uint16_t class)
+{
+    off = put_name(buf, off, name);
+    buf[off++] = type >> 8;
+    buf[off++] = type & 0xFF;
+    buf[off++] = class >> 8;
+    buf[off++] = class & 0xFF;
+
+    return off;
+}
+
+// 单个问题的查询，id 0x1234
+static size_t build_query(uint8_t *buf, const char *name, uint16_t type, uint16_t class)
+{
+    memset(buf, 0, DNS_HEADER_LEN);
+    buf[0] = 0x12;
+    buf[1] = 0x34;
+    buf[5] = 1;
+
+    return put_question(buf, DNS_HEADER_LEN, name, type, class);
+}
+
+/* ---------- reply reader ---------- */
+
+// 按 RFC 1035 读回整个应答，问题段跳过，答案和附加记录都解析出来
+static bool read_reply(const uint8_t *pkt, int len, reply_t *r)
+{
+    memset(r, 0, sizeof(*r));
+    if (len < DNS_HEADER_LEN) {
+        return false;
+    }
+    r->id = get_u16(pkt);
+    r->flags = get_u16(pkt + 2);
+    r->qd_count = get_u16(pkt + 4);
+    r->an_count = get_u16(pkt + 6);
+    r->ar_count = get_u16(pkt + 10);
+    if (get_u16(pkt + 8) != 0 || r->an_count + r->ar_count > MAX_RECORDS) {
+        return false;
+    }
+
+    char name[DNS_NAME_MAX_LEN];
+    int off = DNS_HEADER_LEN;
+    for (int i = 0; i < r->qd_count; ++i) {
+        off = dns_name_parse(pkt, len, off, name, sizeof(name));
+        if (off < 0 || off + 4 > len) {
+            return false;
+        }
+        off += 4;
+    }
+    for (int i = 0; i < r->an_count + r->ar_count; ++i) {
+        record_t *rec = &r->rec[i];
+        off = dns_name_parse(pkt, len, off, rec->name, sizeof(rec->name));
+        if (off < 0 || off + 10 > len) {
+            return false;
+        }
+        rec->type = get_u16(pkt + off);
+        rec->class = get_u16(pkt + off + 2);
+        rec->ttl = (uint32_t) get_u16(pkt + off + 4) << 16 | get_u16(pkt + off + 6);
+        rec->rdlength = get_u16(pkt + off + 8);
+        rec->rdata = pkt + off + 10;
+        off += 10 + rec->rdlength;
+        if (off > len) {
+            return false;
+        }
+    }
+
+    return off == len;
+}
+
+// 在 [from, to) 里找 name/type 的记录
+static const record_t *find(const reply_t *r, int from, int to, const char *name, uint16_t type)
+{
+    for (int i = from; i < to; ++i) {
+        if (r->rec[i].type == type && strcmp(r->rec[i].name, name) == 0) {
+            return &r->rec[i];
+        }
+    }
+    return NULL;
+}
+
+static const record_t *answer(const reply_t *r, const char *name, uint16_t type)
+{
+    return find(r, 0, r->an_count, name, type);
+}
+
+static const record_t *additional(const reply_t *r, const char *name, uint16_t type)
+{
+    return find(r, r->an_count, r->an_count + r->ar_count, name, type);
+}
+
+// PTR 和 SRV 的目标名字可能压缩指向包里更早的位置，要用整个包来解析
+static bool rdata_name(const uint8_t *pkt, int len, const record_t *rec, size_t skip, const char *expected)
+{
+    char name[DNS_NAME_MAX_LEN];
+    int end = dns_name_parse(pkt, len, rec->rdata - pkt + skip, name, sizeof(name));
+
+    return end == rec->rdata - pkt + rec->rdlength && strcmp(name, expected) == 0;
+}
+
+static bool check_a(const record_t *rec)
+{
+    uint32_t ip;
+
+    if (rec == NULL || rec->rdlength != 4) {
+        return false;
+    }
+    memcpy(&ip, rec->rdata, 4);
+    return ip == HOST_IP;
+}
+
+static bool check_srv(const uint8_t *pkt, int len, const record_t *rec, uint16_t port)
+{
+    return rec != NULL && rec->rdlength >= 6 && get_u16(rec->rdata) == 0 && get_u16(rec->rdata + 2) == 0
+           && get_u16(rec->rdata + 4) == port && rdata_name(pkt, len, rec, 6, "menjin.local");
+}
+
+static bool check_txt(const record_t *rec, const char *txt)
+{
+    size_t len = txt ? strlen(txt) : 0;
+
+    return rec != NULL && rec->rdlength == 1 + len && rec->rdata[0] == len
+           && (len == 0 || memcmp(rec->rdata + 1, txt, len) == 0);
+}
+
+/* ---------- name parser ---------- */
+
+static void test_name_parse(void)
+{
+    char name[DNS_NAME_MAX_LEN];
+    uint8_t pkt[512];
+
+    printf("name parse\n");
+
+    // 普通名字返回名字之后的偏移
+    size_t end = put_name(pkt, 0, "www.example.com");
+    CHECK(dns_name_parse(pkt, end, 0, name, sizeof(name)) == (int) end);
+    CHECK(strcmp(name, "www.example.com") == 0);
+
+    // 根名字
+    pkt[0] = 0;
+    CHECK(dns_name_parse(pkt, 1, 0, name, sizeof(name)) == 1);
+    CHECK(name[0] == '\0');
+
+    // 压缩：label 后接指针，返回指针之后的偏移而不是目标的
+    end = put_name(pkt, 0, "example.com");
+    size_t second = end;
+    pkt[end++] = 3;
+    memcpy(pkt + end, "www", 3);
+    end += 3;
+    pkt[end++] = 0xC0;
+    pkt[end++] = 0;
+    pkt[end++] = 0xAA;      // 名字之后的数据
+    CHECK(dns_name_parse(pkt, end, second, name, sizeof(name)) == (int) end - 1);
+    CHECK(strcmp(name, "www.example.com") == 0);
+
+    // 只有指针
+    pkt[0] = 0xC0;
+    pkt[1] = 2;
+    put_name(pkt, 2, "local");
+    CHECK(dns_name_parse(pkt, 9, 0, name, sizeof(name)) == 2);
+    CHECK(strcmp(name, "local") == 0);
+
+    // 指针环：自己指向自己、两个互指
+    pkt[0] = 0xC0;
+    pkt[1] = 0;
+    CHECK(dns_name_parse(pkt, 2, 0, name, sizeof(name)) == -1);
+    pkt[0] = 0xC0;
+    pkt[1] = 2;
+    pkt[2] = 0xC0;
+    pkt[3] = 0;
+    CHECK(dns_name_parse(pkt, 4, 0, name, sizeof(name)) == -1);
+
+    // 指针越界、指针只有一个字节
+    pkt[0] = 0xC0;
+    pkt[1] = 0x40;
+    CHECK(dns_name_parse(pkt, 2, 0, name, sizeof(name)) == -1);
+    CHECK(dns_name_parse(pkt, 1, 0, name, sizeof(name)) == -1);
+
+    // 截断：label 超出包尾、缺少结尾的 0
+    end = put_name(pkt, 0, "example.com");
+    for (size_t len = 0; len < end; ++len) {
+        CHECK(dns_name_parse(pkt, len, 0, name, sizeof(name)) == -1);
+    }
+    CHECK(dns_name_parse(pkt, end, end, name, sizeof(name)) == -1);
+
+    // 0x40/0x80 开头的 label 类型不支持
+    pkt[0] = 0x40;
+    pkt[1] = 0;
+    CHECK(dns_name_parse(pkt, 2, 0, name, sizeof(name)) == -1);
+    pkt[0] = 0x80;
+    CHECK(dns_name_parse(pkt, 2, 0, name, sizeof(name)) == -1);
+
+    // 63 字节的 label 可以，长度刚好放下和差一个字节
+    char label[64];
+    memset(label, 'a', 63);
+    label[63] = '\0';
+    end = put_name(pkt, 0, label);
+    CHECK(dns_name_parse(pkt, end, 0, name, sizeof(name)) == (int) end);
+    CHECK(strlen(name) == 63);
+    CHECK(dns_name_parse(pkt, end, 0, name, 64) == (int) end);
+    CHECK(dns_name_parse(pkt, end, 0, name, 63) == -1);
+    CHECK(dns_name_parse(pkt, end, 0, name, 0) == -1);
+
+    // 超过 DNS_NAME_MAX_LEN 的名字，包括用指针拼出来的
+    char longname[3 * 64];
+    snprintf(longname, sizeof(longname), "%s.%s", label, label);
+    end = put_name(pkt, 0, longname);
+    CHECK(dns_name_parse(pkt, end, 0, name, sizeof(name)) == (int) end);
+    second = end;
+    pkt[end++] = 63;
+    memcpy(pkt + end, label, 63);
+    end += 63;
+    pkt[end++] = 0xC0;
+    pkt[end++] = 0;
+    CHECK(dns_name_parse(pkt, end, second, name, sizeof(name)) == -1);
+}
+
+/* ---------- mDNS responder ---------- */
+
+static void test_query_a(void)
+{
+    uint8_t query[512], reply[512];
+    reply_t r;
+    bool unicast;
+
+    printf("A\n");
+    size_t len = build_query(query, "menjin.local", DNS_TYPE_A, 1);
+    int reply_len = mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast);
+    CHECK(reply_len > 0);
+    CHECK(read_reply(reply, reply_len, &r));
+    CHECK(!unicast);
+    // 组播应答：id 0，QR|AA，不带问题
+    CHECK(r.id == 0 && r.flags == 0x8400 && r.qd_count == 0);
+    CHECK(r.an_count == 1 && r.ar_count == 0);
+    CHECK(check_a(answer(&r, "menjin.local", DNS_TYPE_A)));
+    CHECK(r.rec[0].class == 0x8001 && r.rec[0].ttl == 120);
+
+    // 主机名不区分大小写
+    len = build_query(query, "MenJin.Local", DNS_TYPE_A, 1);
+    CHECK(mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast) > 0);
+
+    // 别的名字、别的类型、别的 class 都不答
+    len = build_query(query, "other.local", DNS_TYPE_A, 1);
+    CHECK(mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast) == 0);
+    len = build_query(query, "menjin.local", DNS_TYPE_TXT, 1);
+    CHECK(mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast) == 0);
+    len = build_query(query, "menjin.local", DNS_TYPE_A, 3);
+    CHECK(mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast) == 0);
+
+    // 其他应答者的响应和非标准查询忽略
+    len = build_query(query, "menjin.local", DNS_TYPE_A, 1);
+    query[2] = 0x84;
+    CHECK(mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast) == 0);
+    query[2] = 0x28;
+    CHECK(mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast) == 0);
+}
+
+static void test_query_ptr(void)
+{
+    uint8_t query[512], reply[512];
+    reply_t r;
+    bool unicast;
+
+    printf("PTR\n");
+    size_t len = build_query(query, "_http._tcp.local", DNS_TYPE_PTR, 1);
+    int reply_len = mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast);
+    CHECK(reply_len > 0);
+    CHECK(read_reply(reply, reply_len, &r));
+    CHECK(r.an_count == 1 && r.ar_count == 3);
+
+    const record_t *ptr = answer(&r, "_http._tcp.local", DNS_TYPE_PTR);
+    CHECK(ptr != NULL && rdata_name(reply, reply_len, ptr, 0, "menjin._http._tcp.local"));
+    // 共享记录不带 cache-flush
+    CHECK(ptr != NULL && ptr->class == 1 && ptr->ttl == 4500);
+
+    // 附加段带上解析实例需要的 SRV/TXT/A
+    const record_t *srv = additional(&r, "menjin._http._tcp.local", DNS_TYPE_SRV);
+    CHECK(check_srv(reply, reply_len, srv, 80));
+    CHECK(srv != NULL && srv->class == 0x8001 && srv->ttl == 120);
+    const record_t *txt = additional(&r, "menjin._http._tcp.local", DNS_TYPE_TXT);
+    CHECK(check_txt(txt, "path=/"));
+    CHECK(txt != NULL && txt->class == 0x8001 && txt->ttl == 4500);
+    CHECK(check_a(additional(&r, "menjin.local", DNS_TYPE_A)));
+
+    // 服务枚举
+    len = build_query(query, "_services._dns-sd._udp.local", DNS_TYPE_PTR, 1);
+    reply_len = mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast);
+    CHECK(read_reply(reply, reply_len, &r));
+    CHECK(r.an_count == 2 && r.ar_count == 0);
+    CHECK(r.rec[0].type == DNS_TYPE_PTR && rdata_name(reply, reply_len, &r.rec[0], 0, "_http._tcp.local"));
+    CHECK(r.rec[1].type == DNS_TYPE_PTR && rdata_name(reply, reply_len, &r.rec[1], 0, "_menjin._tcp.local"));
+
+    // 没有的服务
+    len = build_query(query, "_ipp._tcp.local", DNS_TYPE_PTR, 1);
+    CHECK(mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast) == 0);
+}
+
+static void test_query_srv_txt(void)
+{
+    uint8_t query[512], reply[512];
+    reply_t r;
+    bool unicast;
+
+    printf("SRV/TXT\n");
+    size_t len = build_query(query, "menjin._menjin._tcp.local", DNS_TYPE_SRV, 1);
+    int reply_len = mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast);
+    CHECK(read_reply(reply, reply_len, &r));
+    CHECK(r.an_count == 1 && r.ar_count == 1);
+    CHECK(check_srv(reply, reply_len, answer(&r, "menjin._menjin._tcp.local", DNS_TYPE_SRV), 8266));
+    CHECK(check_a(additional(&r, "menjin.local", DNS_TYPE_A)));
+
+    // 没有 TXT 内容时给一个空字符串
+    len = build_query(query, "menjin._menjin._tcp.local", DNS_TYPE_TXT, 1);
+    reply_len = mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast);
+    CHECK(read_reply(reply, reply_len, &r));
+    CHECK(r.an_count == 1 && r.ar_count == 0);
+    CHECK(check_txt(answer(&r, "menjin._menjin._tcp.local", DNS_TYPE_TXT), NULL));
+
+    // ANY：SRV 和 TXT 都答，A 只在附加段
+    len = build_query(query, "menjin._http._tcp.local", DNS_TYPE_ANY, 255);
+    reply_len = mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast);
+    CHECK(read_reply(reply, reply_len, &r));
+    CHECK(r.an_count == 2 && r.ar_count == 1);
+    CHECK(check_srv(reply, reply_len, answer(&r, "menjin._http._tcp.local", DNS_TYPE_SRV), 80));
+    CHECK(check_txt(answer(&r, "menjin._http._tcp.local", DNS_TYPE_TXT), "path=/"));
+    CHECK(check_a(additional(&r, "menjin.local", DNS_TYPE_A)));
+}
+
+static void test_query_multi(void)
+{
+    uint8_t query[512], reply[512];
+    reply_t r;
+    bool unicast;
+
+    printf("several questions\n");
+    // 同一个包里问 A 和 PTR，A 已经在答案里就不再进附加段；第二个问题用压缩指针
+    size_t len = build_query(query, "menjin.local", DNS_TYPE_A, 1);
+    query[5] = 2;
+    // 去掉 put_name 写的结尾 0，改成指向第一个问题里的 "local"
+    len = put_name(query, len, "_http._tcp") - 1;
+    query[len++] = 0xC0;
+    query[len++] = DNS_HEADER_LEN + 7;      // "local" in the first question
+    query[len++] = 0;
+    query[len++] = DNS_TYPE_PTR;
+    query[len++] = 0;
+    query[len++] = 1;
+
+    int reply_len = mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast);
+    CHECK(read_reply(reply, reply_len, &r));
+    CHECK(r.an_count == 2 && r.ar_count == 2);
+    CHECK(check_a(answer(&r, "menjin.local", DNS_TYPE_A)));
+    CHECK(answer(&r, "_http._tcp.local", DNS_TYPE_PTR) != NULL);
+    CHECK(additional(&r, "menjin.local", DNS_TYPE_A) == NULL);
+
+    // 问题个数比实际多：格式错误
+    query[5] = 3;
+    CHECK(mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast) == -1);
+    // 截断的问题
+    query[5] = 2;
+    CHECK(mdns_build_response(query, len - 1, &g_host, false, reply, sizeof(reply), &unicast) == -1);
+    CHECK(mdns_build_response(query, DNS_HEADER_LEN - 1, &g_host, false, reply, sizeof(reply), &unicast) == -1);
+}
+
+static void test_unicast_legacy(void)
+{
+    uint8_t query[512], reply[512];
+    reply_t r;
+    bool unicast;
+
+    printf("QU and legacy\n");
+    // QU 位：请求单播应答
+    size_t len = build_query(query, "menjin.local", DNS_TYPE_A, 0x8001);
+    int reply_len = mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast);
+    CHECK(reply_len > 0 && unicast);
+    CHECK(read_reply(reply, reply_len, &r) && r.an_count == 1);
+
+    // QU 但不是问我们的：不答，也不要求单播
+    len = build_query(query, "other.local", DNS_TYPE_A, 0x8001);
+    CHECK(mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast) == 0 && !unicast);
+
+    // legacy：回显 id 和问题，短 TTL，不带 cache-flush
+    len = build_query(query, "menjin._http._tcp.local", DNS_TYPE_SRV, 1);
+    reply_len = mdns_build_response(query, len, &g_host, true, reply, sizeof(reply), &unicast);
+    CHECK(read_reply(reply, reply_len, &r));
+    CHECK(r.id == 0x1234 && r.qd_count == 1);
+    CHECK(memcmp(reply + DNS_HEADER_LEN, query + DNS_HEADER_LEN, len - DNS_HEADER_LEN) == 0);
+    CHECK(r.an_count == 1 && r.ar_count == 1);
+    const record_t *srv = answer(&r, "menjin._http._tcp.local", DNS_TYPE_SRV);
+    CHECK(check_srv(reply, reply_len, srv, 80));
+    for (int i = 0; i < r.an_count + r.ar_count; ++i) {
+        CHECK(r.rec[i].class == 1 && r.rec[i].ttl == 10);
+    }
+}
+
+static void test_limits(void)
+{
+    uint8_t query[512], reply[512];
+    bool unicast;
+
+    printf("limits\n");
+    // 答案放不下：失败；附加记录放不下：省掉
+    size_t len = build_query(query, "_http._tcp.local", DNS_TYPE_PTR, 1);
+    int full = mdns_build_response(query, len, &g_host, false, reply, sizeof(reply), &unicast);
+    CHECK(full > 0);
+    for (int max = DNS_HEADER_LEN; max < full; ++max) {
+        reply_t r;
+        int reply_len = mdns_build_response(query, len, &g_host, false, reply, max, &unicast);
+        CHECK(reply_len == -1 || (reply_len <= max && read_reply(reply, reply_len, &r) && r.an_count == 1
+                                  && r.ar_count < 3));
+    }
+
+    mdns_host_t host = g_host;
+    host.num_of_services = MDNS_MAX_SERVICES + 1;
+    CHECK(mdns_build_response(query, len, &host, false, reply, sizeof(reply), &unicast) == -1);
+    CHECK(mdns_build_announce(&host, reply, sizeof(reply)) == -1);
+
+    // TXT 超过 255 字节
+    char txt[300];
+    memset(txt, 'x', sizeof(txt) - 1);
+    txt[sizeof(txt) - 1] = '\0';
+    mdns_service_t service = {.type = "_http._tcp", .port = 80, .txt = txt};
+    host.num_of_services = 1;
+    host.service = &service;
+    len = build_query(query, "menjin._http._tcp.local", DNS_TYPE_TXT, 1);
+    CHECK(mdns_build_response(query, len, &host, false, reply, sizeof(reply), &unicast) == -1);
+}
+
+static void test_announce(void)
+{
+    uint8_t reply[512];
+    reply_t r;
+
+    printf("announce\n");
+    int reply_len = mdns_build_announce(&g_host, reply, sizeof(reply));
+    CHECK(reply_len > 0);
+    CHECK(read_reply(reply, reply_len, &r));
+    CHECK(r.id == 0 && r.flags == 0x8400 && r.qd_count == 0);
+    // A，每个服务一条枚举 PTR、实例 PTR、SRV、TXT
+    CHECK(r.an_count == 1 + 4 * 2 && r.ar_count == 0);
+    CHECK(check_a(answer(&r, "menjin.local", DNS_TYPE_A)));
+    for (int i = 0; i < 2; ++i) {
+        char type[64], instance[64];
+        snprintf(type, sizeof(type), "%s.local", g_services[i].type);
+        snprintf(instance, sizeof(instance), "menjin.%s.local", g_services[i].type);
+        CHECK(find(&r, 0, r.an_count, "_services._dns-sd._udp.local", DNS_TYPE_PTR) != NULL);
+        const record_t *ptr = answer(&r, type, DNS_TYPE_PTR);
+        CHECK(ptr != NULL && rdata_name(reply, reply_len, ptr, 0, instance));
+        CHECK(check_srv(reply, reply_len, answer(&r, instance, DNS_TYPE_SRV), g_services[i].port));
+        CHECK(check_txt(answer(&r, instance, DNS_TYPE_TXT), g_services[i].txt));
+    }
+    printf("  announce for 2 services: %d bytes\n", reply_len);
+
+    // 放不下就失败，不发半个公告
+    CHECK(mdns_build_announce(&g_host, reply, reply_len - 1) == -1);
+
+    // MDNS_MAX_SERVICES 个服务的公告超过 DNS_MAX_LEN (512)：在 512 里要么放下要么失败，不能写出界
+    static const char *types[MDNS_MAX_SERVICES] = {
+            "_http._tcp", "_menjin._tcp", "_a._tcp", "_b._tcp", "_c._tcp", "_d._tcp", "_e._udp",
+    };
+    mdns_service_t services[MDNS_MAX_SERVICES];
+    uint8_t big[1024];
+    for (int i = 0; i < MDNS_MAX_SERVICES; ++i) {
+        services[i] = (mdns_service_t) {.type = types[i], .port = 80, .txt = "path=/"};
+    }
+    for (int n = 1; n <= MDNS_MAX_SERVICES; ++n) {
+        mdns_host_t host = {.hostname = "menjin", .ip = HOST_IP, .num_of_services = n, .service = services};
+        memset(big, 0xA5, sizeof(big));
+        int fit = mdns_build_announce(&host, big, 512);
+        CHECK(fit == -1 || fit <= 512);
+        CHECK(big[512] == 0xA5);
+        reply_len = mdns_build_announce(&host, big, sizeof(big));
+        printf("  announce for %d services: %d bytes%s\n", n, reply_len, fit < 0 ? ", over 512" : "");
+        CHECK(reply_len > 0 && read_reply(big, reply_len, &r) && r.an_count == 1 + 4 * n);
+        CHECK(fit < 0 || fit == reply_len);
+    }
+}
+
+int main(void)
+{
+    test_name_parse();
+    test_query_a();
+    test_query_ptr();
+    test_query_srv_txt();
+    test_query_multi();
+    test_unicast_legacy();
+    test_limits();
+    test_announce();
+
+    printf("%d checks, %d failed\n", g_checks, g_failures);
+
+    return g_failures != 0;
+}
@@ -0,0 +1,168 @@
+// Host test for i2c_health: the recovery policy (error threshold, attempts in a row, reset on
+// success, counters per event) and i2c_bus_recover() against a slave that holds SDA low for a
+// given number of clocks. The same recovery running inside the writer task against the
+// simulated controller is checked by tools/menjin_bench.
+//
+//     cc -O2 -Wall -Wextra -Icomponents/menjin_core/include -o i2c_health_test tools/i2c_health_test.c components/menjin_core/i2c_health.c
+//     ./i2c_health_test
+
+#include <stdio.h>
+#include "i2c_health.h"
+
+static int g_checks = 0;
+static int g_failures = 0;
+
+#define CHECK(cond) do { \
+        g_checks++; \
+        if (!(cond)) { \
+            g_failures++; \
+            printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+/* ---------- policy ---------- */
+
+static void test_threshold(void)
+{
+    i2c_health_t h;
+
+    printf("threshold\n");
+    i2c_health_init(&h, 3, 2);
+    CHECK(i2c_health_record(&h, I2C_HEALTH_NACK) == I2C_HEALTH_ACTION_NONE);
+    CHECK(i2c_health_record(&h, I2C_HEALTH_TIMEOUT) == I2C_HEALTH_ACTION_NONE);
+    CHECK(i2c_health_record(&h, I2C_HEALTH_ARB_LOST) == I2C_HEALTH_ACTION_RECOVER);
+    CHECK(h.stats.nack == 1 && h.stats.timeout == 1 && h.stats.arb_lost == 1);
+    CHECK(h.stats.recoveries == 1);
+    CHECK(h.stats.consecutive == 0);
+
+    // 一次成功清零连续错误，阈值重新计数
+    i2c_health_init(&h, 3, 2);
+    i2c_health_record(&h, I2C_HEALTH_NACK);
+    i2c_health_record(&h, I2C_HEALTH_NACK);
+    CHECK(i2c_health_record(&h, I2C_HEALTH_OK) == I2C_HEALTH_ACTION_NONE);
+    CHECK(h.stats.consecutive == 0);
+    CHECK(i2c_health_record(&h, I2C_HEALTH_NACK) == I2C_HEALTH_ACTION_NONE);
+    CHECK(i2c_health_record(&h, I2C_HEALTH_NACK) == I2C_HEALTH_ACTION_NONE);
+    CHECK(i2c_health_record(&h, I2C_HEALTH_NACK) == I2C_HEALTH_ACTION_RECOVER);
+    CHECK(h.stats.ok == 1 && h.stats.nack == 5);
+
+    // 阈值 0 按 1 处理：每个错误都恢复
+    i2c_health_init(&h, 0, 5);
+    CHECK(i2c_health_record(&h, I2C_HEALTH_STUCK) == I2C_HEALTH_ACTION_RECOVER);
+    CHECK(h.stats.stuck == 1);
+}
+
+static void test_recover_max(void)
+{
+    i2c_health_t h;
+    int recoveries = 0;
+
+    printf("recover_max\n");
+    i2c_health_init(&h, 2, 3);
+    for (int i = 0; i < 20; ++i) {
+        if (i2c_health_record(&h, I2C_HEALTH_TIMEOUT) == I2C_HEALTH_ACTION_RECOVER) {
+            recoveries++;
+            i2c_health_recovered(&h, false);
+        }
+    }
+    // 连续失败只恢复 recover_max 次，之后放弃
+    CHECK(recoveries == 3);
+    CHECK(h.stats.recoveries == 3);
+    CHECK(h.stats.recover_failed == 3);
+    CHECK(h.stats.timeout == 20);
+
+    // 下一次成功后重新允许恢复
+    i2c_health_record(&h, I2C_HEALTH_OK);
+    i2c_health_record(&h, I2C_HEALTH_ERROR);
+    CHECK(i2c_health_record(&h, I2C_HEALTH_ERROR) == I2C_HEALTH_ACTION_RECOVER);
+    i2c_health_recovered(&h, true);
+    CHECK(h.stats.error == 2);
+    CHECK(h.stats.recoveries == 4);
+    CHECK(h.stats.recover_failed == 3);
+}
+
+/* ---------- bus recovery ---------- */
+
+// 从机在第 hold 个 SCL 下降沿之后释放 SDA，hold > 9 时一直不放
+typedef struct {
+    int scl;
+    int sda_master;
+    int hold;
+    int falling_edges;
+    int stop_seen;
+} sim_bus_t;
+
+static int sim_sda(const sim_bus_t *bus)
+{
+    bool slave_low = bus->hold > I2C_BUS_RECOVER_CLOCKS || bus->falling_edges < bus->hold;
+
+    return bus->sda_master && !slave_low;
+}
+
+static void sim_scl_set(void *ctx, int level)
+{
+    sim_bus_t *bus = ctx;
+
+    if (bus->scl && !level) {
+        bus->falling_edges++;
+    }
+    bus->scl = level;
+}
+
+static void sim_sda_set(void *ctx, int level)
+{
+    sim_bus_t *bus = ctx;
+    int before = sim_sda(bus);
+
+    bus->sda_master = level;
+    // STOP：SCL 为高时 SDA 上升
+    if (bus->scl && !before && sim_sda(bus)) {
+        bus->stop_seen = 1;
+    }
+}
+
+static int sim_sda_get(void *ctx)
+{
+    return sim_sda(ctx);
+}
+
+static void sim_delay_us(void *ctx, uint32_t us)
+{
+    (void) ctx;
+    (void) us;
+}
+
+static void test_bus_recover(void)
+{
+    printf("bus recover\n");
+    for (int hold = 0; hold <= I2C_BUS_RECOVER_CLOCKS + 1; ++hold) {
+        sim_bus_t bus = {.scl = 1, .sda_master = 1, .hold = hold};
+        i2c_bus_ops_t ops = {
+                .scl_set = sim_scl_set,
+                .sda_set = sim_sda_set,
+                .sda_get = sim_sda_get,
+                .delay_us = sim_delay_us,
+                .ctx = &bus,
+        };
+
+        bool released = i2c_bus_recover(&ops, 5);
+        printf("  hold %2d clocks: %s after %d falling edges, stop %s\n", hold, released ? "released" : "stuck",
+               bus.falling_edges, bus.stop_seen ? "sent" : "missing");
+        CHECK(released == (hold <= I2C_BUS_RECOVER_CLOCKS));
+        CHECK(!released || bus.stop_seen);
+        // 只打需要的时钟数，另加 STOP 前的一个下降沿
+        CHECK(bus.falling_edges <= (hold < I2C_BUS_RECOVER_CLOCKS ? hold : I2C_BUS_RECOVER_CLOCKS) + 1);
+        CHECK(bus.scl == 1);
+    }
+}
+
+int main(void)
+{
+    test_threshold();
+    test_recover_max();
+    test_bus_recover();
+
+    printf("%d checks, %d failed\n", g_checks, g_failures);
+
+    return g_failures != 0;
+}
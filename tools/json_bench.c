@@ -0,0 +1,215 @@
+// Host microbenchmark: json_writer against cJSON for the documents served by the web API.
+// Reports heap peak, allocation count and time per document.
+//
+//     J=$IDF_PATH/components/json/cJSON
+//     cc -O2 -Imain/wifi -I$J -o json_bench tools/json_bench.c main/wifi/json_writer.c $J/cJSON.c
+//     ./json_bench [iterations]
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cJSON.h"
+#include "json_writer.h"
+
+#define BENCH_BUF_SIZE  512             // JSON_BUF_SIZE in captive_portal.c
+#define BENCH_SCAN_APS  10
+
+// 每块分配前记录大小，统计峰值
+typedef struct {
+    size_t size;
+    max_align_t align;
+} alloc_head_t;
+
+static size_t g_heap_now = 0;
+static size_t g_heap_peak = 0;
+static size_t g_allocs = 0;
+
+static void *counting_malloc(size_t size)
+{
+    alloc_head_t *head = malloc(sizeof(alloc_head_t) + size);
+    if (head == NULL) {
+        return NULL;
+    }
+    head->size = size;
+    g_heap_now += size;
+    g_allocs++;
+    if (g_heap_now > g_heap_peak) {
+        g_heap_peak = g_heap_now;
+    }
+
+    return head + 1;
+}
+
+static void counting_free(void *ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+    alloc_head_t *head = (alloc_head_t *) ptr - 1;
+    g_heap_now -= head->size;
+    free(head);
+}
+
+static const char *g_ssids[BENCH_SCAN_APS] = {
+        "ChinaNet-8F2A", "TP-LINK_5G_3C1D", "MERCURY_\"Home\"", "Xiaomi_A1B2", "HUAWEI-10FD",
+        "CMCC-kkQ9", "office\\guest", "ESP_MENJIN", "小区免费WiFi", "DIRECT-7e-HP M428",
+};
+
+/* ---------- cJSON ---------- */
+
+static char *cjson_stats(void)
+{
+    cJSON *root = cJSON_CreateObject();
+    const char *groups[] = {"queue", "bridge", "lan"};
+    for (int g = 0; g < 3; ++g) {
+        cJSON *obj = cJSON_AddObjectToObject(root, groups[g]);
+        char key[24];
+        for (int i = 0; i < 12; ++i) {
+            snprintf(key, sizeof(key), "counter_%d", i);
+            cJSON_AddNumberToObject(obj, key, 123456 + i * 7);
+        }
+    }
+    cJSON *health = cJSON_AddObjectToObject(root, "health");
+    const char *buses[] = {"master", "keyboard"};
+    for (int b = 0; b < 2; ++b) {
+        cJSON *obj = cJSON_AddObjectToObject(health, buses[b]);
+        cJSON_AddNumberToObject(obj, "ok", 98765);
+        cJSON_AddNumberToObject(obj, "nack", 3);
+        cJSON_AddNumberToObject(obj, "timeout", 1);
+        cJSON_AddNumberToObject(obj, "recoveries", 1);
+    }
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+
+    return json;
+}
+
+static char *cjson_scan(void)
+{
+    cJSON *root = cJSON_CreateArray();
+    for (int i = 0; i < BENCH_SCAN_APS; ++i) {
+        cJSON *item = cJSON_CreateObject();
+        cJSON_AddStringToObject(item, "ssid", g_ssids[i]);
+        cJSON_AddNumberToObject(item, "rssi", -40 - i * 5);
+        cJSON_AddItemToArray(root, item);
+    }
+    char *json = cJSON_PrintUnformatted(root);
+    cJSON_Delete(root);
+
+    return json;
+}
+
+/* ---------- json_writer ---------- */
+
+typedef struct {
+    size_t bytes;
+    size_t flushes;
+} sink_t;
+
+static int sink_flush(void *ctx, const char *data, size_t len, bool last)
+{
+    sink_t *sink = ctx;
+    sink->bytes += len;
+    sink->flushes++;
+
+    return 0;
+}
+
+static void writer_stats(json_writer_t *w)
+{
+    const char *groups[] = {"queue", "bridge", "lan"};
+    json_writer_object_start(w, NULL);
+    for (int g = 0; g < 3; ++g) {
+        json_writer_object_start(w, groups[g]);
+        char key[24];
+        for (int i = 0; i < 12; ++i) {
+            snprintf(key, sizeof(key), "counter_%d", i);
+            json_writer_int(w, key, 123456 + i * 7);
+        }
+        json_writer_object_end(w);
+    }
+    json_writer_object_start(w, "health");
+    const char *buses[] = {"master", "keyboard"};
+    for (int b = 0; b < 2; ++b) {
+        json_writer_object_start(w, buses[b]);
+        json_writer_int(w, "ok", 98765);
+        json_writer_int(w, "nack", 3);
+        json_writer_int(w, "timeout", 1);
+        json_writer_int(w, "recoveries", 1);
+        json_writer_object_end(w);
+    }
+    json_writer_object_end(w);
+    json_writer_object_end(w);
+}
+
+static void writer_scan(json_writer_t *w)
+{
+    json_writer_array_start(w, NULL);
+    for (int i = 0; i < BENCH_SCAN_APS; ++i) {
+        json_writer_object_start(w, NULL);
+        json_writer_string(w, "ssid", g_ssids[i]);
+        json_writer_int(w, "rssi", -40 - i * 5);
+        json_writer_object_end(w);
+    }
+    json_writer_array_end(w);
+}
+
+/* ---------- driver ---------- */
+
+static double now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void bench(const char *name, char *(*build_cjson)(void), void (*build_writer)(json_writer_t *), int iterations)
+{
+    char buf[BENCH_BUF_SIZE];
+    json_writer_t w;
+    sink_t sink;
+    size_t cjson_bytes = 0;
+
+    g_heap_now = g_heap_peak = g_allocs = 0;
+    double start = now_us();
+    for (int i = 0; i < iterations; ++i) {
+        char *json = build_cjson();
+        cjson_bytes = strlen(json);
+        cJSON_free(json);
+    }
+    double cjson_us = (now_us() - start) / iterations;
+    size_t cjson_peak = g_heap_peak;
+    size_t cjson_allocs = g_allocs / iterations;
+
+    start = now_us();
+    for (int i = 0; i < iterations; ++i) {
+        memset(&sink, 0, sizeof(sink));
+        json_writer_init(&w, buf, sizeof(buf), sink_flush, &sink);
+        build_writer(&w);
+        if (json_writer_finish(&w) != 0) {
+            fprintf(stderr, "%s: json_writer failed\n", name);
+            exit(1);
+        }
+    }
+    double writer_us = (now_us() - start) / iterations;
+
+    printf("%-6s cJSON:       %5zu bytes  heap peak %6zu B  %4zu allocs  %8.2f us\n",
+           name, cjson_bytes, cjson_peak, cjson_allocs, cjson_us);
+    printf("%-6s json_writer: %5zu bytes  heap peak %6d B  %4d allocs  %8.2f us  (%zu B stack, %zu flushes)\n",
+           name, sink.bytes, 0, 0, writer_us, sizeof(buf) + sizeof(w), sink.flushes);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? atoi(argv[1]) : 20000;
+    cJSON_Hooks hooks = {.malloc_fn = counting_malloc, .free_fn = counting_free};
+    cJSON_InitHooks(&hooks);
+
+    bench("stats", cjson_stats, writer_stats, iterations);
+    bench("scan", cjson_scan, writer_scan, iterations);
+
+    return 0;
+}
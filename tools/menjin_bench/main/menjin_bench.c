@@ -0,0 +1,264 @@
+// Throughput and latency of the command queue and the keyboard bridge, through the same
+// app_menjin.c code as the board with the simulated controller and keyboard (menjin_bus_sim.c)
+// in place of the I2C buses. Each write occupies the simulated bus for as long as the frame
+// would take at the clock under test.
+//
+// Heap churn: malloc/calloc/realloc/free are wrapped at link time (main/CMakeLists.txt) and
+// counted while a stage runs; the command path must not touch the heap.
+//
+// Before the benchmarks, the controller is made to hold SDA after a timeout and the health
+// supervisor must clock it free through the writer task. Any failed check exits non-zero.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+#include "app_menjin.h"
+#include "menjin_sim.h"
+#include "i2c_health.h"
+#include "latency_hist.h"
+
+#define BENCH_ADDR          0x50
+#define BENCH_COMMANDS      2000        // per clock, through the queue
+#define BENCH_FRAMES        200         // per clock, through the keyboard bridge
+
+static const uint32_t g_clocks[] = {10000, 50000, 100000, 400000};
+
+static SemaphoreHandle_t g_done = NULL;
+static int g_failed = 0;
+
+// 链接时用 --wrap 截获的堆操作计数
+static uint32_t g_allocs = 0;
+static uint32_t g_frees = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void *__wrap_malloc(size_t size)
+{
+    __atomic_add_fetch(&g_allocs, 1, __ATOMIC_RELAXED);
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+    __atomic_add_fetch(&g_allocs, 1, __ATOMIC_RELAXED);
+    return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    __atomic_add_fetch(&g_allocs, 1, __ATOMIC_RELAXED);
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr)
+{
+    if (ptr != NULL) {
+        __atomic_add_fetch(&g_frees, 1, __ATOMIC_RELAXED);
+    }
+    __real_free(ptr);
+}
+
+typedef struct {
+    int64_t start_us;
+    uint32_t allocs;
+    uint32_t frees;
+} bench_mark_t;
+
+static void bench_mark(bench_mark_t *mark)
+{
+    mark->allocs = __atomic_load_n(&g_allocs, __ATOMIC_RELAXED);
+    mark->frees = __atomic_load_n(&g_frees, __ATOMIC_RELAXED);
+    mark->start_us = esp_timer_get_time();
+}
+
+static void bench_done_cb(uint8_t cmd, size_t len, esp_err_t ret, void *arg)
+{
+    if (arg != NULL) {
+        *(esp_err_t *) arg = ret;
+    }
+    xSemaphoreGive(g_done);
+}
+
+static esp_err_t bench_write(uint8_t cmd)
+{
+    esp_err_t ret = ESP_OK;
+
+    ESP_ERROR_CHECK(menjin_cmd_enqueue(cmd, MENJIN_PRIO_REMOTE, bench_done_cb, &ret));
+    xSemaphoreTake(g_done, portMAX_DELAY);
+
+    return ret;
+}
+
+/**
+ * @brief A timeout leaves the controller holding SDA; the supervisor must free the bus
+ *
+ * @param hold_clocks clocks the controller needs to release SDA, above I2C_BUS_RECOVER_CLOCKS never
+ */
+static void bench_recovery(uint8_t hold_clocks)
+{
+    static const esp_err_t script[] = {ESP_ERR_TIMEOUT};
+    i2c_health_stats_t before, after, keyboard;
+    bool releases = hold_clocks <= I2C_BUS_RECOVER_CLOCKS;
+    // 放不开时每次恢复都失败，直到恢复次数用完，再多写一次确认已经放弃
+    int writes = CONFIG_MENJIN_I2C_ERROR_THRESHOLD * (CONFIG_MENJIN_I2C_RECOVER_MAX + 1) + 1;
+    int failed = 0;
+
+    menjin_sim_reset();
+    menjin_sim_controller_set_hold_clocks(hold_clocks);
+    menjin_sim_controller_script(script, 1);
+    menjin_get_health_stats(&before, &keyboard);
+
+    for (int i = 0; i < writes; ++i) {
+        if (bench_write(MENJIN_CMD_KEY1) != ESP_OK) {
+            failed++;
+        }
+    }
+    menjin_get_health_stats(&after, &keyboard);
+
+    uint32_t recoveries = after.recoveries - before.recoveries;
+    uint32_t recover_failed = after.recover_failed - before.recover_failed;
+    bool ok;
+    if (releases) {
+        // 超时把总线卡住，之后每次都超时，达到阈值恢复一次即可
+        ok = failed == CONFIG_MENJIN_I2C_ERROR_THRESHOLD && recoveries == 1 && recover_failed == 0
+             && after.timeout - before.timeout == CONFIG_MENJIN_I2C_ERROR_THRESHOLD;
+    } else {
+        ok = failed == writes && recoveries == CONFIG_MENJIN_I2C_RECOVER_MAX
+             && recover_failed == CONFIG_MENJIN_I2C_RECOVER_MAX;
+    }
+    printf("recovery, SDA held %2d clocks: %d of %d writes failed, %" PRIu32 " recoveries, %" PRIu32
+           " failed: %s\n", hold_clocks, failed, writes, recoveries, recover_failed, ok ? "ok" : "FAIL");
+    if (!ok) {
+        g_failed = 1;
+    }
+
+    // 放开总线，一次成功的写入清零恢复次数
+    menjin_sim_reset();
+    if (bench_write(MENJIN_CMD_KEY1) != ESP_OK) {
+        printf("recovery, SDA held %2d clocks: bus still failing after reset: FAIL\n", hold_clocks);
+        g_failed = 1;
+    }
+}
+
+static void bench_print(const char *name, uint32_t clock, int count, const bench_mark_t *mark,
+                        const latency_hist_t *hist, uint32_t failed)
+{
+    int64_t elapsed_us = esp_timer_get_time() - mark->start_us;
+    uint32_t allocs = __atomic_load_n(&g_allocs, __ATOMIC_RELAXED) - mark->allocs;
+    uint32_t frees = __atomic_load_n(&g_frees, __ATOMIC_RELAXED) - mark->frees;
+
+    printf("%-8s %8" PRIu32 " %8d %10.0f %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32 " %8" PRIu32
+           " %8" PRIu32 "\n", name, clock, count, count * 1e6 / elapsed_us, latency_hist_percentile(hist, 50),
+           latency_hist_percentile(hist, 99), hist->max, failed, allocs, frees);
+    if (failed > 0 || allocs > 0) {
+        g_failed = 1;
+    }
+}
+
+/**
+ * @brief Keep the queue full for BENCH_COMMANDS commands, like a burst of remote commands
+ */
+static void bench_queue(uint32_t clock)
+{
+    menjin_queue_stats_t before, after;
+    latency_hist_t hist;
+    bench_mark_t mark;
+
+    menjin_set_clock(clock);
+    // 新的统计窗口，之前的样本不计入
+    menjin_get_latency_hist(&hist);
+    menjin_consume_latency_hist(&hist);
+    menjin_get_queue_stats(&before);
+
+    bench_mark(&mark);
+    for (int i = 0; i < BENCH_COMMANDS; ++i) {
+        uint8_t cmd = MENJIN_CMD_KEY4_SPEAKER + i % 4;
+        // 队列满时等写任务腾出位置
+        while (menjin_cmd_enqueue(cmd, MENJIN_PRIO_REMOTE, bench_done_cb, NULL) == ESP_ERR_NO_MEM) {
+            vTaskDelay(1);
+        }
+    }
+    for (int i = 0; i < BENCH_COMMANDS; ++i) {
+        xSemaphoreTake(g_done, portMAX_DELAY);
+    }
+
+    menjin_get_latency_hist(&hist);
+    menjin_get_queue_stats(&after);
+    bench_print("queue", clock, BENCH_COMMANDS, &mark, &hist, after.failed - before.failed);
+}
+
+/**
+ * @brief Frames of 1..MENJIN_FRAME_MAX bytes from the keyboard, one at a time
+ */
+static void bench_bridge(uint32_t clock)
+{
+    menjin_bridge_stats_t before, stats;
+    latency_hist_t hist;
+    bench_mark_t mark;
+    uint8_t frame[MENJIN_FRAME_MAX];
+
+    menjin_set_clock(clock);
+    latency_hist_reset(&hist);
+    menjin_get_bridge_stats(&before);
+
+    bench_mark(&mark);
+    for (int i = 0; i < BENCH_FRAMES; ++i) {
+        size_t len = 1 + i % MENJIN_FRAME_MAX;
+        for (size_t k = 0; k < len; ++k) {
+            frame[k] = MENJIN_CMD_KEY4_SPEAKER + (i + k) % 4;
+        }
+        menjin_sim_keyboard_inject(frame, len);
+
+        // 等这一帧写入主控，桥接自己记录收到首字节到写完的延迟
+        do {
+            vTaskDelay(1);
+            menjin_get_bridge_stats(&stats);
+        } while (stats.tx_frames - before.tx_frames < i + 1);
+        latency_hist_add(&hist, stats.last_latency_us);
+    }
+
+    bench_print("bridge", clock, BENCH_FRAMES, &mark, &hist,
+                stats.tx_failed - before.tx_failed + stats.dropped - before.dropped);
+}
+
+void app_main(void)
+{
+    menjin_config_t config = {
+            .addr = BENCH_ADDR,
+            .clock = g_clocks[0],
+    };
+
+    // 队列满是压测的常态，不打印
+    esp_log_level_set("APP_MENJIN", ESP_LOG_ERROR);
+    esp_log_level_set("MENJIN_SIM", ESP_LOG_ERROR);
+    ESP_ERROR_CHECK(menjin_init(&config));
+    g_done = xSemaphoreCreateCounting(BENCH_COMMANDS, 0);
+
+    menjin_set_clock(400000);
+    const uint8_t holds[] = {1, 5, I2C_BUS_RECOVER_CLOCKS, I2C_BUS_RECOVER_CLOCKS + 1};
+    for (int i = 0; i < sizeof(holds); ++i) {
+        bench_recovery(holds[i]);
+    }
+    printf("\n");
+
+    printf("%-8s %8s %8s %10s %8s %8s %8s %8s %8s %8s\n", "path", "clock", "count", "per s", "p50 us", "p99 us",
+           "max us", "failed", "allocs", "frees");
+    for (int i = 0; i < sizeof(g_clocks) / sizeof(g_clocks[0]); ++i) {
+        bench_queue(g_clocks[i]);
+    }
+    // 桥接是一帧一帧送的，每秒帧数受等待的 tick 限制，只看延迟
+    for (int i = 0; i < sizeof(g_clocks) / sizeof(g_clocks[0]); ++i) {
+        bench_bridge(g_clocks[i]);
+    }
+
+    exit(g_failed);
+}
@@ -0,0 +1,158 @@
+#!/usr/bin/env python3
+"""LAN control client for esp-menjin32 (CONFIG_MENJIN_LAN_CTRL).
+
+    menjin_lan.py -H 192.168.1.50 -k <hex key> cmd 97
+    menjin_lan.py -H 192.168.1.50 -k <hex key> macro open
+    menjin_lan.py -H 192.168.1.50 -k <hex key> bench -n 200
+
+Frame layout is documented in main/system/lan_frame.h.
+"""
+
+import argparse
+import hashlib
+import hmac
+import os
+import socket
+import struct
+import sys
+import time
+
+MAGIC = b"MJ"
+VERSION = 1
+TYPE_CMD, TYPE_ACK, TYPE_DONE = 0x01, 0x81, 0x82
+TAG_LEN = 16
+ENVELOPE_MAGIC = 0xA5
+OPS = {"cmd": 1, "macro": 2, "health": 3, "autotune": 4}
+STATUS = {0: "ok", 1: "busy", 2: "bad_request", 3: "replay", 4: "error"}
+STATUS_REPLAY = 3
+REPLY = struct.Struct(">2sBBQBBiIIQ")
+
+
+class LanClient:
+    def __init__(self, host, port, key, timeout):
+        self.addr = (host, port)
+        self.key = key
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.settimeout(timeout)
+        self.counter = 0
+        self.seq = 0
+
+    def _tag(self, data):
+        return hmac.new(self.key, data, hashlib.sha256).digest()[:TAG_LEN]
+
+    def _next_counter(self):
+        # 微秒时间作计数器，重启客户端后仍然递增
+        self.counter = max(time.time_ns() // 1000, self.counter + 1)
+        return self.counter
+
+    def _envelope(self, op, arg):
+        self.seq += 1
+        rid = ("l%d" % self.seq).encode()
+        arg = str(arg).encode() if arg is not None else b""
+        return bytes([ENVELOPE_MAGIC, OPS[op], len(rid)]) + rid + bytes([len(arg)]) + arg
+
+    def _recv(self, counter):
+        while True:
+            data, _ = self.sock.recvfrom(256)
+            if len(data) != REPLY.size + TAG_LEN or data[-TAG_LEN:] != self._tag(data[:-TAG_LEN]):
+                continue
+            magic, version, ftype, echo, status, op, ret, time_us, bus_us, floor = REPLY.unpack(data[:-TAG_LEN])
+            if magic != MAGIC or version != VERSION or echo != counter:
+                continue
+            return {"type": ftype, "status": status, "op": op, "ret": ret,
+                    "time_us": time_us, "bus_us": bus_us, "floor": floor}
+
+    def send(self, op, arg=None, wait_done=True):
+        """Send one command, return (ack, done, ack_rtt_s, done_rtt_s)."""
+        envelope = self._envelope(op, arg)
+        for _ in range(2):
+            counter = self._next_counter()
+            frame = MAGIC + bytes([VERSION, TYPE_CMD]) + struct.pack(">Q", counter) + envelope
+            start = time.perf_counter()
+            self.sock.sendto(frame + self._tag(frame), self.addr)
+            ack = self._recv(counter)
+            ack_rtt = time.perf_counter() - start
+            if ack["status"] != STATUS_REPLAY:
+                break
+            # 设备重启后下限可能超过本地时间，跳到下限之后重发一次
+            self.counter = ack["floor"]
+        if ack["status"] != 0 or not wait_done:
+            return ack, None, ack_rtt, None
+        done = self._recv(counter)
+        return ack, done, ack_rtt, time.perf_counter() - start
+
+
+def fmt_reply(reply):
+    return "%s ret=%d time=%dus bus=%dus" % (STATUS.get(reply["status"], reply["status"]), reply["ret"],
+                                             reply["time_us"], reply["bus_us"])
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def bench(client, args):
+    ack_rtts, done_rtts, failed = [], [], 0
+    for _ in range(args.count):
+        try:
+            ack, done, ack_rtt, done_rtt = client.send(args.op, args.arg)
+        except socket.timeout:
+            failed += 1
+            continue
+        ack_rtts.append(ack_rtt * 1e6)
+        if done is not None:
+            done_rtts.append(done_rtt * 1e6)
+        else:
+            failed += 1
+        time.sleep(args.interval / 1000)
+
+    print("%d sent, %d failed" % (args.count, failed))
+    for name, values in (("ack", ack_rtts), ("done", done_rtts)):
+        if values:
+            print("%-4s rtt us: p50 %d  p90 %d  p99 %d  max %d" % (
+                name, percentile(values, 50), percentile(values, 90), percentile(values, 99), max(values)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("-H", "--host", required=True)
+    parser.add_argument("-p", "--port", type=int, default=7300)
+    parser.add_argument("-k", "--key", default=os.environ.get("MENJIN_LAN_KEY"),
+                        help="shared key as hex, default $MENJIN_LAN_KEY")
+    parser.add_argument("-t", "--timeout", type=float, default=2.0)
+    sub = parser.add_subparsers(dest="command", required=True)
+    sub.add_parser("cmd").add_argument("arg", help="controller command, e.g. 97")
+    sub.add_parser("macro").add_argument("arg", help="macro name")
+    sub.add_parser("health")
+    sub.add_parser("autotune")
+    p = sub.add_parser("bench", help="round trip latency; the default op touches no hardware, "
+                                     "use --op cmd to include the controller bus")
+    p.add_argument("-n", "--count", type=int, default=100)
+    p.add_argument("--op", choices=sorted(OPS), default="health")
+    p.add_argument("--arg")
+    p.add_argument("--interval", type=float, default=50, help="ms between commands")
+    args = parser.parse_args()
+
+    if not args.key:
+        parser.error("no key given")
+    client = LanClient(args.host, args.port, bytes.fromhex(args.key), args.timeout)
+
+    if args.command == "bench":
+        bench(client, args)
+        return 0
+
+    try:
+        ack, done, ack_rtt, done_rtt = client.send(args.command, getattr(args, "arg", None))
+    except socket.timeout:
+        print("timeout, wrong key or host?", file=sys.stderr)
+        return 1
+    print("ack  %s  rtt %.1fms" % (fmt_reply(ack), ack_rtt * 1000))
+    if done is not None:
+        print("done %s  rtt %.1fms" % (fmt_reply(done), done_rtt * 1000))
+        return 0 if done["status"] == 0 else 1
+    return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
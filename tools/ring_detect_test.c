@@ -0,0 +1,220 @@
+// Host test for the adaptive level mode of ring_detect: arm and disarm hysteresis around the
+// learned baseline, how fast the baseline follows drops, rises and a ring, and rings on an idle
+// level that drifts by more than the margin. Throughput and false positives of the tone filter
+// are measured by tools/ring_bench.c.
+//
+//     cc -O2 -Icomponents/menjin_core/include -o ring_detect_test tools/ring_detect_test.c components/menjin_core/ring_detect.c -lm
+//     ./ring_detect_test
+
+#include <stdio.h>
+#include "ring_detect.h"
+
+// Kconfig defaults, see the "Ring Detect" menu
+#define TEST_SAMPLE_RATE    2000
+#define TEST_WINDOW         (TEST_SAMPLE_RATE / 10)
+#define TEST_MARGIN         400
+
+static int g_checks = 0;
+static int g_failures = 0;
+
+#define CHECK(cond) do { \
+        g_checks++; \
+        if (!(cond)) { \
+            g_failures++; \
+            printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+        } \
+    } while (0)
+
+static uint32_t g_rng = 0x1234567;
+
+// 均匀噪声 [-amplitude, amplitude]
+static int noise(int amplitude)
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+
+    return (int) (g_rng % (2 * amplitude + 1)) - amplitude;
+}
+
+static ring_detect_config_t adaptive_config(uint32_t baseline_seed)
+{
+    ring_detect_config_t cfg = {
+            .sample_rate_hz = TEST_SAMPLE_RATE,
+            .threshold = 2500,
+            .sample_max = 6000,
+            .window = TEST_WINDOW,
+            .adaptive = true,
+            .margin = TEST_MARGIN,
+            .baseline_seed = baseline_seed,
+            .on_min_ms = 500,
+            .on_max_ms = 2000,
+            .off_min_ms = 200,
+            .off_max_ms = 6000,
+            .bursts = 2,
+    };
+
+    return cfg;
+}
+
+// 一个窗口的恒定电平，返回该窗口的判定
+static bool feed_window(ring_detect_t *rd, uint16_t level)
+{
+    uint32_t on_windows = rd->stats.on_windows;
+
+    for (int i = 0; i < TEST_WINDOW; ++i) {
+        ring_detect_feed(rd, level);
+    }
+
+    return rd->stats.on_windows != on_windows;
+}
+
+static void test_hysteresis(void)
+{
+    ring_detect_t rd;
+    ring_detect_config_t cfg = adaptive_config(1000);
+
+    printf("hysteresis\n");
+    ring_detect_init(&rd, &cfg);
+    CHECK(ring_detect_get_threshold(&rd) == 1000 + TEST_MARGIN);
+
+    // 在 margin/2 和 margin 之间：不触发
+    CHECK(!feed_window(&rd, 1000 + TEST_MARGIN * 3 / 4));
+    CHECK(!rd.level_on);
+    // 超过 margin 触发，阈值降到 margin/2
+    CHECK(feed_window(&rd, 1000 + TEST_MARGIN * 2));
+    CHECK(ring_detect_get_threshold(&rd) == ring_detect_get_baseline(&rd) + TEST_MARGIN / 2);
+    // 同样的中间电平此时保持触发
+    CHECK(feed_window(&rd, 1000 + TEST_MARGIN * 3 / 4));
+    CHECK(feed_window(&rd, 1000 + TEST_MARGIN * 3 / 4));
+    // 低于 margin/2 释放
+    CHECK(!feed_window(&rd, 1000 + TEST_MARGIN / 4));
+    CHECK(ring_detect_get_threshold(&rd) == ring_detect_get_baseline(&rd) + TEST_MARGIN);
+
+    // 固定阈值模式没有滞回
+    cfg.adaptive = false;
+    ring_detect_init(&rd, &cfg);
+    CHECK(feed_window(&rd, 2501));
+    CHECK(!feed_window(&rd, 2500));
+    CHECK(ring_detect_get_threshold(&rd) == 2500);
+}
+
+static void test_baseline(void)
+{
+    ring_detect_t rd;
+    ring_detect_config_t cfg = adaptive_config(0);
+
+    printf("baseline\n");
+    // 没有种子时从第一个窗口学习
+    ring_detect_init(&rd, &cfg);
+    feed_window(&rd, 1500);
+    CHECK(ring_detect_get_baseline(&rd) == 1500);
+
+    // 下降很快跟上：2 s 内
+    cfg = adaptive_config(2000);
+    ring_detect_init(&rd, &cfg);
+    for (int i = 0; i < 20; ++i) {
+        feed_window(&rd, 1000);
+    }
+    printf("  2000 -> 1000, after 2 s: %u\n", (unsigned) ring_detect_get_baseline(&rd));
+    CHECK(ring_detect_get_baseline(&rd) < 1000 + 20);
+
+    // 低于 margin 的上升慢慢跟上，不触发
+    cfg = adaptive_config(1000);
+    ring_detect_init(&rd, &cfg);
+    int on = 0;
+    for (int i = 0; i < 100; ++i) {
+        on += feed_window(&rd, 1000 + TEST_MARGIN * 3 / 4);
+    }
+    printf("  1000 -> %d, after 10 s: %u\n", 1000 + TEST_MARGIN * 3 / 4, (unsigned) ring_detect_get_baseline(&rd));
+    CHECK(on == 0);
+    CHECK(ring_detect_get_baseline(&rd) > 1000 + TEST_MARGIN * 3 / 4 - 20);
+
+    // 振铃期间基线几乎冻结：2 s 的振铃不会把它抬到释放阈值以上
+    cfg = adaptive_config(1000);
+    ring_detect_init(&rd, &cfg);
+    for (int i = 0; i < 20; ++i) {
+        feed_window(&rd, 1000 + TEST_MARGIN * 2);
+    }
+    printf("  ringing at +%d for 2 s: %u\n", TEST_MARGIN * 2, (unsigned) ring_detect_get_baseline(&rd));
+    CHECK(rd.level_on);
+    CHECK(ring_detect_get_baseline(&rd) < 1000 + TEST_MARGIN / 4);
+}
+
+// 1 s on / 4 s off，每次 3 声，每分钟一次，振铃比空闲电平高 2 倍 margin；空闲电平在
+// 10 分钟内从 1000 漂到 3000，远超 margin
+#define DRIFT_MINUTES   10
+#define DRIFT_FROM      1000
+#define DRIFT_TO        3000
+#define RING_PERIOD_S   60
+
+static void run_drift(const ring_detect_config_t *cfg, int *rings, int *found, int *false_positives)
+{
+    ring_detect_t rd;
+    int last_found = -1;
+    uint64_t total = (uint64_t) DRIFT_MINUTES * 60 * TEST_SAMPLE_RATE;
+
+    g_rng = 0x1234567;
+    *rings = 0;
+    *found = 0;
+    *false_positives = 0;
+    ring_detect_init(&rd, cfg);
+
+    for (uint64_t t = 0; t < total; ++t) {
+        uint32_t s = t / TEST_SAMPLE_RATE;
+        int level = DRIFT_FROM + (int) ((DRIFT_TO - DRIFT_FROM) * t / total);
+        // 第一个周期留给基线学习
+        int ring = s >= RING_PERIOD_S ? (int) (s / RING_PERIOD_S) : -1;
+        uint32_t phase = s % RING_PERIOD_S;
+        if (ring >= 0 && phase < 15 && phase % 5 == 0) {
+            level += TEST_MARGIN * 2;
+        }
+        if (ring >= 0 && phase == 0 && t % TEST_SAMPLE_RATE == 0) {
+            (*rings)++;
+        }
+
+        if (!ring_detect_feed(&rd, level + noise(50))) {
+            continue;
+        }
+        // 一次振铃的第 2、3 声都会上报，只算一次
+        if (ring >= 0 && phase < 20) {
+            if (ring != last_found) {
+                (*found)++;
+                last_found = ring;
+            }
+        } else {
+            (*false_positives)++;
+        }
+    }
+}
+
+static void test_drift(void)
+{
+    ring_detect_config_t cfg = adaptive_config(0);
+    int rings, found, false_positives;
+
+    printf("drifting idle level %d -> %d over %d min\n", DRIFT_FROM, DRIFT_TO, DRIFT_MINUTES);
+    run_drift(&cfg, &rings, &found, &false_positives);
+    printf("  adaptive, margin %d: %d of %d rings, %d false\n", TEST_MARGIN, found, rings, false_positives);
+    CHECK(rings == DRIFT_MINUTES - 1);
+    CHECK(found == rings);
+    CHECK(false_positives == 0);
+
+    // 同样的波形用固定阈值：漂移后要么漏报要么一直触发
+    cfg.adaptive = false;
+    run_drift(&cfg, &rings, &found, &false_positives);
+    printf("  static threshold %u: %d of %d rings, %d false\n", (unsigned) cfg.threshold, found, rings,
+           false_positives);
+    CHECK(found < rings);
+}
+
+int main(void)
+{
+    test_hysteresis();
+    test_baseline();
+    test_drift();
+
+    printf("%d checks, %d failed\n", g_checks, g_failures);
+
+    return g_failures != 0;
+}
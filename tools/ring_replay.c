@@ -0,0 +1,181 @@
+// Replay ring captures downloaded from /api/ring/capture?id=N through ring_detect, to tune the
+// detector on real waveforms. Prints what the detector decides for each capture next to what
+// the device recorded; -v also prints every window.
+//
+//     cc -O2 -Imain/app -Icomponents/menjin_core/include -o ring_replay tools/ring_replay.c components/menjin_core/ring_detect.c -lm
+//     ./ring_replay [-t tone_hz] [-w window_ms] [-a threshold] [-b bursts]
+//                   [-o on_min_ms:on_max_ms] [-f off_min_ms:off_max_ms] [-v] ring_0.bin ...
+//
+// Options default to the Kconfig defaults: level mode with the -a threshold, or with the
+// threshold stored in the capture; -t 450 selects tone mode.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "ring_capture.h"
+#include "ring_detect.h"
+
+static const char *g_state_names[] = {"idle", "on", "off", "invalid"};
+
+typedef struct {
+    ring_detect_config_t cfg;
+    uint32_t window_ms;
+    bool threshold_set;
+    bool verbose;
+} replay_opts_t;
+
+static int replay(const char *path, const replay_opts_t *opts)
+{
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        perror(path);
+        return -1;
+    }
+
+    ring_capture_header_t header;
+    if (fread(&header, sizeof(header), 1, fp) != 1 || header.magic != RING_CAPTURE_MAGIC
+        || header.header_len < sizeof(header)) {
+        fprintf(stderr, "%s: not a ring capture\n", path);
+        fclose(fp);
+        return -1;
+    }
+    fseek(fp, header.header_len, SEEK_SET);
+
+    uint16_t *samples = malloc(header.samples * sizeof(uint16_t));
+    size_t count = samples != NULL ? fread(samples, sizeof(uint16_t), header.samples, fp) : 0;
+    fclose(fp);
+    if (count != header.samples) {
+        fprintf(stderr, "%s: truncated, %zu of %u samples\n", path, count, header.samples);
+        free(samples);
+        return -1;
+    }
+
+    ring_detect_config_t cfg = opts->cfg;
+    cfg.sample_rate_hz = header.sample_rate_hz;
+    cfg.window = header.sample_rate_hz * opts->window_ms / 1000;
+    if (!opts->threshold_set) {
+        cfg.threshold = header.threshold;
+    }
+    // 抓取时的基线作为初值，和设备上一样从学习到的值开始
+    cfg.baseline_seed = header.baseline;
+
+    ring_detect_t rd;
+    if (ring_detect_init(&rd, &cfg) != 0) {
+        fprintf(stderr, "%s: tone %u Hz is not below half of %u Hz, level mode\n", path, opts->cfg.tone_hz,
+                header.sample_rate_hz);
+    }
+
+    printf("%s: seq %u, %u samples at %u Hz, trigger at %.0f ms, device flags:%s%s\n", path, header.seq,
+           header.samples, header.sample_rate_hz, header.trigger * 1000.0 / header.sample_rate_hz,
+           header.flags & RING_CAPTURE_FLAG_DETECTED ? " detected" : "",
+           header.flags & RING_CAPTURE_FLAG_REJECTED ? " rejected" : "");
+
+    uint32_t windows = 0;
+    for (uint32_t i = 0; i < header.samples; ++i) {
+        bool hit = ring_detect_feed(&rd, samples[i]);
+        if (rd.stats.windows != windows) {
+            windows = rd.stats.windows;
+            if (opts->verbose) {
+                printf("  %7.0f ms  avg %5u  tone %3u%%  %s\n", (i + 1) * 1000.0 / header.sample_rate_hz,
+                       rd.last_avg, rd.last_tone_pct, g_state_names[rd.state]);
+            }
+        }
+        if (hit) {
+            printf("  ring reported at %.0f ms\n", (i + 1) * 1000.0 / header.sample_rate_hz);
+        }
+    }
+
+    printf("  windows %u, on %u, bursts %u, rejected %u, detections %u, ends %s\n", rd.stats.windows,
+           rd.stats.on_windows, rd.stats.bursts, rd.stats.rejected, rd.stats.detections, g_state_names[rd.state]);
+    free(samples);
+
+    return 0;
+}
+
+static bool parse_range(const char *arg, uint16_t *min, uint16_t *max)
+{
+    char *end;
+    unsigned long lo = strtoul(arg, &end, 10);
+    if (end == arg || *end != ':') {
+        return false;
+    }
+    unsigned long hi = strtoul(end + 1, &end, 10);
+    if (*end != '\0' || lo > UINT16_MAX || hi > UINT16_MAX) {
+        return false;
+    }
+    *min = lo;
+    *max = hi;
+
+    return true;
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-t tone_hz] [-w window_ms] [-a threshold] [-b bursts] "
+                    "[-o on_min:on_max] [-f off_min:off_max] [-v] capture.bin...\n", name);
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    // Kconfig defaults, see the "Ring Detect" menu
+    replay_opts_t opts = {
+            .cfg = {
+                    .sample_max = 6000,     // ADC_VALUE_MAX in menjin_ring.c
+                    .tone_hz = 0,
+                    .tone_ratio_pct = 60,
+                    .tone_min_amplitude = 200,
+                    .on_min_ms = 500,
+                    .on_max_ms = 2000,
+                    .off_min_ms = 200,
+                    .off_max_ms = 6000,
+                    .bursts = 2,
+            },
+            .window_ms = 100,
+    };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "t:w:a:b:o:f:v")) != -1) {
+        switch (opt) {
+            case 't':
+                opts.cfg.tone_hz = atoi(optarg);
+                break;
+            case 'w':
+                opts.window_ms = atoi(optarg);
+                break;
+            case 'a':
+                opts.cfg.threshold = atoi(optarg);
+                opts.threshold_set = true;
+                break;
+            case 'b':
+                opts.cfg.bursts = atoi(optarg);
+                break;
+            case 'o':
+                if (!parse_range(optarg, &opts.cfg.on_min_ms, &opts.cfg.on_max_ms)) {
+                    usage(argv[0]);
+                }
+                break;
+            case 'f':
+                if (!parse_range(optarg, &opts.cfg.off_min_ms, &opts.cfg.off_max_ms)) {
+                    usage(argv[0]);
+                }
+                break;
+            case 'v':
+                opts.verbose = true;
+                break;
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (optind >= argc || opts.window_ms == 0) {
+        usage(argv[0]);
+    }
+
+    int failed = 0;
+    for (int i = optind; i < argc; ++i) {
+        failed |= replay(argv[i], &opts) != 0;
+    }
+
+    return failed;
+}
@@ -0,0 +1,111 @@
+#!/usr/bin/env python3
+"""Pack the web UI in spiffs/ into one read-only bundle embedded in the app image.
+
+    web_assets.py <src dir> <bundle>
+
+Text files that shrink are stored gzipped next to the original. Local scripts and stylesheets
+referenced from HTML are rewritten to `name?v=<hash>`, so the server can let browsers cache them
+for good. Layout, all integers little-endian, read by main/wifi/web_bundle.c:
+
+    header  magic "MJWB" | version u16 | count u16
+    entry   path_off u32 | data_off u32 | data_len u32 | gz_off u32 | gz_len u32 | hash[16]
+            count entries sorted by path (byte order), gz_off 0 when not compressed
+    data    NUL-terminated paths and file contents, contents 4-byte aligned
+"""
+
+import argparse
+import gzip
+import hashlib
+import os
+import re
+import struct
+import sys
+
+MAGIC = b"MJWB"
+VERSION = 1
+HEADER = struct.Struct("<4sHH")
+ENTRY = struct.Struct("<IIIII16s")
+GZIP_TYPES = (".html", ".js", ".css", ".svg", ".json", ".txt")
+# 压缩后至少省下这么多才保留 .gz
+GZIP_MIN_SAVING = 0.1
+REF_RE = re.compile(r'(\b(?:src|href)=")([^":?#/]+)(")')
+
+
+def content_hash(data):
+    return hashlib.sha256(data).hexdigest()[:16]
+
+
+def version_refs(html, hashes):
+    def repl(m):
+        name = m.group(2)
+        if name not in hashes:
+            return m.group(0)
+        return "%s%s?v=%s%s" % (m.group(1), name, hashes[name], m.group(3))
+
+    return REF_RE.sub(repl, html.decode()).encode()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("src")
+    parser.add_argument("bundle")
+    args = parser.parse_args()
+
+    names = sorted(n for n in os.listdir(args.src) if os.path.isfile(os.path.join(args.src, n)))
+    contents = {}
+    for name in names:
+        with open(os.path.join(args.src, name), "rb") as f:
+            contents[name] = f.read()
+
+    # HTML last, its hash covers the versioned references
+    hashes = {n: content_hash(contents[n]) for n in names if not n.endswith(".html")}
+    for name in names:
+        if name.endswith(".html"):
+            contents[name] = version_refs(contents[name], hashes)
+            hashes[name] = content_hash(contents[name])
+
+    assets = []
+    for name in names:
+        data = contents[name]
+        packed = None
+        if name.endswith(GZIP_TYPES):
+            # mtime=0: same input, same bundle
+            packed = gzip.compress(data, compresslevel=9, mtime=0)
+            if len(packed) > len(data) * (1 - GZIP_MIN_SAVING):
+                packed = None
+        assets.append(("/" + name, data, packed, hashes[name]))
+        print("web asset %s: %d bytes%s" % (name, len(data), ", %d gzip" % len(packed) if packed else ""))
+    # strcmp 顺序，设备上二分查找
+    assets.sort(key=lambda a: a[0].encode())
+
+    blob = bytearray(HEADER.size + ENTRY.size * len(assets))
+    HEADER.pack_into(blob, 0, MAGIC, VERSION, len(assets))
+
+    def append(data, align):
+        blob.extend(b"\0" * (-len(blob) % align))
+        off = len(blob)
+        blob.extend(data)
+        return off
+
+    for i, (path, data, packed, digest) in enumerate(assets):
+        path_off = append(path.encode() + b"\0", 1)
+        data_off = append(data, 4)
+        gz_off = append(packed, 4) if packed else 0
+        ENTRY.pack_into(blob, HEADER.size + ENTRY.size * i, path_off, data_off, len(data), gz_off,
+                        len(packed) if packed else 0, digest.encode())
+
+    # 内容不变时不改写，避免重新链接
+    try:
+        with open(args.bundle, "rb") as f:
+            if f.read() == blob:
+                return 0
+    except OSError:
+        pass
+    with open(args.bundle, "wb") as f:
+        f.write(blob)
+    print("web bundle: %d assets, %d bytes" % (len(assets), len(blob)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())